@@ -67,6 +67,7 @@
 #define DEFAULT_MIN_AREA              100.0f
 #define DEFAULT_NUM_ERODE_ITERATIONS    1
 #define DEFAULT_NUM_DILATE_ITERATIONS   3
+#define MASK_POOL_SIZE                  4
 
 enum {
     PROP_0,
@@ -120,6 +121,9 @@ gst_bgfg_acmmm2003_finalize(GObject *obj)
 {
     GstBgFgACMMM2003 *filter = GST_BGFG_ACMMM2003 (obj);
     if (filter->image) cvReleaseImage(&filter->image);
+    if (filter->mask)  cvReleaseImageHeader(&filter->mask);
+    if (filter->mask_pool) fg_mask_pool_free(filter->mask_pool);
+    g_array_free(filter->roi_detections, TRUE);
     if (filter->model) cvReleaseBGStatModel(&filter->model);
 
     G_OBJECT_CLASS(parent_class)->finalize(obj);
@@ -167,7 +171,7 @@ gst_bgfg_acmmm2003_class_init(GstBgFgACMMM2003Class *klass)
                                                          FALSE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_ROI,
-                                    g_param_spec_boolean("roi", "ROI - Region of Interest", "Send 'fg-roi' events downstream",
+                                    g_param_spec_boolean("roi", "ROI - Region of Interest", "Send the foreground regions downstream as a 'detections' event",
                                                          TRUE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_CONVEX_HULL,
@@ -219,6 +223,7 @@ gst_bgfg_acmmm2003_init(GstBgFgACMMM2003 *filter, GstBgFgACMMM2003Class *gclass)
     filter->perimeter_scale     = DEFAULT_PERIMETER_SCALE;
     filter->n_erode_iterations  = DEFAULT_NUM_ERODE_ITERATIONS;
     filter->n_dilate_iterations = DEFAULT_NUM_DILATE_ITERATIONS;
+    filter->roi_detections      = detections_array_new();
 }
 
 static void
@@ -323,8 +328,11 @@ gst_bgfg_acmmm2003_set_caps(GstPad *pad, GstCaps *caps)
 
     // set default model parameters
 
-    // initialize mask
-    filter->image = cvCreateImage(cvSize(width, height), depth/3, 3);
+    // initialize mask; the foreground computed by the model is published
+    // through buffers taken from the mask pool
+    filter->image     = cvCreateImage(cvSize(width, height), depth/3, 3);
+    filter->mask      = cvCreateImageHeader(cvSize(width, height), IPL_DEPTH_8U, 1);
+    filter->mask_pool = fg_mask_pool_new(filter->mask, MASK_POOL_SIZE);
 
     otherpad = (pad == filter->srcpad) ? filter->sinkpad : filter->srcpad;
     gst_object_unref(filter);
@@ -361,28 +369,22 @@ gst_bgfg_acmmm2003_chain(GstPad *pad, GstBuffer *buf)
 
     // send mask event, if requested
     if (filter->send_mask_events) {
-        GstStructure *structure;
         GstEvent     *event;
-        GArray       *data_array;
+        GstBuffer    *mask_buffer;
         IplImage     *mask;
 
-        // prepare and send custom event with the mask surface
-        mask = filter->model->foreground;
-        data_array = g_array_sized_new(FALSE, FALSE, sizeof(mask->imageData[0]), mask->imageSize);
-        g_array_append_vals(data_array, mask->imageData, mask->imageSize);
-
-        structure = gst_structure_new("bgfg-mask",
-                                      "data",      G_TYPE_POINTER, data_array,
-                                      "width",     G_TYPE_UINT,    mask->width,
-                                      "height",    G_TYPE_UINT,    mask->height,
-                                      "depth",     G_TYPE_UINT,    mask->depth,
-                                      "channels",  G_TYPE_UINT,    mask->nChannels,
-                                      "timestamp", G_TYPE_UINT64,  GST_BUFFER_TIMESTAMP(buf),
-                                      NULL);
-
-        event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+        // the model owns (and keeps rewriting) its foreground image, so it's
+        // copied once into a pooled buffer which is then shared downstream
+        mask        = filter->model->foreground;
+        mask_buffer = fg_mask_pool_acquire(filter->mask_pool);
+        cvSetData(filter->mask, GST_BUFFER_DATA(mask_buffer), filter->mask->widthStep);
+        cvCopy(mask, filter->mask, NULL);
+
+        event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM,
+                                     fg_mask_to_structure(mask_buffer, filter->mask,
+                                                          GST_BUFFER_TIMESTAMP(buf), "bgfg-mask"));
         gst_pad_push_event(filter->srcpad, event);
-        g_array_unref(data_array);
+        gst_buffer_unref(mask_buffer);
 
         if (filter->display) {
             // shade the regions not selected by the acmmm2003 algorithm
@@ -423,24 +425,13 @@ gst_bgfg_acmmm2003_chain(GstPad *pad, GstBuffer *buf)
         }
 
         for (i = 0; i < n_rects; ++i) {
-            GstEvent     *event;
-            GstStructure *structure;
             CvRect        r;
 
             // skip collapsed rectangles
             r = bounding_rects[i];
             if ((r.width == 0) || (r.height == 0)) continue;
 
-            structure = gst_structure_new("bgfg-roi",
-                                          "x",         G_TYPE_UINT,   r.x,
-                                          "y",         G_TYPE_UINT,   r.y,
-                                          "width",     G_TYPE_UINT,   r.width,
-                                          "height",    G_TYPE_UINT,   r.height,
-                                          "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                          NULL);
-
-            event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-            gst_pad_send_event(filter->sinkpad, event);
+            detections_array_add(filter->roi_detections, r, 1.0f);
 
             if (filter->verbose)
                 GST_INFO("[roi] x: %d, y: %d, width: %d, height: %d\n",
@@ -452,6 +443,14 @@ gst_bgfg_acmmm2003_chain(GstPad *pad, GstBuffer *buf)
         }
 
         g_free(bounding_rects);
+
+        // send all the ROIs found on this frame in a single event
+        if (filter->roi_detections->len > 0) {
+            gst_pad_push_event(filter->srcpad,
+                               detections_event_new(DETECTION_SOURCE_BGFG, GST_BUFFER_TIMESTAMP(buf),
+                                                    filter->roi_detections));
+            g_array_set_size(filter->roi_detections, 0);
+        }
     }
 
     if (filter->display)
@@ -51,6 +51,9 @@
 #include <cv.h>
 #include <cvaux.h>
 
+#include "detections.h"
+#include "fg-mask.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_BGFG_ACMMM2003            (gst_bgfg_acmmm2003_get_type())
@@ -70,6 +73,9 @@ struct _GstBgFgACMMM2003
     GstPad                  *srcpad;
 
     IplImage                *image;
+    IplImage                *mask;
+    FgMaskPool              *mask_pool;
+    GArray                  *roi_detections;
     CvBGStatModel           *model;
     gboolean                 convex_hull;
     float                    perimeter_scale;
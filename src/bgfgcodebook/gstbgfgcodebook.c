@@ -70,6 +70,9 @@
 #define DEFAULT_PERIMETER_SCALE       4.0f
 #define DEFAULT_NUM_ERODE_ITERATIONS  1
 #define DEFAULT_NUM_DILATE_ITERATIONS 1
+#define DEFAULT_NUM_WORKERS           0
+#define MASK_POOL_SIZE                4
+#define MIN_BAND_HEIGHT               32
 
 enum {
     PROP_0,
@@ -84,7 +87,15 @@ enum {
     PROP_CONVEX_HULL,
     PROP_PERIMETER_SCALE,
     PROP_NUM_ERODE_ITERATIONS,
-    PROP_NUM_DILATE_ITERATIONS
+    PROP_NUM_DILATE_ITERATIONS,
+    PROP_NUM_WORKERS
+};
+
+struct _CodebookBand
+{
+    CvRect             rect;
+    CvBGCodeBookModel *model;
+    CvMat             *scratch; // band mask plus the rows needed by erode/dilate
 };
 
 static const CvRect NULL_RECT = {0, 0, 0, 0};
@@ -113,6 +124,8 @@ static gboolean      gst_bgfg_codebook_set_caps     (GstPad * pad, GstCaps * cap
 static GstFlowReturn gst_bgfg_codebook_chain        (GstPad * pad, GstBuffer * buf);
 static gboolean      rect_overlap                   (const CvRect r1, const CvRect r2);
 static CvRect        rect_collapse                  (const CvRect r1, const CvRect r2);
+static void          process_band                   (gpointer task, gpointer user_data);
+static void          free_bands                     (GstBgFgCodebook *filter);
 
 static void
 set_model_array(guchar *array, guint value)
@@ -120,15 +133,30 @@ set_model_array(guchar *array, guint value)
     array[0] = array[1] = array[2] = value;
 }
 
+static void
+set_band_models(GstBgFgCodebook *filter)
+{
+    guint i;
+
+    for (i = 0; i < filter->n_bands; ++i) {
+        set_model_array(filter->bands[i].model->modMin, filter->model_min);
+        set_model_array(filter->bands[i].model->modMax, filter->model_max);
+        set_model_array(filter->bands[i].model->cbBounds, filter->model_bounds);
+    }
+}
+
 // clean up
 static void
 gst_bgfg_codebook_finalize(GObject *obj)
 {
     GstBgFgCodebook *filter = GST_BGFG_CODEBOOK (obj);
     if (filter->image) cvReleaseImage(&filter->image);
-    if (filter->mask)  cvReleaseImage(&filter->mask);
-    if (filter->model) cvReleaseBGCodeBookModel(&filter->model);
-
+    if (filter->yuv_image) cvReleaseImage(&filter->yuv_image);
+    if (filter->fg_image) cvReleaseImage(&filter->fg_image);
+    if (filter->mask)  cvReleaseImageHeader(&filter->mask);
+    if (filter->mask_pool) fg_mask_pool_free(filter->mask_pool);
+    g_array_free(filter->roi_detections, TRUE);
+    free_bands(filter);
 
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -175,7 +203,7 @@ gst_bgfg_codebook_class_init(GstBgFgCodebookClass *klass)
                                                          FALSE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_ROI,
-                                    g_param_spec_boolean("roi", "ROI - Region of Interest", "Send 'fg-roi' events downstream",
+                                    g_param_spec_boolean("roi", "ROI - Region of Interest", "Send the foreground regions downstream as a 'detections' event",
                                                          TRUE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_NUM_FRAMES_LEARN_BG,
@@ -209,6 +237,10 @@ gst_bgfg_codebook_class_init(GstBgFgCodebookClass *klass)
     g_object_class_install_property(gobject_class, PROP_NUM_DILATE_ITERATIONS,
                                     g_param_spec_float("num-dilate-iterations", "Number of dilate iterations", "Number of times that an 'dilate' filter should be applied to the foreground mask. Note that the 'dilate' filter is applied *after* the 'erode' filter",
                                                        0, INT_MAX, DEFAULT_NUM_DILATE_ITERATIONS, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_NUM_WORKERS,
+                                    g_param_spec_uint("n-workers", "Number of workers", "Number of threads (and horizontal bands of the background model) used to process each frame; takes effect when the caps are (re)negotiated (0 = one per processor)",
+                                                      0, 64, DEFAULT_NUM_WORKERS, G_PARAM_READWRITE));
 }
 
 //initialize the new element
@@ -241,12 +273,13 @@ gst_bgfg_codebook_init(GstBgFgCodebook *filter, GstBgFgCodebookClass *gclass)
 
     filter->n_frames            = 0;
     filter->n_frames_learn_bg   = DEFAULT_NUM_FRAMES_LEARN_BG;
+    filter->roi_detections      = detections_array_new();
+    filter->n_workers           = DEFAULT_NUM_WORKERS;
 
-    // create and setup model parameters
-    filter->model = cvCreateBGCodeBookModel();
-    set_model_array(filter->model->modMin, DEFAULT_CODEBOOK_MODEL_MIN);
-    set_model_array(filter->model->modMax, DEFAULT_CODEBOOK_MODEL_MAX);
-    set_model_array(filter->model->cbBounds, DEFAULT_CODEBOOK_MODEL_BOUNDS);
+    // model parameters; the models themselves are created with the bands
+    filter->model_min           = DEFAULT_CODEBOOK_MODEL_MIN;
+    filter->model_max           = DEFAULT_CODEBOOK_MODEL_MAX;
+    filter->model_bounds        = DEFAULT_CODEBOOK_MODEL_BOUNDS;
 }
 
 static void
@@ -271,13 +304,16 @@ gst_bgfg_codebook_set_property(GObject *object, guint prop_id, const GValue *val
             filter->n_frames_learn_bg = g_value_get_uint(value);
             break;
         case PROP_MODEL_MIN:
-            set_model_array(filter->model->modMin, g_value_get_uint(value));
+            filter->model_min = g_value_get_uint(value);
+            set_band_models(filter);
             break;
         case PROP_MODEL_MAX:
-            set_model_array(filter->model->modMax, g_value_get_uint(value));
+            filter->model_max = g_value_get_uint(value);
+            set_band_models(filter);
             break;
         case PROP_MODEL_BOUNDS:
-            set_model_array(filter->model->cbBounds, g_value_get_uint(value));
+            filter->model_bounds = g_value_get_uint(value);
+            set_band_models(filter);
             break;
         case PROP_CONVEX_HULL:
             filter->convex_hull = g_value_get_boolean(value);
@@ -291,6 +327,9 @@ gst_bgfg_codebook_set_property(GObject *object, guint prop_id, const GValue *val
         case PROP_NUM_DILATE_ITERATIONS:
             filter->n_dilate_iterations = g_value_get_float(value);
             break;
+        case PROP_NUM_WORKERS:
+            filter->n_workers = g_value_get_uint(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -319,13 +358,13 @@ gst_bgfg_codebook_get_property(GObject *object, guint prop_id, GValue *value, GP
             g_value_set_uint(value, filter->n_frames_learn_bg);
             break;
         case PROP_MODEL_MIN:
-            g_value_set_uint(value, filter->model->modMin[0]);
+            g_value_set_uint(value, filter->model_min);
             break;
         case PROP_MODEL_MAX:
-            g_value_set_uint(value, filter->model->modMax[0]);
+            g_value_set_uint(value, filter->model_max);
             break;
         case PROP_MODEL_BOUNDS:
-            g_value_set_uint(value, filter->model->cbBounds[0]);
+            g_value_set_uint(value, filter->model_bounds);
             break;
         case PROP_CONVEX_HULL:
             g_value_set_boolean(value, filter->convex_hull);
@@ -339,6 +378,9 @@ gst_bgfg_codebook_get_property(GObject *object, guint prop_id, GValue *value, GP
         case PROP_NUM_DILATE_ITERATIONS:
             g_value_set_float(value, filter->n_dilate_iterations);
             break;
+        case PROP_NUM_WORKERS:
+            g_value_set_uint(value, filter->n_workers);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -354,6 +396,7 @@ gst_bgfg_codebook_set_caps(GstPad *pad, GstCaps *caps)
     GstPad          *otherpad;
     GstStructure    *structure;
     gint             width, height, depth;
+    guint            i, n_threads;
 
     filter = GST_BGFG_CODEBOOK(gst_pad_get_parent(pad));
     structure = gst_caps_get_structure(caps, 0);
@@ -361,10 +404,39 @@ gst_bgfg_codebook_set_caps(GstPad *pad, GstCaps *caps)
     gst_structure_get_int(structure, "height", &height);
     gst_structure_get_int(structure, "depth", &depth);
 
-    // initialize mask
-    filter->image  = cvCreateImage(cvSize(width, height), depth/3, 3);
-    filter->mask   = cvCreateImage(cvSize(width, height), depth/3, 1);
-    cvSet(filter->mask, cvScalar(255, 255, 255, 0), 0); // draw black mask
+    // release the images of the previous caps, if any
+    if (filter->image) cvReleaseImage(&filter->image);
+    if (filter->yuv_image) cvReleaseImage(&filter->yuv_image);
+    if (filter->fg_image) cvReleaseImage(&filter->fg_image);
+    if (filter->mask) cvReleaseImageHeader(&filter->mask);
+    if (filter->mask_pool) fg_mask_pool_free(filter->mask_pool);
+
+    // initialize mask; its pixels live in buffers taken from the mask pool,
+    // which are shared (not copied) with the downstream elements
+    filter->image     = cvCreateImage(cvSize(width, height), depth/3, 3);
+    filter->yuv_image = cvCreateImage(cvSize(width, height), depth/3, 3);
+    filter->fg_image  = cvCreateImage(cvSize(width, height), depth/3, 1);
+    filter->mask      = cvCreateImageHeader(cvSize(width, height), depth/3, 1);
+    filter->mask_pool = fg_mask_pool_new(filter->mask, MASK_POOL_SIZE);
+
+    // split the frame in bands of (roughly) the same height, one per worker;
+    // the background is learnt again from scratch
+    free_bands(filter);
+    n_threads          = (filter->n_workers > 0) ? filter->n_workers : worker_pool_default_n_threads();
+    filter->n_bands    = CLAMP((guint) height / MIN_BAND_HEIGHT, 1, n_threads);
+    filter->bands      = g_new0(CodebookBand, filter->n_bands);
+    filter->band_tasks = g_new(gpointer, filter->n_bands);
+    for (i = 0; i < filter->n_bands; ++i) {
+        gint top    = height * i / filter->n_bands;
+        gint bottom = height * (i + 1) / filter->n_bands;
+
+        filter->bands[i].rect  = cvRect(0, top, width, bottom - top);
+        filter->bands[i].model = cvCreateBGCodeBookModel();
+        filter->band_tasks[i]  = &filter->bands[i];
+    }
+    set_band_models(filter);
+    filter->workers  = worker_pool_new(process_band, filter, filter->n_bands);
+    filter->n_frames = 0;
 
     otherpad = (pad == filter->srcpad) ? filter->sinkpad : filter->srcpad;
     gst_object_unref(filter);
@@ -376,7 +448,6 @@ static GstFlowReturn
 gst_bgfg_codebook_chain(GstPad *pad, GstBuffer *buf)
 {
     GstBgFgCodebook *filter;
-    IplImage        *yuv_image;
 
     // sanity checks
     g_return_val_if_fail(pad != NULL, GST_FLOW_ERROR);
@@ -387,57 +458,46 @@ gst_bgfg_codebook_chain(GstPad *pad, GstBuffer *buf)
     filter->image->imageData = (gchar*) GST_BUFFER_DATA(buf);
 
     // clear stale models right after we stop learning the background
-    if (filter->n_frames == (filter->n_frames_learn_bg + 1))
-        cvBGCodeBookClearStale(filter->model, filter->model->t / 2, NULL_RECT, 0);
-
-    yuv_image = cvCloneImage(filter->image);
-    cvCvtColor(filter->image, yuv_image, CV_BGR2YCrCb); //YUV For codebook method
+    filter->clear_stale = (filter->n_frames == (filter->n_frames_learn_bg + 1));
 
     if (filter->n_frames <= filter->n_frames_learn_bg) {
-        cvBGCodeBookUpdate(filter->model, yuv_image, NULL_RECT, 0);
+        filter->band_operation = CODEBOOK_BAND_UPDATE;
+        worker_pool_run(filter->workers, filter->band_tasks, filter->n_bands);
         filter->n_frames++;
         if (filter->verbose)
             GST_INFO("[build background] %d frames", filter->n_frames);
     } else {
-        GstStructure *structure;
-        GstEvent     *event;
-
-        cvBGCodeBookDiff(filter->model, yuv_image, filter->mask, NULL_RECT);
-
-        // exclude artifacts and irrelevant objects
-        if (filter->n_erode_iterations > 0)
-            cvErode(filter->mask, filter->mask, NULL, filter->n_erode_iterations);
-        if (filter->n_dilate_iterations > 0)
-            cvDilate(filter->mask, filter->mask, NULL, filter->n_dilate_iterations);
+        GstBuffer    *mask_buffer;
+
+        mask_buffer = fg_mask_pool_acquire(filter->mask_pool);
+        cvSetData(filter->mask, GST_BUFFER_DATA(mask_buffer), filter->mask->widthStep);
+
+        // the bands are segmented in a first pass and filtered in a second
+        // one, since erode/dilate read rows from the neighbouring bands
+        filter->band_operation = CODEBOOK_BAND_DIFF;
+        worker_pool_run(filter->workers, filter->band_tasks, filter->n_bands);
+        if ((filter->n_erode_iterations > 0) || (filter->n_dilate_iterations > 0)) {
+            filter->band_operation = CODEBOOK_BAND_MORPHOLOGY;
+            worker_pool_run(filter->workers, filter->band_tasks, filter->n_bands);
+        }
 
-        // send mask event, if requested
+        // send mask event, if requested; from now on the mask is shared
+        // with the downstream elements and must not be modified, so the
+        // shading and the ROI segmentation (which redraws its input) below
+        // work on the foreground image, which is free after the bands
         if (filter->send_mask_events) {
-            GArray       *data_array;
-
-            // prepare and send custom event with the mask surface
-            data_array = g_array_sized_new(FALSE, FALSE, sizeof(filter->mask->imageData[0]), filter->mask->imageSize);
-            g_array_append_vals(data_array, filter->mask->imageData, filter->mask->imageSize);
-
-            structure = gst_structure_new("bgfg-mask",
-                                          "data",      G_TYPE_POINTER, data_array,
-                                          "width",     G_TYPE_UINT, filter->mask->width,
-                                          "height",    G_TYPE_UINT, filter->mask->height,
-                                          "depth",     G_TYPE_UINT, filter->mask->depth,
-                                          "channels",  G_TYPE_UINT, filter->mask->nChannels,
-                                          "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                          NULL);
-
-            event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-            gst_pad_push_event(filter->srcpad, event);
-            g_array_unref(data_array);
+            GstEvent *event;
 
-            if (filter->display) {
-                // shade the regions not selected by the codebook algorithm
-                cvXorS(filter->mask,  CV_RGB(255, 255, 255), filter->mask,  NULL);
-                cvSubS(filter->image, CV_RGB(191, 191, 191), filter->image, filter->mask);
-                cvXorS(filter->mask,  CV_RGB(255, 255, 255), filter->mask,  NULL);
+            event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM,
+                                         fg_mask_to_structure(mask_buffer, filter->mask,
+                                                              GST_BUFFER_TIMESTAMP(buf), "bgfg-mask"));
+            gst_pad_push_event(filter->srcpad, event);
+        }
 
-            }
+        if (filter->send_mask_events && filter->display) {
+            // shade the regions not selected by the codebook algorithm
+            cvNot(filter->mask, filter->fg_image);
+            cvSubS(filter->image, CV_RGB(191, 191, 191), filter->image, filter->fg_image);
         }
 
         if (filter->send_roi_events) {
@@ -446,8 +506,10 @@ gst_bgfg_codebook_chain(GstPad *pad, GstBuffer *buf)
             CvRect       *bounding_rects;
             guint         i, j, n_rects;
 
+            cvCopy(filter->mask, filter->fg_image, NULL);
+
             storage  = cvCreateMemStorage(0);
-            contours = cvSegmentFGMask(filter->mask, filter->convex_hull ? 0 : 1,
+            contours = cvSegmentFGMask(filter->fg_image, filter->convex_hull ? 0 : 1,
                                        filter->perimeter_scale, storage, cvPoint(0, 0));
 
             // count # of contours, allocate array to store the bounding rectangles
@@ -473,24 +535,13 @@ gst_bgfg_codebook_chain(GstPad *pad, GstBuffer *buf)
             }
 
             for (i = 0; i < n_rects; ++i) {
-                GstEvent     *event;
-                GstStructure *structure;
                 CvRect        r;
 
                 // skip collapsed rectangles
                 r = bounding_rects[i];
                 if ((r.width == 0) || (r.height == 0)) continue;
 
-                structure = gst_structure_new("bgfg-roi",
-                                              "x",         G_TYPE_UINT,   r.x,
-                                              "y",         G_TYPE_UINT,   r.y,
-                                              "width",     G_TYPE_UINT,   r.width,
-                                              "height",    G_TYPE_UINT,   r.height,
-                                              "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                              NULL);
-
-                event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-                gst_pad_send_event(filter->sinkpad, event);
+                detections_array_add(filter->roi_detections, r, 1.0f);
 
                 if (filter->verbose)
                     GST_INFO("[roi] x: %d, y: %d, width: %d, height: %d\n",
@@ -503,17 +554,120 @@ gst_bgfg_codebook_chain(GstPad *pad, GstBuffer *buf)
 
             cvReleaseMemStorage(&storage);
             g_free(bounding_rects);
+
+            // send all the ROIs found on this frame in a single event
+            if (filter->roi_detections->len > 0) {
+                gst_pad_push_event(filter->srcpad,
+                                   detections_event_new(DETECTION_SOURCE_BGFG, GST_BUFFER_TIMESTAMP(buf),
+                                                        filter->roi_detections));
+                g_array_set_size(filter->roi_detections, 0);
+            }
         }
 
+        gst_buffer_unref(mask_buffer);
+
         if (filter->display)
             gst_buffer_set_data(buf, (guchar*) filter->image->imageData, filter->image->imageSize);
     }
 
-    cvReleaseImage(&yuv_image);
-
     return gst_pad_push(filter->srcpad, buf);
 }
 
+// processes one band of the frame, according to 'filter->band_operation'.
+// The bands only write their own rows of the YCrCb, foreground and mask
+// images, so they can run concurrently
+static void
+process_band(gpointer task, gpointer user_data)
+{
+    GstBgFgCodebook *filter;
+    CodebookBand    *band;
+    CvMat            image, yuv, fg, mask;
+
+    filter = GST_BGFG_CODEBOOK(user_data);
+    band   = (CodebookBand*) task;
+
+    switch (filter->band_operation) {
+        case CODEBOOK_BAND_UPDATE:
+            cvGetSubRect(filter->image, &image, band->rect);
+            cvGetSubRect(filter->yuv_image, &yuv, band->rect);
+            cvCvtColor(&image, &yuv, CV_BGR2YCrCb); //YUV For codebook method
+            cvBGCodeBookUpdate(band->model, &yuv, NULL_RECT, 0);
+            break;
+
+        case CODEBOOK_BAND_DIFF:
+            if (filter->clear_stale)
+                cvBGCodeBookClearStale(band->model, band->model->t / 2, NULL_RECT, 0);
+
+            cvGetSubRect(filter->image, &image, band->rect);
+            cvGetSubRect(filter->yuv_image, &yuv, band->rect);
+            cvCvtColor(&image, &yuv, CV_BGR2YCrCb); //YUV For codebook method
+
+            // without erode/dilate there is no second pass, so the band is
+            // segmented straight into the mask
+            if ((filter->n_erode_iterations > 0) || (filter->n_dilate_iterations > 0))
+                cvGetSubRect(filter->fg_image, &fg, band->rect);
+            else
+                cvGetSubRect(filter->mask, &fg, band->rect);
+            cvBGCodeBookDiff(band->model, &yuv, &fg, NULL_RECT);
+            break;
+
+        case CODEBOOK_BAND_MORPHOLOGY: {
+            CvRect   halo_rect;
+            CvMat    scratch;
+            gint     halo, bottom;
+
+            // each iteration of the 3x3 erode/dilate reads one row above and
+            // below, so the band is filtered with as many extra rows on each
+            // side, which are then discarded
+            halo        = filter->n_erode_iterations + filter->n_dilate_iterations;
+            halo_rect   = band->rect;
+            halo_rect.y = MAX(band->rect.y - halo, 0);
+            bottom      = MIN(band->rect.y + band->rect.height + halo, filter->fg_image->height);
+            halo_rect.height = bottom - halo_rect.y;
+
+            if ((band->scratch == NULL) || (band->scratch->rows != halo_rect.height)) {
+                if (band->scratch) cvReleaseMat(&band->scratch);
+                band->scratch = cvCreateMat(halo_rect.height, halo_rect.width, CV_8UC1);
+            }
+
+            cvGetSubRect(filter->fg_image, &fg, halo_rect);
+            cvCopy(&fg, band->scratch, NULL);
+
+            // exclude artifacts and irrelevant objects
+            if (filter->n_erode_iterations > 0)
+                cvErode(band->scratch, band->scratch, NULL, filter->n_erode_iterations);
+            if (filter->n_dilate_iterations > 0)
+                cvDilate(band->scratch, band->scratch, NULL, filter->n_dilate_iterations);
+
+            cvGetSubRect(band->scratch, &scratch,
+                         cvRect(0, band->rect.y - halo_rect.y, band->rect.width, band->rect.height));
+            cvGetSubRect(filter->mask, &mask, band->rect);
+            cvCopy(&scratch, &mask, NULL);
+            break;
+        }
+    }
+}
+
+static void
+free_bands(GstBgFgCodebook *filter)
+{
+    guint i;
+
+    // the workers go first, since they may still reference the bands
+    if (filter->workers) worker_pool_free(filter->workers);
+    filter->workers = NULL;
+
+    for (i = 0; i < filter->n_bands; ++i) {
+        if (filter->bands[i].model) cvReleaseBGCodeBookModel(&filter->bands[i].model);
+        if (filter->bands[i].scratch) cvReleaseMat(&filter->bands[i].scratch);
+    }
+    g_free(filter->bands);
+    g_free(filter->band_tasks);
+    filter->bands      = NULL;
+    filter->band_tasks = NULL;
+    filter->n_bands    = 0;
+}
+
 static inline gboolean
 rect_overlap(const CvRect r1, const CvRect r2)
 {
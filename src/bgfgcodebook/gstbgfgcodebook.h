@@ -51,6 +51,10 @@
 #include <cv.h>
 #include <cvaux.h>
 
+#include "detections.h"
+#include "fg-mask.h"
+#include "worker-pool.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_BGFG_CODEBOOK            (gst_bgfg_codebook_get_type())
@@ -61,6 +65,14 @@ G_BEGIN_DECLS
 
 typedef struct _GstBgFgCodebook GstBgFgCodebook;
 typedef struct _GstBgFgCodebookClass GstBgFgCodebookClass;
+typedef struct _CodebookBand CodebookBand;
+
+// the work done by each band on a 'worker_pool_run' call
+typedef enum {
+    CODEBOOK_BAND_UPDATE,
+    CODEBOOK_BAND_DIFF,
+    CODEBOOK_BAND_MORPHOLOGY
+} CodebookBandOperation;
 
 struct _GstBgFgCodebook
 {
@@ -70,8 +82,25 @@ struct _GstBgFgCodebook
     GstPad                  *srcpad;
 
     IplImage                *image;
+    IplImage                *yuv_image;
+    IplImage                *fg_image;
     IplImage                *mask;
-    CvBGCodeBookModel       *model;
+    FgMaskPool              *mask_pool;
+    GArray                  *roi_detections;
+
+    // the frame is split in horizontal bands, each with its own codebook
+    // model, processed in parallel by the workers
+    CodebookBand            *bands;
+    gpointer                *band_tasks;
+    guint                    n_bands;
+    CodebookBandOperation    band_operation;
+    gboolean                 clear_stale;
+    WorkerPool              *workers;
+    guint                    n_workers;
+
+    guint                    model_min;
+    guint                    model_max;
+    guint                    model_bounds;
 
     guint                    n_frames_learn_bg;
     guint                    n_frames;
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "assignment.h"
+
+#include <float.h>
+
+// the rows and columns of the candidates are nodes of one graph; the groups
+// to solve are its connected components, found with a union-find
+static guint
+find_root(guint *parent, guint node)
+{
+    guint root = node;
+
+    while (parent[root] != root)
+        root = parent[root];
+    while (parent[node] != root) {
+        guint next = parent[node];
+        parent[node] = root;
+        node = next;
+    }
+    return root;
+}
+
+/* Hungarian method on a square n x n cost matrix, minimising the total cost;
+ * col_of_row receives the column assigned to each row. O(n^3), with the row
+ * and column potentials of the shortest augmenting path formulation. */
+static void
+hungarian(const gdouble *cost, guint n, gint *col_of_row)
+{
+    gdouble *u, *v, *min_v;
+    guint   *row_of_col, *way;
+    gboolean *used;
+    guint    i, j, j0, j1, i0;
+    gdouble  delta, cur;
+
+    // one more column than the matrix: column 0 is the free start of each path
+    u          = g_new0(gdouble, n + 1);
+    v          = g_new0(gdouble, n + 1);
+    min_v      = g_new(gdouble, n + 1);
+    row_of_col = g_new0(guint, n + 1);
+    way        = g_new0(guint, n + 1);
+    used       = g_new(gboolean, n + 1);
+
+    for (i = 1; i <= n; ++i) {
+        row_of_col[0] = i;
+        j0 = 0;
+        for (j = 0; j <= n; ++j) {
+            min_v[j] = DBL_MAX;
+            used[j]  = FALSE;
+        }
+
+        do {
+            used[j0] = TRUE;
+            i0       = row_of_col[j0];
+            delta    = DBL_MAX;
+            j1       = 0;
+            for (j = 1; j <= n; ++j) {
+                if (used[j])
+                    continue;
+                cur = cost[(i0 - 1) * n + (j - 1)] - u[i0] - v[j];
+                if (cur < min_v[j]) {
+                    min_v[j] = cur;
+                    way[j]   = j0;
+                }
+                if (min_v[j] < delta) {
+                    delta = min_v[j];
+                    j1    = j;
+                }
+            }
+            for (j = 0; j <= n; ++j) {
+                if (used[j]) {
+                    u[row_of_col[j]] += delta;
+                    v[j]             -= delta;
+                } else
+                    min_v[j] -= delta;
+            }
+            j0 = j1;
+        } while (row_of_col[j0] != 0);
+
+        do {
+            j1             = way[j0];
+            row_of_col[j0] = row_of_col[j1];
+            j0             = j1;
+        } while (j0 != 0);
+    }
+
+    for (j = 1; j <= n; ++j)
+        col_of_row[row_of_col[j] - 1] = j - 1;
+
+    g_free(u);
+    g_free(v);
+    g_free(min_v);
+    g_free(row_of_col);
+    g_free(way);
+    g_free(used);
+}
+
+void
+assignment_solve(const AssignmentPair *pairs, guint n_pairs, guint n_rows, guint n_cols, gint *col_of_row)
+{
+    guint   *parent, *first, *next, *local, *rows, *cols;
+    gint    *local_match;
+    gdouble *cost;
+    guint    i, k, root, n_local_rows, n_local_cols, n;
+
+    for (i = 0; i < n_rows; ++i)
+        col_of_row[i] = -1;
+    if (n_pairs == 0)
+        return;
+
+    // rows are nodes 0..n_rows-1, columns follow them
+    parent = g_new(guint, n_rows + n_cols);
+    for (i = 0; i < n_rows + n_cols; ++i)
+        parent[i] = i;
+    for (k = 0; k < n_pairs; ++k) {
+        guint a = find_root(parent, pairs[k].row);
+        guint b = find_root(parent, n_rows + pairs[k].col);
+        if (a != b)
+            parent[a] = b;
+    }
+
+    // the candidates of each component, chained from its root
+    first = g_new(guint, n_rows + n_cols);
+    next  = g_new(guint, n_pairs);
+    for (i = 0; i < n_rows + n_cols; ++i)
+        first[i] = G_MAXUINT;
+    for (k = n_pairs; k-- > 0; ) {
+        root     = find_root(parent, pairs[k].row);
+        next[k]  = first[root];
+        first[root] = k;
+    }
+
+    local = g_new(guint, n_rows + n_cols);
+    rows  = g_new(guint, n_rows);
+    cols  = g_new(guint, n_cols);
+    for (i = 0; i < n_rows + n_cols; ++i)
+        local[i] = G_MAXUINT;
+
+    for (root = 0; root < n_rows + n_cols; ++root) {
+        if (first[root] == G_MAXUINT)
+            continue;
+
+        // a single candidate needs no solving
+        if (next[first[root]] == G_MAXUINT) {
+            col_of_row[pairs[first[root]].row] = pairs[first[root]].col;
+            continue;
+        }
+
+        // local indices of the rows and columns of the component
+        n_local_rows = n_local_cols = 0;
+        for (k = first[root]; k != G_MAXUINT; k = next[k]) {
+            if (local[pairs[k].row] == G_MAXUINT) {
+                local[pairs[k].row] = n_local_rows;
+                rows[n_local_rows++] = pairs[k].row;
+            }
+            if (local[n_rows + pairs[k].col] == G_MAXUINT) {
+                local[n_rows + pairs[k].col] = n_local_cols;
+                cols[n_local_cols++] = pairs[k].col;
+            }
+        }
+
+        // square matrix of negated scores; the pairs that are not candidates
+        // cost 0, the same as leaving their row unpaired, so that they are
+        // only chosen where the row or the column stays unpaired anyway
+        n           = MAX(n_local_rows, n_local_cols);
+        cost        = g_new0(gdouble, n * n);
+        local_match = g_new(gint, n);
+        for (k = first[root]; k != G_MAXUINT; k = next[k])
+            cost[local[pairs[k].row] * n + local[n_rows + pairs[k].col]] = -pairs[k].score;
+
+        hungarian(cost, n, local_match);
+
+        for (i = 0; i < n_local_rows; ++i) {
+            gint j = local_match[i];
+            if (j < (gint) n_local_cols && cost[i * n + j] < 0)
+                col_of_row[rows[i]] = cols[j];
+        }
+
+        for (i = 0; i < n_local_rows; ++i)
+            local[rows[i]] = G_MAXUINT;
+        for (i = 0; i < n_local_cols; ++i)
+            local[n_rows + cols[i]] = G_MAXUINT;
+        g_free(cost);
+        g_free(local_match);
+    }
+
+    g_free(parent);
+    g_free(first);
+    g_free(next);
+    g_free(local);
+    g_free(rows);
+    g_free(cols);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef __GST_OPENCV_COMMON_ASSIGNMENT__
+#define __GST_OPENCV_COMMON_ASSIGNMENT__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// optimal one-to-one pairing of rows (e.g. detections) with columns (e.g.
+// trackers): of the candidate pairs given, it chooses those whose scores add
+// up to the most, each row and each column being used at most once. Only the
+// candidates are considered, so that gating the pairs beforehand keeps the
+// work small; the candidates are split in independent groups, each of which
+// is solved exactly with the Hungarian method. Scores must be positive.
+
+typedef struct {
+    guint   row;
+    guint   col;
+    gfloat  score;
+} AssignmentPair;
+
+// col_of_row[row] receives the column paired with row, or -1
+void        assignment_solve          (const AssignmentPair *pairs,
+                                       guint           n_pairs,
+                                       guint           n_rows,
+                                       guint           n_cols,
+                                       gint           *col_of_row);
+
+G_END_DECLS
+
+#endif // __GST_OPENCV_COMMON_ASSIGNMENT__
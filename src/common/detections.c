@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "detections.h"
+
+#include <string.h>
+
+#define DETECTIONS_EVENT_NAME "detections"
+
+static GQuark
+detections_quark()
+{
+    static GQuark quark = 0;
+
+    if (G_UNLIKELY(quark == 0))
+        quark = g_quark_from_static_string(DETECTIONS_EVENT_NAME);
+    return quark;
+}
+
+GArray*
+detections_array_new()
+{
+    return g_array_sized_new(FALSE, FALSE, sizeof(Detection), 16);
+}
+
+void
+detections_array_add(GArray *array, CvRect rect, gfloat score)
+{
+    Detection detection;
+
+    detection.rect  = rect;
+    detection.score = score;
+    g_array_append_val(array, detection);
+}
+
+GstEvent*
+detections_event_new(DetectionSource source, GstClockTime timestamp, const GArray *array)
+{
+    GstBuffer    *buffer;
+    GstStructure *structure;
+
+    buffer = gst_buffer_new_and_alloc(array->len * sizeof(Detection));
+    memcpy(GST_BUFFER_DATA(buffer), array->data, GST_BUFFER_SIZE(buffer));
+    GST_BUFFER_TIMESTAMP(buffer) = timestamp;
+
+    structure = gst_structure_new(DETECTIONS_EVENT_NAME,
+                                  "source",    G_TYPE_UINT,     source,
+                                  "buffer",    GST_TYPE_BUFFER, buffer,
+                                  "timestamp", G_TYPE_UINT64,   timestamp,
+                                  NULL);
+
+    // the structure holds its own reference to the buffer
+    gst_buffer_unref(buffer);
+
+    return gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+}
+
+gboolean
+detections_update_from_event(GstEvent *event, DetectionSource source, GstBuffer **detections)
+{
+    const GstStructure *structure;
+    const GValue       *value;
+    guint               event_source;
+
+    structure = gst_event_get_structure(event);
+    if ((structure == NULL) || (gst_structure_get_name_id(structure) != detections_quark()))
+        return FALSE;
+
+    if (!gst_structure_get_uint(structure, "source", &event_source) || (event_source != source))
+        return FALSE;
+
+    if ((value = gst_structure_get_value(structure, "buffer")) == NULL)
+        return FALSE;
+
+    gst_buffer_replace(detections, gst_value_get_buffer(value));
+    return TRUE;
+}
+
+guint
+detections_count(const GstBuffer *detections)
+{
+    return (detections != NULL) ? GST_BUFFER_SIZE(detections) / sizeof(Detection) : 0;
+}
+
+const Detection*
+detections_get(const GstBuffer *detections, guint index)
+{
+    return &((const Detection*) GST_BUFFER_DATA(detections))[index];
+}
+
+GstClockTime
+detections_timestamp(const GstBuffer *detections)
+{
+    return (detections != NULL) ? GST_BUFFER_TIMESTAMP(detections) : GST_CLOCK_TIME_NONE;
+}
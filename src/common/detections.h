@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_OPENCV_COMMON_DETECTIONS__
+#define __GST_OPENCV_COMMON_DETECTIONS__
+
+#include <gst/gst.h>
+#include <cv.h>
+
+// detectors publish all the rectangles found on a frame at once, packed in
+// a single GstBuffer (timestamped with the frame's timestamp) carried by a
+// "detections" downstream event; consumers keep a reference to the buffer
+// and read the packed array through the accessors below
+
+typedef enum   _DetectionSource DetectionSource;
+typedef struct _Detection       Detection;
+
+enum _DetectionSource
+{
+    DETECTION_SOURCE_BGFG,        // bgfgcodebook, bgfgacmmm2003
+    DETECTION_SOURCE_HAAR_DETECT, // haardetect
+    DETECTION_SOURCE_HAAR_ADJUST, // haaradjust
+    DETECTION_SOURCE_HOG_DETECT   // hogdetect
+};
+
+struct _Detection
+{
+    CvRect  rect;
+    gfloat  score; // detector specific; 1.0 if the detector has no score
+};
+
+GArray*          detections_array_new         ();
+
+void             detections_array_add         (GArray          *array,
+                                               CvRect           rect,
+                                               gfloat           score);
+
+GstEvent*        detections_event_new         (DetectionSource  source,
+                                               GstClockTime     timestamp,
+                                               const GArray    *array);
+
+gboolean         detections_update_from_event (GstEvent        *event,
+                                               DetectionSource  source,
+                                               GstBuffer      **detections);
+
+guint            detections_count             (const GstBuffer *detections);
+
+const Detection* detections_get               (const GstBuffer *detections,
+                                               guint            index);
+
+GstClockTime     detections_timestamp         (const GstBuffer *detections);
+
+#endif // __GST_OPENCV_COMMON_DETECTIONS__
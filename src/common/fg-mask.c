@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "fg-mask.h"
+
+struct _FgMaskPool
+{
+    GPtrArray *buffers;
+    guint      buffer_size;
+    guint      max_buffers;
+};
+
+FgMaskPool*
+fg_mask_pool_new(const IplImage *header, guint max_buffers)
+{
+    FgMaskPool *pool;
+
+    pool              = g_new0(FgMaskPool, 1);
+    pool->buffers     = g_ptr_array_sized_new(max_buffers);
+    pool->buffer_size = header->imageSize;
+    pool->max_buffers = max_buffers;
+
+    return pool;
+}
+
+void
+fg_mask_pool_free(FgMaskPool *pool)
+{
+    guint i;
+
+    // buffers still held downstream are released by their last owner
+    for (i = 0; i < pool->buffers->len; ++i)
+        gst_buffer_unref(GST_BUFFER(g_ptr_array_index(pool->buffers, i)));
+
+    g_ptr_array_free(pool->buffers, TRUE);
+    g_free(pool);
+}
+
+GstBuffer*
+fg_mask_pool_acquire(FgMaskPool *pool)
+{
+    GstBuffer *buffer;
+    guint      i;
+
+    // a buffer referenced only by the pool isn't used by anyone else anymore
+    for (i = 0; i < pool->buffers->len; ++i) {
+        buffer = GST_BUFFER(g_ptr_array_index(pool->buffers, i));
+        if (GST_MINI_OBJECT_REFCOUNT_VALUE(buffer) == 1)
+            return gst_buffer_ref(buffer);
+    }
+
+    // all pooled buffers are busy; grow the pool up to its limit, after that
+    // hand out untracked buffers which are simply freed by their last owner
+    buffer = gst_buffer_new_and_alloc(pool->buffer_size);
+    if (pool->buffers->len < pool->max_buffers)
+        g_ptr_array_add(pool->buffers, gst_buffer_ref(buffer));
+
+    return buffer;
+}
+
+GstStructure*
+fg_mask_to_structure(GstBuffer *buffer, const IplImage *header, GstClockTime timestamp, const gchar *name)
+{
+    return gst_structure_new(name,
+                             "buffer",    GST_TYPE_BUFFER, buffer,
+                             "width",     G_TYPE_UINT,     header->width,
+                             "height",    G_TYPE_UINT,     header->height,
+                             "depth",     G_TYPE_UINT,     header->depth,
+                             "channels",  G_TYPE_UINT,     header->nChannels,
+                             "timestamp", G_TYPE_UINT64,   timestamp,
+                             NULL);
+}
+
+gboolean
+fg_mask_from_structure(const GstStructure *structure, FgMask *mask)
+{
+    const GValue *value;
+    GstBuffer    *buffer;
+    GstClockTime  timestamp;
+    guint         width, height, depth, channels;
+
+    if ((value = gst_structure_get_value(structure, "buffer")) == NULL)
+        return FALSE;
+
+    gst_structure_get((GstStructure*) structure,
+                      "width",     G_TYPE_UINT,   &width,
+                      "height",    G_TYPE_UINT,   &height,
+                      "depth",     G_TYPE_UINT,   &depth,
+                      "channels",  G_TYPE_UINT,   &channels,
+                      "timestamp", G_TYPE_UINT64, &timestamp,
+                      NULL);
+
+    // the image header is kept as long as the mask geometry doesn't change
+    if ((mask->image != NULL) &&
+        ((mask->image->width != (gint) width) || (mask->image->height    != (gint) height) ||
+         (mask->image->depth != (gint) depth) || (mask->image->nChannels != (gint) channels)))
+        cvReleaseImageHeader(&mask->image);
+    if (mask->image == NULL)
+        mask->image = cvCreateImageHeader(cvSize(width, height), depth, channels);
+
+    // hold a reference to the shared buffer instead of copying its contents
+    buffer = gst_buffer_ref(gst_value_get_buffer(value));
+    if (mask->buffer != NULL)
+        gst_buffer_unref(mask->buffer);
+
+    mask->buffer    = buffer;
+    mask->timestamp = timestamp;
+    cvSetData(mask->image, GST_BUFFER_DATA(buffer), mask->image->widthStep);
+
+    return TRUE;
+}
+
+void
+fg_mask_clear(FgMask *mask)
+{
+    if (mask->buffer != NULL)
+        gst_buffer_unref(mask->buffer);
+    if (mask->image != NULL)
+        cvReleaseImageHeader(&mask->image);
+
+    mask->buffer    = NULL;
+    mask->image     = NULL;
+    mask->timestamp = GST_CLOCK_TIME_NONE;
+}
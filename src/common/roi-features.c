@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "roi-features.h"
+
+void
+roi_features_find(CvArr *gray, CvArr *mask, CvRect roi, CvPoint2D32f *features, guint *n_features,
+                  gdouble quality_level, gdouble min_distance, gint subpix_win_size, CvTermCriteria criteria)
+{
+    CvMat gray_roi, mask_roi, *mask_view;
+    int   count;
+    guint i;
+
+    cvGetSubRect(gray, &gray_roi, roi);
+    mask_view = NULL;
+    if (mask != NULL)
+        mask_view = cvGetSubRect(mask, &mask_roi, roi);
+
+    count = *n_features;
+    cvGoodFeaturesToTrack(&gray_roi, NULL, NULL, features, &count, quality_level, min_distance, mask_view,
+                          3, 0, 0.04); // 3, 0, 0.04 => opencv defaults
+    *n_features = count;
+
+    // move the features to frame coordinates; the sub-pixel refinement runs
+    // on the whole frame so that windows close to the ROI borders still see
+    // the actual neighbouring pixels
+    for (i = 0; i < *n_features; ++i) {
+        features[i].x += roi.x;
+        features[i].y += roi.y;
+    }
+
+    if (*n_features > 0)
+        cvFindCornerSubPix(gray, features, *n_features, cvSize(subpix_win_size, subpix_win_size),
+                           cvSize(-1, -1), criteria);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+
+#include "spatial-index.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+typedef struct {
+    gint    cx;
+    gint    cy;
+    guint   item;
+} CellEntry;
+
+// floor of v / cell_size, for negative coordinates too
+static gint
+cell_of(gint v, gint cell_size)
+{
+    return (v >= 0) ? v / cell_size : -((cell_size - 1 - v) / cell_size);
+}
+
+static gint
+compare_cell_entries(gconstpointer a, gconstpointer b)
+{
+    const CellEntry *ea = (const CellEntry*) a;
+    const CellEntry *eb = (const CellEntry*) b;
+
+    if (ea->cy != eb->cy) return (ea->cy < eb->cy) ? -1 : 1;
+    if (ea->cx != eb->cx) return (ea->cx < eb->cx) ? -1 : 1;
+    if (ea->item != eb->item) return (ea->item < eb->item) ? -1 : 1;
+    return 0;
+}
+
+static gint
+compare_pairs(gconstpointer a, gconstpointer b)
+{
+    const SpatialPair *pa = (const SpatialPair*) a;
+    const SpatialPair *pb = (const SpatialPair*) b;
+
+    if (pa->a != pb->a) return (pa->a < pb->a) ? -1 : 1;
+    if (pa->b != pb->b) return (pa->b < pb->b) ? -1 : 1;
+    return 0;
+}
+
+// squared gap between the rects, taken as closed intervals
+static gfloat
+rects_gap2(const CvRect *a, const CvRect *b)
+{
+    gint dx, dy;
+
+    dx = MAX(a->x, b->x) - MIN(a->x + MAX(a->width, 0),  b->x + MAX(b->width, 0));
+    dy = MAX(a->y, b->y) - MIN(a->y + MAX(a->height, 0), b->y + MAX(b->height, 0));
+    dx = MAX(dx, 0);
+    dy = MAX(dy, 0);
+
+    return (gfloat) dx * dx + (gfloat) dy * dy;
+}
+
+void
+spatial_index_find_pairs(const CvRect *rects, guint n_rects, gfloat max_distance, GArray *pairs)
+{
+    GArray    *entries;
+    CellEntry  entry;
+    gint      *x0, *y0, *x1, *y1;
+    gfloat     max_distance2;
+    gint       margin, cell_size, cx, cy;
+    gint64     sum_size;
+    guint      i, first, last, p, q, n_before;
+
+    if (n_rects < 2)
+        return;
+
+    // rects grown by half the distance on each side overlap if they are close
+    // enough, whatever the axis
+    max_distance  = MAX(max_distance, 0.0f);
+    max_distance2 = max_distance * max_distance;
+    margin        = (gint) ceilf(max_distance / 2);
+    x0 = g_new(gint, n_rects);
+    y0 = g_new(gint, n_rects);
+    x1 = g_new(gint, n_rects);
+    y1 = g_new(gint, n_rects);
+
+    sum_size = 0;
+    for (i = 0; i < n_rects; ++i) {
+        x0[i] = rects[i].x - margin;
+        y0[i] = rects[i].y - margin;
+        x1[i] = rects[i].x + MAX(rects[i].width, 0) + margin;
+        y1[i] = rects[i].y + MAX(rects[i].height, 0) + margin;
+        sum_size += MAX(x1[i] - x0[i], y1[i] - y0[i]) + 1;
+    }
+    cell_size = MAX((gint) (sum_size / n_rects), 1);
+
+    entries = g_array_new(FALSE, FALSE, sizeof(CellEntry));
+    for (i = 0; i < n_rects; ++i) {
+        for (cy = cell_of(y0[i], cell_size); cy <= cell_of(y1[i], cell_size); ++cy) {
+            for (cx = cell_of(x0[i], cell_size); cx <= cell_of(x1[i], cell_size); ++cx) {
+                entry.cx   = cx;
+                entry.cy   = cy;
+                entry.item = i;
+                g_array_append_val(entries, entry);
+            }
+        }
+    }
+    g_array_sort(entries, compare_cell_entries);
+
+    n_before = pairs->len;
+    for (first = 0; first < entries->len; first = last) {
+        CellEntry *cell = &g_array_index(entries, CellEntry, first);
+
+        for (last = first + 1; last < entries->len; ++last) {
+            CellEntry *other = &g_array_index(entries, CellEntry, last);
+            if (other->cx != cell->cx || other->cy != cell->cy) break;
+        }
+
+        for (p = first; p < last; ++p) {
+            for (q = p + 1; q < last; ++q) {
+                SpatialPair pair;
+
+                pair.a = g_array_index(entries, CellEntry, p).item;
+                pair.b = g_array_index(entries, CellEntry, q).item;
+
+                if (rects_gap2(&rects[pair.a], &rects[pair.b]) > max_distance2)
+                    continue;
+
+                // a pair shares every cell its grown rects overlap in; only
+                // the one holding the corner of the overlap reports it
+                if (cell_of(MAX(x0[pair.a], x0[pair.b]), cell_size) != cell->cx ||
+                    cell_of(MAX(y0[pair.a], y0[pair.b]), cell_size) != cell->cy)
+                    continue;
+
+                g_array_append_val(pairs, pair);
+            }
+        }
+    }
+
+    if (pairs->len > n_before + 1)
+        qsort(&g_array_index(pairs, SpatialPair, n_before), pairs->len - n_before,
+              sizeof(SpatialPair), compare_pairs);
+
+    g_array_free(entries, TRUE);
+    g_free(x0);
+    g_free(y0);
+    g_free(x1);
+    g_free(y1);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+
+#ifndef __GST_OPENCV_COMMON_SPATIAL_INDEX__
+#define __GST_OPENCV_COMMON_SPATIAL_INDEX__
+
+#include <glib.h>
+#include <cv.h>
+
+G_BEGIN_DECLS
+
+// broad phase for the elements that relate every pair of objects of a frame:
+// the rects are binned in a uniform grid, about the size of a rect, and only
+// the rects sharing a cell are compared, so that crowds don't cost a test per
+// pair. A pair is found when the gap between its rects is at most
+// max_distance; with 0, the rects must touch or overlap.
+
+typedef struct {
+    guint   a;
+    guint   b;
+} SpatialPair;
+
+// appends the pairs to 'pairs' (a GArray of SpatialPair), each once and with
+// a < b, sorted by a and then by b, as a double loop over the rects would be
+void        spatial_index_find_pairs  (const CvRect   *rects,
+                                       guint           n_rects,
+                                       gfloat          max_distance,
+                                       GArray         *pairs);
+
+G_END_DECLS
+
+#endif // __GST_OPENCV_COMMON_SPATIAL_INDEX__
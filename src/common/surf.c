@@ -4,151 +4,558 @@
 
 #include "surf.h"
 
-double
-compareSURFDescriptors(const float* d1, const float* d2, double best, int length)
+#include <string.h>
+
+// SIMD distance kernels, selected at runtime
+#if defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define SURF_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define SURF_DISTANCE_BLOCK   16
+#define SURF_BLOCK_CANDIDATES 4
+#define SURF_INDEX_LEAF_SIZE  8
+
+typedef double (*SurfDistanceFunc) (const float *d1, const float *d2, double best, int length);
+typedef void   (*SurfDistanceBlockFunc) (const float *vec, const float *candidates, int n, int length,
+                                         double best, double *dists);
+
+typedef struct {
+    const char            *name;
+    SurfDistanceFunc       distance;
+    SurfDistanceBlockFunc  block;
+} SurfKernel;
+
+typedef struct _SurfIndexNode   SurfIndexNode;
+typedef struct _SurfIndexTree   SurfIndexTree;
+typedef struct _SurfIndexBranch SurfIndexBranch;
+
+struct _SurfIndexNode {
+    int   dim;   // split dimension; -1 on leaves
+    float value; // split value
+    int   left;  // children on inner nodes; [left, right) descriptor range on leaves
+    int   right;
+};
+
+struct _SurfIndexTree {
+    float  *descriptors; // packed in leaf order
+    int    *ids;         // index of each packed descriptor in the source points
+    int     total;
+    GArray *nodes;       // the root is the first node
+};
+
+struct _SurfIndexBranch {
+    int    node;
+    double bound;        // lower bound of the distance to any descriptor under 'node'
+};
+
+struct _SurfIndex {
+    int              length;
+    int              max_checks;
+    SurfIndexTree    trees[3]; // laplacian -1, 0 and 1
+    SurfIndexBranch *heap;
+    int              heap_size;
+};
+
+// the distance kernels accumulate in single precision and only check for
+// early termination every SURF_DISTANCE_BLOCK elements, so that the inner
+// loop can be vectorised; the returned value is only meaningful when it is
+// below 'best' (otherwise it is a partial sum, already above 'best').
+// All of them accumulate in the same order: element j into lane j % 4, the
+// lanes summed as (0 + 2) + (1 + 3) after each block; so they give the same
+// distances, and the same matches, whatever the kernel the host selects.
+static double
+surfDistanceScalar(const float* d1, const float* d2, double best, int length)
 {
+    float total_cost;
+    int   i, j;
+
+    for (i = 0, total_cost = 0.f; i < length; i += SURF_DISTANCE_BLOCK) {
+        float t[4] = {0.f, 0.f, 0.f, 0.f};
+        int   end  = MIN(i + SURF_DISTANCE_BLOCK, length);
+
+        for (j = i; j < end; j += 4) {
+            float t0 = d1[j] - d2[j];
+            float t1 = d1[j + 1] - d2[j + 1];
+            float t2 = d1[j + 2] - d2[j + 2];
+            float t3 = d1[j + 3] - d2[j + 3];
+            t[0] += t0 * t0;
+            t[1] += t1 * t1;
+            t[2] += t2 * t2;
+            t[3] += t3 * t3;
+        }
+        total_cost += (t[0] + t[2]) + (t[1] + t[3]);
+        if (total_cost > best)
+            break;
+    }
+    return total_cost;
+}
 
-    int i;
-    double total_cost;
+// the block kernels compare the query against SURF_BLOCK_CANDIDATES
+// candidates at once, so that each part of the query is loaded once for all
+// of them; they stop when all of them are above 'best'. The remaining
+// candidates are compared one by one.
+static void
+surfDistanceBlockScalar(const float* vec, const float* candidates, int n, int length, double best, double* dists)
+{
+    int c, i, j, k;
+
+    for (c = 0; c + SURF_BLOCK_CANDIDATES <= n; c += SURF_BLOCK_CANDIDATES) {
+        const float *cand = candidates + c * length;
+        float        total_cost[SURF_BLOCK_CANDIDATES] = {0.f, 0.f, 0.f, 0.f};
+
+        for (i = 0; i < length; i += SURF_DISTANCE_BLOCK) {
+            float    t[SURF_BLOCK_CANDIDATES][4];
+            int      end  = MIN(i + SURF_DISTANCE_BLOCK, length);
+            gboolean done = TRUE;
+
+            memset(t, 0, sizeof(t));
+            for (j = i; j < end; j += 4) {
+                for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                    const float *d2 = cand + k * length + j;
+                    float t0 = vec[j] - d2[0];
+                    float t1 = vec[j + 1] - d2[1];
+                    float t2 = vec[j + 2] - d2[2];
+                    float t3 = vec[j + 3] - d2[3];
+                    t[k][0] += t0 * t0;
+                    t[k][1] += t1 * t1;
+                    t[k][2] += t2 * t2;
+                    t[k][3] += t3 * t3;
+                }
+            }
+            for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                total_cost[k] += (t[k][0] + t[k][2]) + (t[k][1] + t[k][3]);
+                done = done && (total_cost[k] > best);
+            }
+            if (done)
+                break;
+        }
+        for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k)
+            dists[c + k] = total_cost[k];
+    }
 
-    assert(length % 4 == 0);
+    for (; c < n; ++c)
+        dists[c] = surfDistanceScalar(vec, candidates + c * length, best, length);
+}
+
+#ifdef SURF_SIMD_X86
+
+__attribute__((target("sse2")))
+static double
+surfDistanceSSE2(const float* d1, const float* d2, double best, int length)
+{
+    float total_cost;
+    int   i, j;
 
-    for (i = 0, total_cost = 0.0; i < length; i += 4) {
-        double t0 = d1[i] - d2[i];
-        double t1 = d1[i + 1] - d2[i + 1];
-        double t2 = d1[i + 2] - d2[i + 2];
-        double t3 = d1[i + 3] - d2[i + 3];
-        total_cost += t0 * t0 + t1 * t1 + t2 * t2 + t3 * t3;
+    for (i = 0, total_cost = 0.f; i < length; i += SURF_DISTANCE_BLOCK) {
+        __m128 acc = _mm_setzero_ps();
+        float  t[4];
+        int    end = MIN(i + SURF_DISTANCE_BLOCK, length);
+
+        for (j = i; j < end; j += 4) {
+            __m128 diff = _mm_sub_ps(_mm_loadu_ps(d1 + j), _mm_loadu_ps(d2 + j));
+            acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+        }
+        _mm_storeu_ps(t, acc);
+        total_cost += (t[0] + t[2]) + (t[1] + t[3]);
         if (total_cost > best)
             break;
     }
     return total_cost;
 }
 
-int
-naiveNearestNeighbor(const float* vec, const int laplacian, const CvSeq* model_keypoints,
-                     const CvSeq* model_descriptors)
+__attribute__((target("sse2")))
+static void
+surfDistanceBlockSSE2(const float* vec, const float* candidates, int n, int length, double best, double* dists)
 {
+    int c, i, j, k;
+
+    for (c = 0; c + SURF_BLOCK_CANDIDATES <= n; c += SURF_BLOCK_CANDIDATES) {
+        const float *cand = candidates + c * length;
+        float        total_cost[SURF_BLOCK_CANDIDATES] = {0.f, 0.f, 0.f, 0.f};
+
+        for (i = 0; i < length; i += SURF_DISTANCE_BLOCK) {
+            __m128   acc[SURF_BLOCK_CANDIDATES];
+            float    t[4];
+            int      end  = MIN(i + SURF_DISTANCE_BLOCK, length);
+            gboolean done = TRUE;
+
+            for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k)
+                acc[k] = _mm_setzero_ps();
+            for (j = i; j < end; j += 4) {
+                __m128 query = _mm_loadu_ps(vec + j);
+                for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                    __m128 diff = _mm_sub_ps(query, _mm_loadu_ps(cand + k * length + j));
+                    acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(diff, diff));
+                }
+            }
+            for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                _mm_storeu_ps(t, acc[k]);
+                total_cost[k] += (t[0] + t[2]) + (t[1] + t[3]);
+                done = done && (total_cost[k] > best);
+            }
+            if (done)
+                break;
+        }
+        for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k)
+            dists[c + k] = total_cost[k];
+    }
 
+    for (; c < n; ++c)
+        dists[c] = surfDistanceSSE2(vec, candidates + c * length, best, length);
+}
+
+// the squares of 8 elements are computed at once, then added to the 4 lanes
+// low half first, as the SSE2 kernel does over two steps
+__attribute__((target("avx2")))
+static double
+surfDistanceAVX2(const float* d1, const float* d2, double best, int length)
+{
+    float total_cost;
+    int   i, j;
+
+    // blocks are multiple of 8 elements except, possibly, for the last one
+    for (i = 0, total_cost = 0.f; i < length; i += SURF_DISTANCE_BLOCK) {
+        __m128 acc = _mm_setzero_ps();
+        float  t[4];
+        int    end = MIN(i + SURF_DISTANCE_BLOCK, length);
+
+        for (j = i; j + 8 <= end; j += 8) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(d1 + j), _mm256_loadu_ps(d2 + j));
+            __m256 sq   = _mm256_mul_ps(diff, diff);
+            acc = _mm_add_ps(_mm_add_ps(acc, _mm256_castps256_ps128(sq)), _mm256_extractf128_ps(sq, 1));
+        }
+        for (; j < end; j += 4) {
+            __m128 diff = _mm_sub_ps(_mm_loadu_ps(d1 + j), _mm_loadu_ps(d2 + j));
+            acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+        }
+        _mm_storeu_ps(t, acc);
+        total_cost += (t[0] + t[2]) + (t[1] + t[3]);
+        if (total_cost > best)
+            break;
+    }
+    return total_cost;
+}
+
+__attribute__((target("avx2")))
+static void
+surfDistanceBlockAVX2(const float* vec, const float* candidates, int n, int length, double best, double* dists)
+{
+    int c, i, j, k;
+
+    for (c = 0; c + SURF_BLOCK_CANDIDATES <= n; c += SURF_BLOCK_CANDIDATES) {
+        const float *cand = candidates + c * length;
+        float        total_cost[SURF_BLOCK_CANDIDATES] = {0.f, 0.f, 0.f, 0.f};
+
+        for (i = 0; i < length; i += SURF_DISTANCE_BLOCK) {
+            __m128   acc[SURF_BLOCK_CANDIDATES];
+            float    t[4];
+            int      end  = MIN(i + SURF_DISTANCE_BLOCK, length);
+            gboolean done = TRUE;
+
+            for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k)
+                acc[k] = _mm_setzero_ps();
+            for (j = i; j + 8 <= end; j += 8) {
+                __m256 query = _mm256_loadu_ps(vec + j);
+                for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                    __m256 diff = _mm256_sub_ps(query, _mm256_loadu_ps(cand + k * length + j));
+                    __m256 sq   = _mm256_mul_ps(diff, diff);
+                    acc[k] = _mm_add_ps(_mm_add_ps(acc[k], _mm256_castps256_ps128(sq)), _mm256_extractf128_ps(sq, 1));
+                }
+            }
+            for (; j < end; j += 4) {
+                __m128 query = _mm_loadu_ps(vec + j);
+                for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                    __m128 diff = _mm_sub_ps(query, _mm_loadu_ps(cand + k * length + j));
+                    acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(diff, diff));
+                }
+            }
+            for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k) {
+                _mm_storeu_ps(t, acc[k]);
+                total_cost[k] += (t[0] + t[2]) + (t[1] + t[3]);
+                done = done && (total_cost[k] > best);
+            }
+            if (done)
+                break;
+        }
+        for (k = 0; k < SURF_BLOCK_CANDIDATES; ++k)
+            dists[c + k] = total_cost[k];
+    }
+
+    for (; c < n; ++c)
+        dists[c] = surfDistanceAVX2(vec, candidates + c * length, best, length);
+}
+
+#endif // SURF_SIMD_X86
+
+// best first
+static const SurfKernel surf_kernels[] = {
+#ifdef SURF_SIMD_X86
+    { "avx2",   surfDistanceAVX2,   surfDistanceBlockAVX2 },
+    { "sse2",   surfDistanceSSE2,   surfDistanceBlockSSE2 },
+#endif
+    { "scalar", surfDistanceScalar, surfDistanceBlockScalar }
+};
+
+static const SurfKernel *surf_kernel = NULL;
+
+static gboolean
+surfKernelSupported(const SurfKernel *kernel)
+{
+#ifdef SURF_SIMD_X86
+    __builtin_cpu_init();
+    if (kernel->distance == surfDistanceAVX2)
+        return __builtin_cpu_supports("avx2");
+    if (kernel->distance == surfDistanceSSE2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return TRUE;
+}
+
+gboolean
+surfSetDistanceKernel(const char *name)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(surf_kernels); ++i) {
+        if ((name != NULL) && (strcmp(name, surf_kernels[i].name) != 0))
+            continue;
+        if (!surfKernelSupported(&surf_kernels[i]))
+            continue;
+        surf_kernel = &surf_kernels[i];
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// the kernel is selected on the first call; concurrent first calls are
+// harmless, since all of them select the same kernel
+static inline const SurfKernel*
+surfGetDistanceKernel()
+{
+    if (G_UNLIKELY(surf_kernel == NULL))
+        surfSetDistanceKernel(NULL);
+    return surf_kernel;
+}
+
+double
+compareSURFDescriptors(const float* d1, const float* d2, double best, int length)
+{
+    assert(length % 4 == 0);
+
+    return surfGetDistanceKernel()->distance(d1, d2, best, length);
+}
+
+void
+compareSURFDescriptorsBlock(const float* vec, const float* candidates, int n,
+                            int length, double best, double* dists)
+{
+    assert(length % 4 == 0);
+
+    surfGetDistanceKernel()->block(vec, candidates, n, length, best, dists);
+}
+
+SurfPoints*
+surfPointsNew(int length)
+{
+    SurfPoints *points;
+
+    points         = g_new0(SurfPoints, 1);
+    points->length = length;
+
+    return points;
+}
+
+void
+surfPointsFree(SurfPoints *points)
+{
+    if (points == NULL)
+        return;
+
+    g_free(points->x);
+    g_free(points->y);
+    g_free(points->laplacian);
+    g_free(points->descriptors);
+    g_free(points);
+}
+
+void
+surfPointsClear(SurfPoints *points)
+{
+    points->total = 0;
+}
+
+// grows the arrays to hold at least 'capacity' points, keeping their contents
+static void
+surfPointsReserve(SurfPoints *points, int capacity)
+{
+    if (capacity <= points->capacity)
+        return;
+
+    capacity            = MAX(capacity, 2 * points->capacity);
+    points->x           = g_renew(float, points->x, capacity);
+    points->y           = g_renew(float, points->y, capacity);
+    points->laplacian   = g_renew(int, points->laplacian, capacity);
+    points->descriptors = g_renew(float, points->descriptors, capacity * points->length);
+    points->capacity    = capacity;
+}
+
+void
+surfPointsAppendSeq(SurfPoints *points, const CvSeq *keypoints, const CvSeq *descriptors,
+                    CvPoint pt_displacement)
+{
     CvSeqReader reader, kreader;
-    int         length, i, neighbor;
-    double      d, dist1, dist2;
+    int         i;
 
-    length = (int) (model_descriptors->elem_size / sizeof (float));
-    neighbor = -1;
-    dist1 = dist2 = 1e6;
+    if ((keypoints == NULL) || (descriptors == NULL) || (descriptors->total == 0))
+        return;
+
+    g_return_if_fail(descriptors->elem_size == (int) (points->length * sizeof(float)));
+
+    surfPointsReserve(points, points->total + descriptors->total);
 
-    cvStartReadSeq(model_keypoints, &kreader, 0);
-    cvStartReadSeq(model_descriptors, &reader, 0);
+    cvStartReadSeq(keypoints, &kreader, 0);
+    cvStartReadSeq(descriptors, &reader, 0);
+
+    for (i = 0; i < descriptors->total; ++i) {
+        const CvSURFPoint *kp = (const CvSURFPoint*) kreader.ptr;
+        const float       *vec = (const float*) reader.ptr;
+        int                n = points->total++;
 
-    for (i = 0; i < model_descriptors->total; i++) {
-        const CvSURFPoint* kp = (const CvSURFPoint*) kreader.ptr;
-        const float* mvec = (const float*) reader.ptr;
         CV_NEXT_SEQ_ELEM(kreader.seq->elem_size, kreader);
         CV_NEXT_SEQ_ELEM(reader.seq->elem_size, reader);
-        if (laplacian != kp->laplacian)
-            continue;
-        d = compareSURFDescriptors(vec, mvec, dist2, length);
-        if (d < dist1) {
-            dist2 = dist1;
-            dist1 = d;
-            neighbor = i;
-        } else if (d < dist2)
-            dist2 = d;
+
+        points->x[n]         = kp->pt.x + pt_displacement.x;
+        points->y[n]         = kp->pt.y + pt_displacement.y;
+        points->laplacian[n] = kp->laplacian;
+        memcpy(points->descriptors + n * points->length, vec, points->length * sizeof(float));
     }
-    if (dist1 < 0.6 * dist2)
-        return neighbor;
-    return -1;
 }
 
-CvSeq*
-getMatchPoints(const CvSeq *src, const GArray *pairs, const int PAIR_A_0__PAIR_B_1, CvMemStorage *storage)
+void
+surfPointsSelect(SurfPoints *dst, const SurfPoints *src, const GArray *pairs, const int PAIR_A_0__PAIR_B_1)
 {
-    CvSeq   *dst;
-    gboolean found;
-    gint     m, idx;
-    guint    n;
+    guchar *selected;
+    guint   n;
+    int     i, count;
 
-    dst = cvCloneSeq(src, storage);
+    g_return_if_fail(dst->length == src->length);
 
-    for (m = dst->total - 1; m >= 0; --m) {
-        found = FALSE;
+    // mark the selected points first, so that they are copied in their
+    // original order and only once, whatever the order of the pairs
+    selected = g_new0(guchar, MAX(src->total, 1));
+    count    = 0;
+    for (n = 0; n < pairs->len; ++n) {
+        IntPair pair = g_array_index(pairs, IntPair, n);
+        int     idx  = (!PAIR_A_0__PAIR_B_1) ? pair.a : pair.b;
 
-        for (n = 0; n < pairs->len; ++n) {
-            IntPair pair = g_array_index(pairs, IntPair, n);
-            idx = (!PAIR_A_0__PAIR_B_1) ? pair.a : pair.b;
-            if (idx == m) {
-                found = TRUE;
-                break;
-            }
+        if ((idx >= 0) && (idx < src->total) && !selected[idx]) {
+            selected[idx] = 1;
+            ++count;
         }
+    }
+
+    dst->total = 0;
+    surfPointsReserve(dst, count);
 
-        if (found == FALSE)
-            cvSeqRemove(dst, m);
+    for (i = 0; i < src->total; ++i) {
+        if (!selected[i])
+            continue;
+
+        dst->x[dst->total]         = src->x[i];
+        dst->y[dst->total]         = src->y[i];
+        dst->laplacian[dst->total] = src->laplacian[i];
+        memcpy(dst->descriptors + dst->total * dst->length, src->descriptors + i * src->length,
+               src->length * sizeof(float));
+        dst->total++;
     }
 
-    return dst;
+    g_free(selected);
+}
+
+int
+naiveNearestNeighbor(const float* vec, const int laplacian, const SurfPoints *model)
+{
+    int    length, i, neighbor;
+    double d, dist1, dist2;
+
+    length = model->length;
+    neighbor = -1;
+    dist1 = dist2 = 1e6;
+
+    for (i = 0; i < model->total; i++) {
+        if (laplacian != model->laplacian[i])
+            continue;
+        d = compareSURFDescriptors(vec, model->descriptors + i * length, dist2, length);
+        if (d < dist1) {
+            dist2 = dist1;
+            dist1 = d;
+            neighbor = i;
+        } else if (d < dist2)
+            dist2 = d;
+    }
+    if (dist1 < 0.6 * dist2)
+        return neighbor;
+    return -1;
 }
 
 void
-drawSurfPoints(const CvSeq *seq, CvPoint pt_displacement, IplImage *img,
+drawSurfPoints(const SurfPoints *points, CvPoint pt_displacement, IplImage *img,
                CvScalar color, int NOMARK0_MARK1)
 {
     CvPoint point;
     int     i;
 
-    if ((seq == NULL) || (seq->total == 0))
+    if ((points == NULL) || (points->total == 0))
         return;
 
-    for (i = 0; i < seq->total; ++i) {
-        CvSURFPoint* r = (CvSURFPoint*) cvGetSeqElem(seq, i);
-        point.x = cvPointFrom32f(r->pt).x + pt_displacement.x;
-        point.y = cvPointFrom32f(r->pt).y + pt_displacement.y;
+    for (i = 0; i < points->total; ++i) {
+        point.x = cvRound(points->x[i]) + pt_displacement.x;
+        point.y = cvRound(points->y[i]) + pt_displacement.y;
         cvCircle(img, point, 3, color, -1, 8, 0);
         if (NOMARK0_MARK1) cvCircle(img, point, 1, cvScalarAll(255), -1, 8, 0);
     }
 }
 
 CvPoint
-surfCentroid(const CvSeq *seq, CvPoint pt_displacement)
+surfCentroid(const SurfPoints *points, CvPoint pt_displacement)
 {
     CvPoint point = {0, 0};
 
-    if (seq != NULL) {
+    if ((points != NULL) && (points->total > 0)) {
         int i;
-        for (i = 0; i < seq->total; ++i) {
-            CvSURFPoint *r = (CvSURFPoint*) cvGetSeqElem(seq, i);
-            point.x += cvPointFrom32f(r->pt).x + pt_displacement.x;
-            point.y += cvPointFrom32f(r->pt).y + pt_displacement.y;
+        for (i = 0; i < points->total; ++i) {
+            point.x += cvRound(points->x[i]) + pt_displacement.x;
+            point.y += cvRound(points->y[i]) + pt_displacement.y;
         }
 
-        point.x /= seq->total;
-        point.y /= seq->total;
+        point.x /= points->total;
+        point.y /= points->total;
     }
 
     return point;
 }
 
 CvRect
-surfPointsBoundingRect(const CvSeq *seq)
+surfPointsBoundingRect(const SurfPoints *points)
 {
-    CvSURFPoint *r;
-    CvPoint      point_min, point_max;
-    int          i;
+    CvPoint point_min, point_max;
+    int     i;
 
-    if ((seq == NULL) || (seq->total == 0))
+    if ((points == NULL) || (points->total == 0))
         return cvRect(-1, -1, -1, -1);
 
-    r = (CvSURFPoint*) cvGetSeqElem(seq, 0);
-    point_min.x = point_max.x = cvPointFrom32f(r->pt).x;
-    point_min.y = point_max.y = cvPointFrom32f(r->pt).y;
+    point_min.x = point_max.x = cvRound(points->x[0]);
+    point_min.y = point_max.y = cvRound(points->y[0]);
 
-    for (i = 1; i < seq->total; ++i) {
-        CvSURFPoint* r = (CvSURFPoint*) cvGetSeqElem(seq, i);
-        if (cvPointFrom32f(r->pt).x < point_min.x) point_min.x = cvPointFrom32f(r->pt).x;
-        if (cvPointFrom32f(r->pt).y < point_min.y) point_min.y = cvPointFrom32f(r->pt).y;
-        if (cvPointFrom32f(r->pt).x > point_max.x) point_max.x = cvPointFrom32f(r->pt).x;
-        if (cvPointFrom32f(r->pt).y > point_max.y) point_max.y = cvPointFrom32f(r->pt).y;
+    for (i = 1; i < points->total; ++i) {
+        int x = cvRound(points->x[i]);
+        int y = cvRound(points->y[i]);
+        if (x < point_min.x) point_min.x = x;
+        if (y < point_min.y) point_min.y = y;
+        if (x > point_max.x) point_max.x = x;
+        if (y > point_max.y) point_max.y = y;
     }
 
     return cvRect(point_min.x, point_min.y, point_max.x - point_min.x, point_max.y - point_min.y);
@@ -163,7 +570,7 @@ sortDoubleArray(gconstpointer a, gconstpointer b)
 }
 
 CvRect
-rectDisplacement(const CvSeq* objectKeypoints, const CvSeq* imageKeypoints,
+rectDisplacement(const SurfPoints* objectPoints, const SurfPoints* imagePoints,
                  const GArray* pairs, const CvRect objectRect,
                  const float pairs_perc_considerate)
 {
@@ -174,28 +581,26 @@ rectDisplacement(const CvSeq* objectKeypoints, const CvSeq* imageKeypoints,
 
     // Calculates the maximum acceptable displacement feature
     if (pairs->len >= 2) {
-        GArray *dists = g_array_new(FALSE, FALSE, sizeof (double));
+        GArray *dists = g_array_sized_new(FALSE, FALSE, sizeof (double), pairs->len);
 
         for (n = 0; n < pairs->len; ++n) {
-            IntPair      pair;
-            CvSURFPoint *s_point_obj, *s_point_img;
-            int          x1, y1, x2, y2;
-            double       d;
-
-            pair        = g_array_index(pairs, IntPair, n);
-            s_point_obj = (CvSURFPoint*) cvGetSeqElem(objectKeypoints, pair.a);
-            s_point_img = (CvSURFPoint*) cvGetSeqElem(imageKeypoints, pair.b);
-            x1          = cvPointFrom32f(s_point_obj->pt).x + objectRect.x;
-            y1          = cvPointFrom32f(s_point_obj->pt).y + objectRect.y;
-            x2          = cvPointFrom32f(s_point_img->pt).x;
-            y2          = cvPointFrom32f(s_point_img->pt).y;
-            d           = sqrt(pow(x1 - x2, 2) + pow(y1 - y2, 2));
+            IntPair pair;
+            int     x1, y1, x2, y2;
+            double  d;
+
+            pair = g_array_index(pairs, IntPair, n);
+            x1   = cvRound(objectPoints->x[pair.a]) + objectRect.x;
+            y1   = cvRound(objectPoints->y[pair.a]) + objectRect.y;
+            x2   = cvRound(imagePoints->x[pair.b]);
+            y2   = cvRound(imagePoints->y[pair.b]);
+            d    = sqrt(pow(x1 - x2, 2) + pow(y1 - y2, 2));
 
             g_array_append_val(dists, d);
         }
 
         g_array_sort(dists, sortDoubleArray);
         lim = g_array_index(dists, double, (int) (dists->len * pairs_perc_considerate));
+        g_array_free(dists, TRUE);
     }
 
     real_size = 0;
@@ -203,30 +608,27 @@ rectDisplacement(const CvSeq* objectKeypoints, const CvSeq* imageKeypoints,
 
     if (pairs->len) {
         for (n = 0; n < pairs->len; ++n) {
-            IntPair      pair;
-            CvSURFPoint *s_point_obj, *s_point_img;
+            IntPair pair;
+            int     x_obj, y_obj, x_img, y_img;
 
-            pair        = g_array_index(pairs, IntPair, n);
-            s_point_obj = (CvSURFPoint*) cvGetSeqElem(objectKeypoints, pair.a);
-            s_point_img = (CvSURFPoint*) cvGetSeqElem(imageKeypoints, pair.b);
+            pair  = g_array_index(pairs, IntPair, n);
+            x_obj = cvRound(objectPoints->x[pair.a]);
+            y_obj = cvRound(objectPoints->y[pair.a]);
+            x_img = cvRound(imagePoints->x[pair.b]);
+            y_img = cvRound(imagePoints->y[pair.b]);
 
             // compare with maximum acceptable displacement feature
             if (pairs->len >= 2) {
-                int    x1, y1, x2, y2;
                 double d;
 
-                x1 = cvPointFrom32f(s_point_obj->pt).x + objectRect.x;
-                y1 = cvPointFrom32f(s_point_obj->pt).y + objectRect.y;
-                x2 = cvPointFrom32f(s_point_img->pt).x;
-                y2 = cvPointFrom32f(s_point_img->pt).y;
-                d  = sqrt(pow(x1 - x2, 2) + pow(y1 - y2, 2));
+                d = sqrt(pow(x_obj + objectRect.x - x_img, 2) + pow(y_obj + objectRect.y - y_img, 2));
                 if (d > lim) continue;
             }
 
-            point_obj.x += cvPointFrom32f(s_point_obj->pt).x;
-            point_obj.y += cvPointFrom32f(s_point_obj->pt).y;
-            point_img.x += cvPointFrom32f(s_point_img->pt).x;
-            point_img.y += cvPointFrom32f(s_point_img->pt).y;
+            point_obj.x += x_obj;
+            point_obj.y += y_obj;
+            point_img.x += x_img;
+            point_img.y += y_img;
 
             real_size++;
         }
@@ -241,25 +643,297 @@ rectDisplacement(const CvSeq* objectKeypoints, const CvSeq* imageKeypoints,
 }
 
 void
-findPairs(const CvSeq* objectKeypoints, const CvSeq* objectDescriptors,
-          const CvSeq* imageKeypoints, const CvSeq* imageDescriptors, GArray* array)
+findPairs(const SurfPoints* objectPoints, const SurfPoints* imagePoints, GArray* array)
 {
-    CvSeqReader reader, kreader;
-    int         i;
+    int i;
+
+    for (i = 0; i < objectPoints->total; i++) {
+        gint nearest_neighbor;
+
+        nearest_neighbor = naiveNearestNeighbor(objectPoints->descriptors + i * objectPoints->length,
+                                                objectPoints->laplacian[i], imagePoints);
+        if (nearest_neighbor >= 0) {
+            IntPair pair;
+            pair.a = i;
+            pair.b = nearest_neighbor;
+            g_array_append_val(array, pair);
+        }
+    }
+}
+
+static int
+laplacianPartition(int laplacian)
+{
+    return (laplacian < 0) ? 0 : ((laplacian > 0) ? 2 : 1);
+}
 
-    cvStartReadSeq(objectKeypoints, &kreader, 0);
-    cvStartReadSeq(objectDescriptors, &reader, 0);
+static void
+swapSurfIndexDescriptors(SurfIndexTree *tree, int length, int a, int b)
+{
+    float *da, *db, t;
+    int    i, id;
+
+    da = tree->descriptors + a * length;
+    db = tree->descriptors + b * length;
+    for (i = 0; i < length; ++i) {
+        t     = da[i];
+        da[i] = db[i];
+        db[i] = t;
+    }
 
-    for (i = 0; i < objectDescriptors->total; i++) {
-        const CvSURFPoint *kp;
-        const float       *descriptor;
-        gint               nearest_neighbor;
+    id            = tree->ids[a];
+    tree->ids[a]  = tree->ids[b];
+    tree->ids[b]  = id;
+}
 
-        kp = (const CvSURFPoint*) kreader.ptr;
-        descriptor = (const float*) reader.ptr;
-        CV_NEXT_SEQ_ELEM(kreader.seq->elem_size, kreader);
-        CV_NEXT_SEQ_ELEM(reader.seq->elem_size, reader);
-        nearest_neighbor = naiveNearestNeighbor(descriptor, kp->laplacian, imageKeypoints, imageDescriptors);
+// splits [begin, end) at the mean of the dimension with the largest variance;
+// 'mean' and 'var' are scratch arrays of 'length' elements
+static int
+buildSurfIndexNode(SurfIndexTree *tree, int length, int begin, int end, double *mean, double *var)
+{
+    SurfIndexNode node;
+    int           node_idx, i, j, k;
+
+    node_idx = tree->nodes->len;
+    g_array_set_size(tree->nodes, node_idx + 1);
+
+    node.dim   = -1;
+    node.value = 0;
+    node.left  = begin;
+    node.right = end;
+
+    if (end - begin > SURF_INDEX_LEAF_SIZE) {
+        const float *d;
+        int          dim;
+
+        memset(mean, 0, length * sizeof(double));
+        memset(var,  0, length * sizeof(double));
+
+        for (i = begin; i < end; ++i) {
+            d = tree->descriptors + i * length;
+            for (j = 0; j < length; ++j)
+                mean[j] += d[j];
+        }
+        for (j = 0; j < length; ++j)
+            mean[j] /= end - begin;
+
+        for (i = begin; i < end; ++i) {
+            d = tree->descriptors + i * length;
+            for (j = 0; j < length; ++j)
+                var[j] += (d[j] - mean[j]) * (d[j] - mean[j]);
+        }
+
+        dim = 0;
+        for (j = 1; j < length; ++j)
+            if (var[j] > var[dim]) dim = j;
+
+        // partition the range around the split value
+        i = begin;
+        k = end - 1;
+        while (i <= k) {
+            if (tree->descriptors[i * length + dim] < mean[dim])
+                ++i;
+            else
+                swapSurfIndexDescriptors(tree, length, i, k--);
+        }
+
+        // degenerated splits (i.e.: all descriptors are equal along 'dim') become leaves
+        if ((i > begin) && (i < end)) {
+            node.dim   = dim;
+            node.value = (float) mean[dim];
+            node.left  = buildSurfIndexNode(tree, length, begin, i, mean, var);
+            node.right = buildSurfIndexNode(tree, length, i, end, mean, var);
+        }
+    }
+
+    g_array_index(tree->nodes, SurfIndexNode, node_idx) = node;
+    return node_idx;
+}
+
+SurfIndex*
+surfIndexNew(const SurfPoints *points, int max_checks)
+{
+    SurfIndex *index;
+    double    *mean, *var;
+    int        i, p, length, max_nodes;
+
+    index             = g_new0(SurfIndex, 1);
+    index->length     = length = points->length;
+    index->max_checks = max_checks;
+
+    // count the descriptors of each partition
+    for (i = 0; i < points->total; ++i)
+        index->trees[laplacianPartition(points->laplacian[i])].total++;
+
+    for (p = 0; p < 3; ++p) {
+        SurfIndexTree *tree = &index->trees[p];
+
+        tree->descriptors = g_new(float, tree->total * length);
+        tree->ids         = g_new(int, tree->total);
+        tree->nodes       = g_array_new(FALSE, FALSE, sizeof(SurfIndexNode));
+        tree->total       = 0;
+    }
+
+    // pack the descriptors
+    for (i = 0; i < points->total; ++i) {
+        SurfIndexTree *tree = &index->trees[laplacianPartition(points->laplacian[i])];
+
+        memcpy(tree->descriptors + tree->total * length, points->descriptors + i * length, length * sizeof(float));
+        tree->ids[tree->total++] = i;
+    }
+
+    // build the trees
+    mean      = g_new(double, length);
+    var       = g_new(double, length);
+    max_nodes = 0;
+    for (p = 0; p < 3; ++p) {
+        SurfIndexTree *tree = &index->trees[p];
+
+        if (tree->total > 0)
+            buildSurfIndexNode(tree, length, 0, tree->total, mean, var);
+        max_nodes = MAX(max_nodes, (int) tree->nodes->len);
+    }
+    g_free(mean);
+    g_free(var);
+
+    // each node is queued at most once per query
+    index->heap = g_new(SurfIndexBranch, MAX(max_nodes, 1));
+
+    return index;
+}
+
+void
+surfIndexFree(SurfIndex *index)
+{
+    int p;
+
+    for (p = 0; p < 3; ++p) {
+        g_free(index->trees[p].descriptors);
+        g_free(index->trees[p].ids);
+        g_array_free(index->trees[p].nodes, TRUE);
+    }
+    g_free(index->heap);
+    g_free(index);
+}
+
+// binary min-heap of branches, ordered by their distance bound
+static void
+pushSurfIndexBranch(SurfIndex *index, int node, double bound)
+{
+    SurfIndexBranch *heap = index->heap;
+    int              i, parent;
+
+    for (i = index->heap_size++; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (heap[parent].bound <= bound)
+            break;
+        heap[i] = heap[parent];
+    }
+    heap[i].node  = node;
+    heap[i].bound = bound;
+}
+
+static SurfIndexBranch
+popSurfIndexBranch(SurfIndex *index)
+{
+    SurfIndexBranch *heap = index->heap;
+    SurfIndexBranch  top, last;
+    int              i, child;
+
+    top  = heap[0];
+    last = heap[--index->heap_size];
+    for (i = 0; (child = 2 * i + 1) < index->heap_size; i = child) {
+        if ((child + 1 < index->heap_size) && (heap[child + 1].bound < heap[child].bound))
+            ++child;
+        if (last.bound <= heap[child].bound)
+            break;
+        heap[i] = heap[child];
+    }
+    heap[i] = last;
+
+    return top;
+}
+
+int
+surfIndexNearestNeighbor(SurfIndex *index, const float *vec, int laplacian)
+{
+    SurfIndexTree *tree;
+    double         dist1, dist2, dists[SURF_INDEX_LEAF_SIZE];
+    int            neighbor, checks, length;
+
+    tree = &index->trees[laplacianPartition(laplacian)];
+    if (tree->total == 0)
+        return -1;
+
+    length   = index->length;
+    neighbor = -1;
+    dist1    = dist2 = 1e6;
+    checks   = 0;
+
+    index->heap_size = 0;
+    pushSurfIndexBranch(index, 0, 0);
+
+    while (index->heap_size > 0) {
+        SurfIndexBranch      branch;
+        const SurfIndexNode *node;
+        int                  i;
+
+        // the closest pending branch can't hold anything closer than the
+        // second best match found so far
+        branch = popSurfIndexBranch(index);
+        if (branch.bound >= dist2)
+            break;
+        if ((index->max_checks > 0) && (checks >= index->max_checks))
+            break;
+
+        // descend to the leaf closest to 'vec', queueing the branches not taken
+        node = &g_array_index(tree->nodes, SurfIndexNode, branch.node);
+        while (node->dim >= 0) {
+            double diff, bound;
+            int    near, far;
+
+            diff  = vec[node->dim] - node->value;
+            near  = (diff < 0) ? node->left  : node->right;
+            far   = (diff < 0) ? node->right : node->left;
+            bound = MAX(branch.bound, diff * diff);
+            if (bound < dist2)
+                pushSurfIndexBranch(index, far, bound);
+            node = &g_array_index(tree->nodes, SurfIndexNode, near);
+        }
+
+        // the leaf descriptors are contiguous, so they are compared in blocks
+        // (leaves from degenerated splits may be larger than SURF_INDEX_LEAF_SIZE)
+        for (i = node->left; i < node->right; i += SURF_INDEX_LEAF_SIZE) {
+            int j, n = MIN(SURF_INDEX_LEAF_SIZE, node->right - i);
+
+            compareSURFDescriptorsBlock(vec, tree->descriptors + i * length, n, length, dist2, dists);
+            for (j = 0; j < n; ++j) {
+                if (dists[j] < dist1) {
+                    dist2    = dist1;
+                    dist1    = dists[j];
+                    neighbor = tree->ids[i + j];
+                } else if (dists[j] < dist2)
+                    dist2 = dists[j];
+            }
+        }
+        checks += node->right - node->left;
+    }
+
+    if (dist1 < 0.6 * dist2)
+        return neighbor;
+    return -1;
+}
+
+void
+findPairsIndexed(const SurfPoints* objectPoints, SurfIndex* imageIndex, GArray* array)
+{
+    int i;
+
+    for (i = 0; i < objectPoints->total; i++) {
+        gint nearest_neighbor;
+
+        nearest_neighbor = surfIndexNearestNeighbor(imageIndex, objectPoints->descriptors + i * objectPoints->length,
+                                                    objectPoints->laplacian[i]);
         if (nearest_neighbor >= 0) {
             IntPair pair;
             pair.a = i;
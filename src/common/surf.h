@@ -8,49 +8,108 @@
 #include <glib.h>
 #include <cv.h>
 
-typedef struct _IntPair IntPair;
+typedef struct _IntPair    IntPair;
+typedef struct _SurfPoints SurfPoints;
+typedef struct _SurfIndex  SurfIndex;
 
 struct _IntPair {
     int a;
     int b;
 };
 
+// a set of SURF points stored as flat arrays (one entry per point, the
+// descriptors as contiguous rows of 'length' floats), so that they can be
+// scanned and copied without walking CvSeq blocks; the arrays grow on demand
+// and are kept across clears
+struct _SurfPoints {
+    int    length;      // floats per descriptor
+    int    total;
+    int    capacity;
+    float *x;
+    float *y;
+    int   *laplacian;
+    float *descriptors;
+};
+
+SurfPoints* surfPointsNew       (int           length);
+
+void     surfPointsFree         (SurfPoints   *points);
+
+void     surfPointsClear        (SurfPoints   *points);
+
+// appends the points extracted by cvExtractSURF, displaced by 'pt_displacement'
+void     surfPointsAppendSeq    (SurfPoints   *points,
+                                 const CvSeq  *keypoints,
+                                 const CvSeq  *descriptors,
+                                 CvPoint       pt_displacement);
+
+// replaces the content of 'dst' by the points of 'src' referenced by the
+// pairs (keeping their order in 'src')
+void     surfPointsSelect       (SurfPoints   *dst,
+                                 const SurfPoints *src,
+                                 const GArray *pairs,
+                                 const int     PAIR_A_0__PAIR_B_1);
+
 double   compareSURFDescriptors (const float  *d1,
                                  const float  *d2,
                                  double        best,
                                  int           length);
 
+// distances between 'vec' and 'n' contiguous candidate descriptors, computed
+// together; as with compareSURFDescriptors(), the distances above 'best' are
+// only known to be above it
+void     compareSURFDescriptorsBlock (const float *vec,
+                                 const float  *candidates,
+                                 int           n,
+                                 int           length,
+                                 double        best,
+                                 double       *dists);
+
+// selects the distance kernel used from then on, for the checks: "avx2",
+// "sse2", "scalar", or NULL for the best one; returns FALSE, keeping the
+// current kernel, if this host or build can't run it. Not thread-safe.
+gboolean surfSetDistanceKernel  (const char   *name);
+
 int      naiveNearestNeighbor   (const float  *vec,
                                  int           laplacian,
-                                 const CvSeq  *model_keypoints,
-                                 const CvSeq  *model_descriptors);
+                                 const SurfPoints *model);
 
-void     findPairs              (const CvSeq  *objectKeypoints,
-                                 const CvSeq  *objectDescriptors,
-                                 const CvSeq  *imageKeypoints,
-                                 const CvSeq  *imageDescriptors,
+void     findPairs              (const SurfPoints *objectPoints,
+                                 const SurfPoints *imagePoints,
                                  GArray       *pairs);
 
-CvSeq*   getMatchPoints         (const CvSeq  *src,
-                                 const GArray *pairs,
-                                 const int     PAIR_A_0__PAIR_B_1,
-                                 CvMemStorage *storage);
+// approximate nearest neighbour index (a kd-tree per laplacian sign, searched
+// best-bin-first) over a set of descriptors, meant to be built once per frame
+// and queried by every stored object; at most 'max_checks' descriptors are
+// compared per query (0 for an exact search). Queries are not thread-safe.
+SurfIndex* surfIndexNew         (const SurfPoints *points,
+                                 int           max_checks);
+
+void     surfIndexFree          (SurfIndex    *index);
+
+int      surfIndexNearestNeighbor (SurfIndex  *index,
+                                 const float  *vec,
+                                 int           laplacian);
+
+void     findPairsIndexed       (const SurfPoints *objectPoints,
+                                 SurfIndex    *imageIndex,
+                                 GArray       *pairs);
 
-CvPoint  surfCentroid           (const CvSeq  *seq,
+CvPoint  surfCentroid           (const SurfPoints *points,
                                  CvPoint       pt_displacement);
 
-void     drawSurfPoints         (const CvSeq  *seq,
+void     drawSurfPoints         (const SurfPoints *points,
                                  CvPoint       pt_displacement,
                                  IplImage     *img,
                                  CvScalar      color,
                                  int           NOMARK0_MARK1);
 
-CvRect   rectDisplacement       (const CvSeq  *objectKeypoints,
-                                 const CvSeq  *imageKeypoints,
+CvRect   rectDisplacement       (const SurfPoints *objectPoints,
+                                 const SurfPoints *imagePoints,
                                  const GArray *pairs,
                                  const CvRect  objectRect,
                                  const float   pairs_perc_considerate);
 
-CvRect   surfPointsBoundingRect (const CvSeq  *seq);
+CvRect   surfPointsBoundingRect (const SurfPoints *points);
 
 #endif // __GST_OPENCV_COMMON_SURF__
@@ -57,6 +57,7 @@ enum _TrackedObjectType
 struct _TrackedObject
 {
     gchar             *id;
+    guint              uid;     // integer form of 'id', assigned by the receiving element (not sent)
     TrackedObjectType  type;
     GArray            *point_array;
     guint              height;
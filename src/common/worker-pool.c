@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "worker-pool.h"
+
+#include <unistd.h>
+
+struct _WorkerPool
+{
+    GThreadPool    *threads;
+    WorkerPoolFunc  func;
+    gpointer        user_data;
+    guint           n_threads;
+
+    GMutex         *lock;
+    GCond          *done;
+    guint           pending;
+};
+
+static void
+worker_pool_thread_func(gpointer task, gpointer user_data)
+{
+    WorkerPool *pool = (WorkerPool*) user_data;
+
+    pool->func(task, pool->user_data);
+
+    g_mutex_lock(pool->lock);
+    if (--pool->pending == 0)
+        g_cond_signal(pool->done);
+    g_mutex_unlock(pool->lock);
+}
+
+WorkerPool*
+worker_pool_new(WorkerPoolFunc func, gpointer user_data, guint n_threads)
+{
+    WorkerPool *pool;
+
+    g_return_val_if_fail(func != NULL, NULL);
+
+    if (!g_thread_supported()) g_thread_init(NULL);
+
+    pool            = g_new0(WorkerPool, 1);
+    pool->func      = func;
+    pool->user_data = user_data;
+    pool->n_threads = MAX(n_threads, 1);
+    pool->lock      = g_mutex_new();
+    pool->done      = g_cond_new();
+
+    // the calling thread takes part in each batch, so one thread less is
+    // needed; the threads are exclusive so that they stay alive between runs
+    if (pool->n_threads > 1) {
+        GError *error = NULL;
+
+        pool->threads = g_thread_pool_new(worker_pool_thread_func, pool, pool->n_threads - 1, TRUE, &error);
+        if (pool->threads == NULL) {
+            g_warning("unable to create the worker threads: %s", error->message);
+            g_error_free(error);
+            pool->n_threads = 1;
+        }
+    }
+
+    return pool;
+}
+
+void
+worker_pool_free(WorkerPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    if (pool->threads)
+        g_thread_pool_free(pool->threads, FALSE, TRUE);
+    g_mutex_free(pool->lock);
+    g_cond_free(pool->done);
+    g_free(pool);
+}
+
+guint
+worker_pool_get_n_threads(const WorkerPool *pool)
+{
+    return pool->n_threads;
+}
+
+void
+worker_pool_run(WorkerPool *pool, gpointer *tasks, guint n_tasks)
+{
+    guint i;
+
+    if (n_tasks == 0)
+        return;
+
+    if (pool->threads == NULL) {
+        for (i = 0; i < n_tasks; ++i)
+            pool->func(tasks[i], pool->user_data);
+        return;
+    }
+
+    g_mutex_lock(pool->lock);
+    pool->pending = n_tasks - 1;
+    g_mutex_unlock(pool->lock);
+
+    for (i = 1; i < n_tasks; ++i)
+        g_thread_pool_push(pool->threads, tasks[i], NULL);
+
+    pool->func(tasks[0], pool->user_data);
+
+    g_mutex_lock(pool->lock);
+    while (pool->pending > 0)
+        g_cond_wait(pool->done, pool->lock);
+    g_mutex_unlock(pool->lock);
+}
+
+guint
+worker_pool_default_n_threads(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return (guint) n;
+#endif
+    return 1;
+}
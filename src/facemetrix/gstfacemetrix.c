@@ -123,6 +123,7 @@ gst_facemetrix_finalize(GObject *obj)
     if (filter->image)         cvReleaseImage(&filter->image);
     if (filter->host)          g_free(filter->host);
     if (filter->recognizer_id) g_free(filter->recognizer_id);
+    gst_buffer_replace(&filter->faces, NULL);
     if (filter->sgl) {
         sgl_client_close(filter->sgl);
         g_object_unref(filter->sgl);
@@ -208,8 +209,7 @@ gst_facemetrix_init(GstFaceMetrix *filter, GstFaceMetrixClass *gclass)
     filter->unknown_faces  = FALSE;
     filter->host           = g_strdup(DEFAULT_HOST);
     filter->recognizer_id  = g_strdup(DEFAULT_RECOGNIZER_ID);
-    filter->face_timestamp = 0;
-    filter->face_array     = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
+    filter->faces          = NULL;
 }
 
 static void
@@ -328,17 +328,16 @@ gst_facemetrix_chain(GstPad *pad, GstBuffer *buf)
     // the pipeline continue as if the facemetrix element was not present
     g_return_val_if_fail(filter->sgl != NULL, GST_FLOW_OK);
 
-    // check face timestamps and face array length; these should have been
+    // check face timestamps and the number of faces; these should have been
     // set at the face_events_cb callback
-    if ((filter->face_timestamp == GST_BUFFER_TIMESTAMP(buf)) &&
-        (filter->face_array != NULL) &&
-        (filter->face_array->len > 0)) {
+    if ((detections_timestamp(filter->faces) == GST_BUFFER_TIMESTAMP(buf)) &&
+        (detections_count(filter->faces) > 0)) {
 
         guint i;
 
         filter->image->imageData = (char*) GST_BUFFER_DATA(buf);
 
-        for (i = 0; i < filter->face_array->len; ++i) {
+        for (i = 0; i < detections_count(filter->faces); ++i) {
             IplImage     *face_image;
             CvRect        face_rect;
             CvMat        *jpegface;
@@ -347,7 +346,7 @@ gst_facemetrix_chain(GstPad *pad, GstBuffer *buf)
             GstStructure *structure;
             gchar        *id;
 
-            face_rect = g_array_index(filter->face_array, CvRect, i);
+            face_rect = detections_get(filter->faces, i)->rect;
             face_image = cvCreateImage(cvSize(face_rect.width, face_rect.height), IPL_DEPTH_8U, 3);
             cvSetImageROI(filter->image, face_rect);
             cvCopy(filter->image, face_image, NULL);
@@ -441,8 +440,7 @@ draw_face_id(IplImage *image, const gchar *face_id, const CvRect face_rect,
 static
 gboolean face_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
 {
-    GstFaceMetrix      *filter;
-    const GstStructure *structure;
+    GstFaceMetrix *filter;
 
     filter = GST_FACEMETRIX(user_data);
 
@@ -451,25 +449,7 @@ gboolean face_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
     g_return_val_if_fail(event  != NULL, FALSE);
     g_return_val_if_fail(filter != NULL, FALSE);
 
-    structure = gst_event_get_structure(event);
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "haar-detect-roi") == 0)) {
-        CvRect face;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &face.x,
-                          "y",         G_TYPE_UINT,   &face.y,
-                          "width",     G_TYPE_UINT,   &face.width,
-                          "height",    G_TYPE_UINT,   &face.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->face_timestamp) {
-            filter->face_timestamp = timestamp;
-            g_array_free(filter->face_array, TRUE);
-            filter->face_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
-        }
-        g_array_append_val(filter->face_array, face);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_HAAR_DETECT, &filter->faces);
 
     return TRUE;
 }
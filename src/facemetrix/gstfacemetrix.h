@@ -51,6 +51,7 @@
 #include <cv.h>
 
 #include "sglclient.h"
+#include "detections.h"
 
 G_BEGIN_DECLS
 
@@ -80,8 +81,7 @@ struct _GstFaceMetrix
     guint                    port;
     gchar                   *recognizer_id;
 
-    GstClockTime             face_timestamp;
-    GArray                  *face_array;
+    GstBuffer               *faces;
 };
 
 struct _GstFaceMetrixClass
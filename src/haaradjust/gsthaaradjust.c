@@ -121,6 +121,10 @@ gst_haar_adjust_finalize(GObject *obj)
     if (filter->image)       cvReleaseImage(&filter->image);
     if (filter->object_type) g_free(filter->object_type);
 
+    gst_buffer_replace(&filter->haar_detections, NULL);
+    gst_buffer_replace(&filter->bg_detections,   NULL);
+    g_array_free(filter->detections, TRUE);
+
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
 
@@ -192,10 +196,9 @@ gst_haar_adjust_init(GstHaarAdjust *filter, GstHaarAdjustClass *gclass)
     filter->display           = FALSE;
     filter->object_type       = g_strdup(DEFAULT_OBJECT_TYPE);
     filter->height_adjustment = DEFAULT_HEIGHT_ADJUSTMENT;
-    filter->rect_timestamp    = 0;
-    filter->rect_bg_timestamp    = 0;
-    filter->rect_array        = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
-    filter->rect_bg_array     = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
+    filter->haar_detections   = NULL;
+    filter->bg_detections     = NULL;
+    filter->detections        = detections_array_new();
 }
 
 static void
@@ -288,20 +291,20 @@ gst_haar_adjust_chain(GstPad *pad, GstBuffer *buf)
 
     filter->image->imageData = (char*) GST_BUFFER_DATA(buf);
 
-    if ((filter->rect_timestamp == GST_BUFFER_TIMESTAMP(buf)) &&
-        (filter->rect_array != NULL) &&
-        (filter->rect_array->len > 0)) {
+    if ((detections_timestamp(filter->haar_detections) == GST_BUFFER_TIMESTAMP(buf)) &&
+        (detections_count(filter->haar_detections) > 0)) {
         guint i;
 
-        for (i = 0; i < filter->rect_array->len; ++i) {
+        for (i = 0; i < detections_count(filter->haar_detections); ++i) {
             CvRect        rect;
-            GstEvent     *event;
+            gfloat        score;
             GstMessage   *message;
             GstStructure *structure;
             gint          complement_height_top_bg, complement_height_bottom_bg,
                           complement_height_top_projected, complement_height_bottom_projected;
 
-            rect = g_array_index(filter->rect_array, CvRect, i);
+            rect  = detections_get(filter->haar_detections, i)->rect;
+            score = detections_get(filter->haar_detections, i)->score;
 
             complement_height_top_bg = complement_height_bottom_bg = -1;
 
@@ -309,15 +312,14 @@ gst_haar_adjust_chain(GstPad *pad, GstBuffer *buf)
             complement_height_bottom_projected = complement_height_top_projected = (rect.height * filter->height_adjustment) - rect.height;
 
             // Calculation of the 'height' complement of haar rect and bg rect
-            if ((filter->rect_bg_timestamp == GST_BUFFER_TIMESTAMP(buf)) &&
-                    (filter->rect_bg_array != NULL) &&
-                    (filter->rect_bg_array->len > 0)) {
+            if ((detections_timestamp(filter->bg_detections) == GST_BUFFER_TIMESTAMP(buf)) &&
+                    (detections_count(filter->bg_detections) > 0)) {
 
                 guint i;
 
-                for (i = 0; i < filter->rect_bg_array->len; ++i) {
+                for (i = 0; i < detections_count(filter->bg_detections); ++i) {
                     CvRect rect_bg_temp;
-                    rect_bg_temp = g_array_index(filter->rect_bg_array, CvRect, i);
+                    rect_bg_temp = detections_get(filter->bg_detections, i)->rect;
 
                     if (rectIntercept(&rect, &rect_bg_temp) == 1) {
                         complement_height_bottom_bg = rect_bg_temp.height - rect.height - (rect.y - rect_bg_temp.y);
@@ -367,7 +369,10 @@ gst_haar_adjust_chain(GstPad *pad, GstBuffer *buf)
                             CV_RGB(255, 0, 255), 1, 8, 0);
             }
 
-            // send downstream event and bus message with the rect info
+            // post a bus message with the rect info; the downstream event
+            // carrying all the adjusted rects is pushed once per frame below
+            detections_array_add(filter->detections, rect, score);
+
             structure = gst_structure_new("haar-adjust-roi",
                                           "x",         G_TYPE_UINT,   rect.x,
                                           "y",         G_TYPE_UINT,   rect.y,
@@ -376,11 +381,15 @@ gst_haar_adjust_chain(GstPad *pad, GstBuffer *buf)
                                           "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
                                           NULL);
 
-            message = gst_message_new_element(GST_OBJECT(filter), gst_structure_copy(structure));
+            message = gst_message_new_element(GST_OBJECT(filter), structure);
             gst_element_post_message(GST_ELEMENT(filter), message);
+        }
 
-            event   = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-            gst_pad_push_event(filter->srcpad, event);
+        if (filter->detections->len > 0) {
+            gst_pad_push_event(filter->srcpad,
+                               detections_event_new(DETECTION_SOURCE_HAAR_ADJUST, GST_BUFFER_TIMESTAMP(buf),
+                                                    filter->detections));
+            g_array_set_size(filter->detections, 0);
         }
     }
 
@@ -392,8 +401,7 @@ gst_haar_adjust_chain(GstPad *pad, GstBuffer *buf)
 static
 gboolean events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
 {
-    GstHaarAdjust  *filter;
-    const GstStructure *structure;
+    GstHaarAdjust *filter;
 
     filter = GST_HAARADJUST(user_data);
 
@@ -402,45 +410,8 @@ gboolean events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
     g_return_val_if_fail(event  != NULL, FALSE);
     g_return_val_if_fail(filter != NULL, FALSE);
 
-    structure = gst_event_get_structure(event);
-
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "haar-detect-roi") == 0)) {
-        CvRect rect;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &rect.x,
-                          "y",         G_TYPE_UINT,   &rect.y,
-                          "width",     G_TYPE_UINT,   &rect.width,
-                          "height",    G_TYPE_UINT,   &rect.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->rect_timestamp) {
-            filter->rect_timestamp = timestamp;
-            g_array_free(filter->rect_array, TRUE);
-            filter->rect_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
-        }
-        g_array_append_val(filter->rect_array, rect);
-    }
-
-     if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "bgfg-roi") == 0)) {
-        CvRect rect;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &rect.x,
-                          "y",         G_TYPE_UINT,   &rect.y,
-                          "width",     G_TYPE_UINT,   &rect.width,
-                          "height",    G_TYPE_UINT,   &rect.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->rect_bg_timestamp) {
-            filter->rect_bg_timestamp = timestamp;
-            g_array_free(filter->rect_bg_array, TRUE);
-            filter->rect_bg_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
-        }
-        g_array_append_val(filter->rect_bg_array, rect);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_HAAR_DETECT, &filter->haar_detections);
+    detections_update_from_event(event, DETECTION_SOURCE_BGFG,        &filter->bg_detections);
 
     return TRUE;
 }
@@ -50,6 +50,7 @@
 #include <gst/gst.h>
 #include <cv.h>
 #include <draw.h>
+#include <detections.h>
 
 G_BEGIN_DECLS
 
@@ -77,10 +78,9 @@ struct _GstHaarAdjust
     gchar                   *object_type;
     gfloat                   height_adjustment;
 
-    GstClockTime             rect_timestamp;
-    GArray                  *rect_array;
-    GstClockTime             rect_bg_timestamp;
-    GArray                  *rect_bg_array;
+    GstBuffer               *haar_detections;
+    GstBuffer               *bg_detections;
+    GArray                  *detections;
 };
 
 struct _GstHaarAdjustClass
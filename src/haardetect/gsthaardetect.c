@@ -127,6 +127,9 @@ gst_haar_detect_finalize(GObject *obj)
     if (filter->profile)     g_free(filter->profile);
     if (filter->save_prefix) g_free(filter->save_prefix);
 
+    gst_buffer_replace(&filter->roi_detections, NULL);
+    g_array_free(filter->detections, TRUE);
+
     G_OBJECT_CLASS (parent_class)->finalize(obj);
 }
 
@@ -210,16 +213,16 @@ gst_haar_detect_init(GstHaarDetect *filter, GstHaarDetectClass *gclass)
     gst_element_add_pad(GST_ELEMENT(filter), filter->sinkpad);
     gst_element_add_pad(GST_ELEMENT(filter), filter->srcpad);
 
-    filter->verbose       = FALSE;
-    filter->display       = FALSE;
-    filter->roi_only      = FALSE;
-    filter->roi_timestamp = 0;
-    filter->roi_array     = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 4);
-    filter->profile       = g_strdup(DEFAULT_PROFILE);
-    filter->save_images   = FALSE;
-    filter->save_prefix   = g_strdup(DEFAULT_SAVE_PREFIX);
-    filter->min_neighbors = DEFAULT_MIN_NEIGHBORS;
-    filter->min_size      = DEFAULT_MIN_SIZE;
+    filter->verbose        = FALSE;
+    filter->display        = FALSE;
+    filter->roi_only       = FALSE;
+    filter->roi_detections = NULL;
+    filter->detections     = detections_array_new();
+    filter->profile        = g_strdup(DEFAULT_PROFILE);
+    filter->save_images    = FALSE;
+    filter->save_prefix    = g_strdup(DEFAULT_SAVE_PREFIX);
+    filter->min_neighbors  = DEFAULT_MIN_NEIGHBORS;
+    filter->min_size       = DEFAULT_MIN_SIZE;
 
     gst_haar_detect_load_profile(filter);
 }
@@ -349,21 +352,28 @@ gst_haar_detect_chain(GstPad *pad, GstBuffer *buf)
     cvCvtColor(filter->image, filter->gray, CV_RGB2GRAY);
     cvClearMemStorage(filter->storage);
 
-    // check roi timestamps and roi array length; these should have been
+    // check roi timestamps and the number of rois; these should have been
     // set at the roi_events_cb callback
-    if ((filter->roi_timestamp == GST_BUFFER_TIMESTAMP(buf)) &&
-        (filter->roi_array != NULL) &&
-        (filter->roi_array->len > 0)) {
+    if ((detections_timestamp(filter->roi_detections) == GST_BUFFER_TIMESTAMP(buf)) &&
+        (detections_count(filter->roi_detections) > 0)) {
 
         guint i;
-        for (i = 0; i < filter->roi_array->len; ++i) {
-            cvSetImageROI(filter->gray, g_array_index(filter->roi_array, CvRect, i));
+        for (i = 0; i < detections_count(filter->roi_detections); ++i) {
+            cvSetImageROI(filter->gray, detections_get(filter->roi_detections, i)->rect);
             detect_haars(filter, buf);
             cvResetImageROI(filter->gray);
         }
     } else if (filter->roi_only == FALSE)
         detect_haars(filter, buf);
 
+    // send all the haars found on this frame in a single event
+    if (filter->detections->len > 0) {
+        gst_pad_push_event(filter->srcpad,
+                           detections_event_new(DETECTION_SOURCE_HAAR_DETECT, GST_BUFFER_TIMESTAMP(buf),
+                                                filter->detections));
+        g_array_set_size(filter->detections, 0);
+    }
+
     gst_buffer_set_data(buf, (guchar*) filter->image->imageData, filter->image->imageSize);
 
     return gst_pad_push(filter->srcpad, buf);
@@ -386,21 +396,15 @@ detect_haars(GstHaarDetect *filter, GstBuffer *buf)
     roi = cvGetImageROI(filter->gray);
 
     for (i = 0; i < haars->total; ++i) {
-        CvRect       *r;
-        GstEvent     *event;
-        GstStructure *structure;
-
-        r = (CvRect*) cvGetSeqElem(haars, i);
-        structure = gst_structure_new("haar-detect-roi",
-                                      "x",      G_TYPE_UINT, roi.x + r->x,
-                                      "y",      G_TYPE_UINT, roi.y + r->y,
-                                      "width",  G_TYPE_UINT, r->width,
-                                      "height", G_TYPE_UINT, r->height,
-                                      "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                      NULL);
-
-        event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-        gst_pad_push_event(filter->srcpad, event);
+        CvAvgComp *comp;
+        CvRect    *r;
+
+        // the number of neighbor windows merged into a haar is used as its score
+        comp = (CvAvgComp*) cvGetSeqElem(haars, i);
+        r    = &comp->rect;
+        detections_array_add(filter->detections,
+                             cvRect(roi.x + r->x, roi.y + r->y, r->width, r->height),
+                             comp->neighbors);
 
         if (filter->verbose)
             GST_INFO("[haar] x: %d, y: %d, width: %d, height: %d",
@@ -463,8 +467,7 @@ build_timestamp()
 static
 gboolean roi_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
 {
-    GstHaarDetect      *filter;
-    const GstStructure *structure;
+    GstHaarDetect *filter;
 
     filter = GST_HAAR_DETECT(user_data);
 
@@ -473,25 +476,7 @@ gboolean roi_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
     g_return_val_if_fail(event  != NULL, FALSE);
     g_return_val_if_fail(filter != NULL, FALSE);
 
-    structure = gst_event_get_structure(event);
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "bgfg-roi") == 0)) {
-        CvRect roi;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &roi.x,
-                          "y",         G_TYPE_UINT,   &roi.y,
-                          "width",     G_TYPE_UINT,   &roi.width,
-                          "height",    G_TYPE_UINT,   &roi.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->roi_timestamp) {
-            filter->roi_timestamp = timestamp;
-            g_array_free(filter->roi_array, TRUE);
-            filter->roi_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 4);
-        }
-        g_array_append_val(filter->roi_array, roi);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_BGFG, &filter->roi_detections);
 
     return TRUE;
 }
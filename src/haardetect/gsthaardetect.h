@@ -49,6 +49,8 @@
 #include <gst/gst.h>
 #include <cv.h>
 
+#include "detections.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_HAAR_DETECT            (gst_haar_detect_get_type())
@@ -81,8 +83,8 @@ struct _GstHaarDetect
     guint                    min_neighbors;
     guint                    min_size;
 
-    GstClockTime             roi_timestamp;
-    GArray                  *roi_array;
+    GstBuffer               *roi_detections;
+    GArray                  *detections;
 };
 
 struct _GstHaarDetectClass
@@ -124,6 +124,7 @@ gst_hog_detect_finalize(GObject *obj)
     if (filter->image)       cvReleaseImage(&filter->image);
     if (filter->save_prefix) g_free(filter->save_prefix);
     if (filter->hog)         cvHogRelease(filter->hog);
+    if (filter->detections)  g_array_free(filter->detections, TRUE);
 
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -226,6 +227,7 @@ gst_hog_detect_init(GstHogDetect *filter, GstHogDetectClass *gclass)
     filter->confidence_density_threshold = DEFAULT_CONFIDENCE_DENSITY_THRESHOLD;
     filter->save_images                  = FALSE;
     filter->save_prefix                  = g_strdup(DEFAULT_SAVE_PREFIX);
+    filter->detections                   = detections_array_new();
 
     // TODO: turn the hardcoded HOG parameters below into gobject properties;
     // I'm not sure that's very useful until we convert the feature vector
@@ -398,9 +400,7 @@ gst_hog_detect_chain(GstPad *pad, GstBuffer *buf)
     }
 
     for (i = 0; i < found_filtered->total; ++i) {
-        CvRect       *r;
-        GstEvent     *event;
-        GstStructure *structure;
+        CvRect *r;
 
         r = (CvRect*) cvGetSeqElem(found_filtered, i);
 
@@ -412,16 +412,7 @@ gst_hog_detect_chain(GstPad *pad, GstBuffer *buf)
         r->y     += cvRound(r->height * 0.07);
         r->height = cvRound(r->height * 0.80);
 
-        structure = gst_structure_new("hog-detect-roi",
-                                      "x",      G_TYPE_UINT, r->x,
-                                      "y",      G_TYPE_UINT, r->y,
-                                      "width",  G_TYPE_UINT, r->width,
-                                      "height", G_TYPE_UINT, r->height,
-                                      "timestamp", G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                      NULL);
-
-        event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-        gst_pad_push_event(filter->srcpad, event);
+        detections_array_add(filter->detections, *r, 1.0f);
 
         if (filter->verbose)
             GST_INFO_OBJECT(filter, "[hog] x: %d, y: %d, width: %d, height: %d",
@@ -463,6 +454,14 @@ gst_hog_detect_chain(GstPad *pad, GstBuffer *buf)
         }
     }
 
+    // send all the hogs found on this frame in a single event
+    if (filter->detections->len > 0) {
+        gst_pad_push_event(filter->srcpad,
+                           detections_event_new(DETECTION_SOURCE_HOG_DETECT, GST_BUFFER_TIMESTAMP(buf),
+                                                filter->detections));
+        g_array_set_size(filter->detections, 0);
+    }
+
     // release the 'cvSeq's and associated mem storage
     cvReleaseMemStorage(&found->storage);
     cvReleaseMemStorage(&found_filtered->storage);
@@ -49,6 +49,7 @@
 #include <gst/gst.h>
 #include <cv.h>
 #include <cvaux.h>
+#include <detections.h>
 
 G_BEGIN_DECLS
 
@@ -79,6 +80,7 @@ struct _GstHogDetect
     gfloat     confidence_density_threshold;
     gboolean   save_images;
     gchar     *save_prefix;
+    GArray    *detections;
 };
 
 struct _GstHogDetectClass
@@ -102,33 +102,42 @@ enum
     PROP_CLOSED_MIN_THRESHOLD
 };
 
-// TODO: convert data structures to:
-//
-// struct TimestampedDistance {uint64 timestamp; float distance;};
-// GHashTable tracked_objects<char*, GArray<TimestampedDistance>;
-// // insertion
-// tracked_objects[obj1->name + ':' + object2->name].append(new TimestampedDistance{timestamp, distance});
-// ...
-// // implement binary search
-// timestamped_distances = tracked_objects[obj1->name + ':' + object2->name];
-// idx = binary_search(timestamped_distances, old_timestamp)
-// for (i = idx; i < idx; ++i) {
-//     {timestamp, distance} = timestamped_distances[i];
-//     // event logic
-// }
-
-struct _ObjectList
+struct _SceneObject
 {
+    guint         uid;
     gchar        *name;
     gint          type_0ojb_1area;
-    GstClockTime  last_timestamp;
-    GArray       *relations;
+    guint         n_relations;
+};
+
+// the statistics of the distances between two objects that classify their
+// interaction, updated with each distance
+typedef struct {
+    gfloat  first;
+    gfloat  last;
+    gfloat  val_min;
+    gfloat  val_max;
+    gfloat  sum_neg;
+    gfloat  sum_pos;
+    gfloat  perc_hit;
+    guint   i_min;
+    guint   len;
+} RelationStats;
+
+// the distances between two objects, whichever sent first being 'obj_a'
+struct _SceneRelation
+{
+    guint64        key;
+    SceneObject   *obj_a;
+    SceneObject   *obj_b;
+    GstClockTime   last_timestamp;
+    RelationStats  stats;
 };
 
 struct _EventInteractionInDistance
 {
-    gchar       *obj_a_name;
-    gchar       *obj_b_name;
+    guint        obj_a_uid;
+    guint        obj_b_uid;
     gfloat       distance;
     GstClockTime timestamp;
 };
@@ -153,9 +162,14 @@ static void            gst_interpreter_interaction_get_property          (GObjec
 static gboolean        gst_interpreter_interaction_set_caps              (GstPad *pad, GstCaps *caps);
 static GstFlowReturn   gst_interpreter_interaction_chain                 (GstPad *pad, GstBuffer *buf);
 static gboolean        gst_interpreter_interaction_events_cb             (GstPad *pad, GstEvent *event, gpointer user_data);
-static ObjectList*     gst_interpreter_interaction_include_objects_itens (GArray *list, gint type_0ojb_1area, gchar *name, GstClockTime timestamp, guint sizeof_relation_item);
+static guint          gst_interpreter_interaction_get_uid               (GstInterpreterInteraction *filter, const gchar *id);
+static gboolean        gst_interpreter_interaction_uid_out_of_scene      (gpointer key, gpointer value, gpointer user_data);
+static SceneObject*    gst_interpreter_interaction_get_scene_object      (GstInterpreterInteraction *filter, const TrackedObject *object);
+static SceneRelation*  gst_interpreter_interaction_get_relation          (GstInterpreterInteraction *filter, SceneObject *obj_a, SceneObject *obj_b);
+static void            gst_interpreter_interaction_remove_relation       (GstInterpreterInteraction *filter, guint index);
 static void            gst_interpreter_interaction_process_events        (GstInterpreterInteraction *filter, const guint64 old_timestampdiff_to_process);
-static TrackedObject*  gst_interpreter_interaction_get_tracked_object    (GArray *list, gchar *name);
+static void            gst_interpreter_interaction_add_distance          (SceneRelation *relation, gfloat distance);
+static void            gst_interpreter_interaction_publish_event         (GstInterpreterInteraction *filter, SceneRelation *relation, SceneObject *object, SceneObject *other, const RelationStats *stats);
 
 // clean up
 static void
@@ -167,9 +181,12 @@ gst_interpreter_interaction_finalize(GObject *obj)
     gst_interpreter_interaction_process_events(filter, 0);
 
     if (filter->image)                          cvReleaseImage(&filter->image);
-    if (filter->objects_in_scene)               g_array_free(filter->objects_in_scene, TRUE);
+    if (filter->relations_index)                g_hash_table_destroy(filter->relations_index);
+    if (filter->relations)                      g_ptr_array_free(filter->relations, TRUE);
+    if (filter->objects_in_scene)               g_hash_table_destroy(filter->objects_in_scene);
     if (filter->event_interaction_in_distance)  g_array_free(filter->event_interaction_in_distance, TRUE);
-    if (filter->event_interaction_in_objects)   g_array_free(filter->event_interaction_in_objects, TRUE);
+    if (filter->event_interaction_in_objects)   g_hash_table_destroy(filter->event_interaction_in_objects);
+    if (filter->object_uids)                    g_hash_table_destroy(filter->object_uids);
 
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -212,7 +229,7 @@ gst_interpreter_interaction_class_init(GstInterpreterInteractionClass *klass)
                                                          FALSE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_DISPLAY_DATA,
-                                    g_param_spec_boolean("display-data", "Display data", "Print data structure",
+                                    g_param_spec_boolean("display-data", "Display data", "Print the statistics of the distances between the objects in the scene",
                                                          FALSE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_CLOSED_MIN_THRESHOLD,
@@ -243,9 +260,14 @@ gst_interpreter_interaction_init(GstInterpreterInteraction *filter, GstInterpret
     filter->display_data                  = FALSE;
     filter->closed_min_threshold          = DEFAULT_CLOSED_MIN_THRESHOLD;
 
-    filter->objects_in_scene              = g_array_sized_new(FALSE, FALSE, sizeof(ObjectList), 1);
+    filter->object_uids                   = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    filter->next_uid                      = 1;
+    filter->objects_in_scene              = g_hash_table_new(g_direct_hash, g_direct_equal);
+    filter->relations                     = g_ptr_array_new();
+    filter->relations_index               = g_hash_table_new(g_int64_hash, g_int64_equal);
     filter->event_interaction_in_distance = g_array_sized_new(FALSE, FALSE, sizeof(EventInteractionInDistance), 1);
-    filter->event_interaction_in_objects  = g_array_sized_new(FALSE, FALSE, sizeof(TrackedObject), 1);
+    filter->event_interaction_in_objects  = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                                                  (GDestroyNotify) tracked_object_free);
 }
 
 static void
@@ -345,65 +367,55 @@ gst_interpreter_interaction_chain(GstPad *pad, GstBuffer *buf)
     filter->timestamp = GST_BUFFER_TIMESTAMP(buf);
 
     if ((filter->event_interaction_in_distance != NULL) && (filter->event_interaction_in_distance->len > 0)) {
-        gint i;
+        guint i;
 
-        for (i = filter->event_interaction_in_distance->len - 1; i >= 0; --i) {
-            ObjectList                 *objectlist_temp;
+        for (i = 0; i < filter->event_interaction_in_distance->len; ++i) {
+            SceneRelation              *relation;
             EventInteractionInDistance *object_temp_distance;
             TrackedObject              *object_temp_informations_a, *object_temp_informations_b;
-            TrackedObjectType           obj_a_type, obj_b_type;
 
             // get get distance between objects
             object_temp_distance = &g_array_index(filter->event_interaction_in_distance, EventInteractionInDistance, i);
+            if (object_temp_distance->obj_a_uid == object_temp_distance->obj_b_uid)
+                continue;
 
             // get informatios of object of object_temp_distance structure
-            object_temp_informations_a = gst_interpreter_interaction_get_tracked_object(filter->event_interaction_in_objects, object_temp_distance->obj_a_name);
-            object_temp_informations_b = gst_interpreter_interaction_get_tracked_object(filter->event_interaction_in_objects, object_temp_distance->obj_b_name);
-            if (object_temp_informations_a == NULL || object_temp_informations_b == NULL)
+            object_temp_informations_a = g_hash_table_lookup(filter->event_interaction_in_objects, GUINT_TO_POINTER(object_temp_distance->obj_a_uid));
+            object_temp_informations_b = g_hash_table_lookup(filter->event_interaction_in_objects, GUINT_TO_POINTER(object_temp_distance->obj_b_uid));
+            if (object_temp_informations_a == NULL || object_temp_informations_b == NULL) {
                 GST_WARNING_OBJECT(filter, "object information not found");
+                continue;
+            }
 
-            obj_a_type = object_temp_informations_a->type;
-            obj_b_type = object_temp_informations_b->type;
-
-            // include objectlist A->B
-            objectlist_temp = gst_interpreter_interaction_include_objects_itens(filter->objects_in_scene,   obj_a_type, object_temp_distance->obj_a_name, 0, sizeof(ObjectList));
-            objectlist_temp = gst_interpreter_interaction_include_objects_itens(objectlist_temp->relations, obj_b_type, object_temp_distance->obj_b_name, object_temp_distance->timestamp, sizeof(gfloat));
-            g_array_append_val(objectlist_temp->relations, object_temp_distance->distance);
-
-            // include objectlist B->A
-            objectlist_temp = gst_interpreter_interaction_include_objects_itens(filter->objects_in_scene,   obj_b_type, object_temp_distance->obj_b_name, 0, sizeof(ObjectList));
-            objectlist_temp = gst_interpreter_interaction_include_objects_itens(objectlist_temp->relations, obj_a_type, object_temp_distance->obj_a_name, object_temp_distance->timestamp, sizeof(gfloat));
-            g_array_append_val(objectlist_temp->relations, object_temp_distance->distance);
-
-            // clean the distance structure
-            g_array_remove_index_fast(filter->event_interaction_in_distance, i);
+            // include the distance in the relation A<->B
+            relation = gst_interpreter_interaction_get_relation(filter,
+                                                                gst_interpreter_interaction_get_scene_object(filter, object_temp_informations_a),
+                                                                gst_interpreter_interaction_get_scene_object(filter, object_temp_informations_b));
+            relation->last_timestamp = object_temp_distance->timestamp;
+            gst_interpreter_interaction_add_distance(relation, object_temp_distance->distance);
         }
+
+        // clean the distance structure
+        g_array_set_size(filter->event_interaction_in_distance, 0);
     }
 
     // clean objectinformations structure
-    g_array_free(filter->event_interaction_in_objects, TRUE);
-    filter->event_interaction_in_objects = g_array_sized_new(FALSE, FALSE, sizeof(TrackedObject), 1);
+    g_hash_table_remove_all(filter->event_interaction_in_objects);
 
     // show the data structure
-    if (filter->display_data && filter->objects_in_scene && filter->objects_in_scene->len) {
-        guint j, k, m;
-        ObjectList *objectlist;
-        ObjectList *objectlist2;
-        gfloat dist;
-
-        for (j = 0; j < filter->objects_in_scene->len; ++j) {
-            objectlist = &g_array_index(filter->objects_in_scene, ObjectList, j);
-            GST_INFO("%s (type_0ojb_1area: %i) - time: %lld\n", objectlist->name, objectlist->type_0ojb_1area, objectlist->last_timestamp);
-
-            for (m = 0; m < objectlist->relations->len; ++m) {
-                objectlist2 = &g_array_index(objectlist->relations, ObjectList, m);
-                GST_INFO("\t%s (type_0ojb_1area: %i) - time: %lld\n", objectlist2->name, objectlist2->type_0ojb_1area, objectlist2->last_timestamp);
-
-                for (k = 0; k < objectlist2->relations->len; ++k) {
-                    dist = g_array_index(objectlist2->relations, gfloat, k);
-                    GST_INFO("\t\tdist: %1.2f\n", dist);
-                }
-            }
+    if (filter->display_data && filter->relations->len) {
+        guint          j;
+        SceneRelation *relation;
+
+        for (j = 0; j < filter->relations->len; ++j) {
+            relation = g_ptr_array_index(filter->relations, j);
+            GST_INFO("%s (type_0ojb_1area: %i) <-> %s (type_0ojb_1area: %i) - time: %lld\n",
+                     relation->obj_a->name, relation->obj_a->type_0ojb_1area,
+                     relation->obj_b->name, relation->obj_b->type_0ojb_1area,
+                     relation->last_timestamp);
+            GST_INFO("\tdistances: %u, first: %1.2f, last: %1.2f, min: %1.2f, max: %1.2f\n",
+                     relation->stats.len, relation->stats.first, relation->stats.last,
+                     relation->stats.val_min, relation->stats.val_max);
         }
         GST_INFO("\n");
     }
@@ -411,6 +423,12 @@ gst_interpreter_interaction_chain(GstPad *pad, GstBuffer *buf)
     // processes finalized events
     gst_interpreter_interaction_process_events(filter, OLD_TIMESTAMPDIFF_TO_PROCESS);
 
+    // forget the ids of the objects that left the scene (or never entered
+    // it); the counter starts over once the scene is empty
+    g_hash_table_foreach_remove(filter->object_uids, gst_interpreter_interaction_uid_out_of_scene, filter);
+    if (g_hash_table_size(filter->object_uids) == 0)
+        filter->next_uid = 1;
+
     gst_buffer_set_data(buf, (guint8*) filter->image->imageData, (guint) filter->image->imageSize);
     return gst_pad_push(filter->srcpad, buf);
 }
@@ -435,174 +453,231 @@ gst_interpreter_interaction_events_cb(GstPad *pad, GstEvent *event, gpointer use
     if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "tracked-object") == 0)) {
         TrackedObject *object;
         object = tracked_object_from_structure(structure);
-        g_array_append_val(filter->event_interaction_in_objects, *object);
+        object->uid = gst_interpreter_interaction_get_uid(filter, object->id);
+        g_hash_table_replace(filter->event_interaction_in_objects, GUINT_TO_POINTER(object->uid), object);
     }
 
     // Get object distance
     if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "tracked-objects-distance") == 0)) {
         EventInteractionInDistance oi;
         gst_structure_get((GstStructure*) structure,
-              "obj1",       G_TYPE_STRING,  &oi.obj_a_name,
-              "obj2",       G_TYPE_STRING,  &oi.obj_b_name,
               "distance",   G_TYPE_FLOAT,   &oi.distance,
               "timestamp",  G_TYPE_UINT64,  &oi.timestamp,
               NULL);
+        oi.obj_a_uid = gst_interpreter_interaction_get_uid(filter, gst_structure_get_string(structure, "obj1"));
+        oi.obj_b_uid = gst_interpreter_interaction_get_uid(filter, gst_structure_get_string(structure, "obj2"));
+
         g_array_append_val(filter->event_interaction_in_distance, oi);
     }
 
     return TRUE;
 }
 
-static ObjectList*
-gst_interpreter_interaction_include_objects_itens(GArray *list, gint type_0ojb_1area, gchar *name,
-                                                  GstClockTime timestamp, guint sizeof_relation_item)
+// the integer id of an object name, assigned on its first use
+static guint
+gst_interpreter_interaction_get_uid(GstInterpreterInteraction *filter, const gchar *id)
 {
-    guint       i;
-    ObjectList *objectlist_temp;
+    gpointer uid;
 
-    // find object in list
-    for (i = 0; i < list->len; ++i) {
-        objectlist_temp = &g_array_index(list, ObjectList, i);
-        if (strcmp(objectlist_temp->name, name) == 0)
-            break;
+    if (id == NULL)
+        return 0;
+
+    uid = g_hash_table_lookup(filter->object_uids, id);
+    if (uid == NULL) {
+        uid = GUINT_TO_POINTER(filter->next_uid++);
+        g_hash_table_insert(filter->object_uids, g_strdup(id), uid);
+    }
+
+    return GPOINTER_TO_UINT(uid);
+}
+
+static gboolean
+gst_interpreter_interaction_uid_out_of_scene(gpointer key, gpointer value, gpointer user_data)
+{
+    GstInterpreterInteraction *filter = GST_INTERPRETER_INTERACTION(user_data);
+
+    return g_hash_table_lookup(filter->objects_in_scene, value) == NULL;
+}
+
+static SceneObject*
+gst_interpreter_interaction_get_scene_object(GstInterpreterInteraction *filter, const TrackedObject *object)
+{
+    SceneObject *scene_object;
+
+    scene_object = g_hash_table_lookup(filter->objects_in_scene, GUINT_TO_POINTER(object->uid));
+    if (scene_object == NULL) {
+        // create a new SceneObject instance if the object was not found
+        scene_object                  = g_new(SceneObject, 1);
+        scene_object->uid             = object->uid;
+        scene_object->name            = g_strdup(object->id);
+        scene_object->type_0ojb_1area = object->type;
+        scene_object->n_relations     = 0;
+        g_hash_table_insert(filter->objects_in_scene, GUINT_TO_POINTER(scene_object->uid), scene_object);
     }
 
-    if (i >= list->len) {
-        // create a new ObjectList instance if the object was not found
-        objectlist_temp                     = g_new(ObjectList, 1);
-        objectlist_temp->type_0ojb_1area    = type_0ojb_1area;
-        objectlist_temp->relations          = g_array_sized_new(FALSE, FALSE, sizeof_relation_item, 1);
-        objectlist_temp->name               = g_strdup_printf("%s", name);
-        g_array_append_val(list, *objectlist_temp);
+    return scene_object;
+}
+
+// the relation between both objects, whatever their order, is created on
+// the first distance between them
+static SceneRelation*
+gst_interpreter_interaction_get_relation(GstInterpreterInteraction *filter, SceneObject *obj_a, SceneObject *obj_b)
+{
+    SceneRelation *relation;
+    guint64        key;
+
+    key = ((guint64) MIN(obj_a->uid, obj_b->uid) << 32) | MAX(obj_a->uid, obj_b->uid);
+    relation = g_hash_table_lookup(filter->relations_index, &key);
+    if (relation == NULL) {
+        relation            = g_new0(SceneRelation, 1);
+        relation->key       = key;
+        relation->obj_a     = obj_a;
+        relation->obj_b     = obj_b;
+        obj_a->n_relations++;
+        obj_b->n_relations++;
+
+        g_ptr_array_add(filter->relations, relation);
+        g_hash_table_insert(filter->relations_index, &relation->key, relation);
     }
-    objectlist_temp->last_timestamp     = timestamp;
 
-    // return its point
-    return objectlist_temp;
+    return relation;
 }
 
-static TrackedObject*
-gst_interpreter_interaction_get_tracked_object(GArray *list, gchar *name)
+// the objects go out of the scene with their last relation
+static void
+gst_interpreter_interaction_remove_relation(GstInterpreterInteraction *filter, guint index)
 {
+    SceneRelation *relation;
+    SceneObject   *objects[2];
     guint          i;
-    TrackedObject *object_temp;
 
-    // find object in list
-    for (i = 0; i < list->len; ++i) {
-        object_temp = &g_array_index(list, TrackedObject, i);
-        if (strcmp(object_temp->id, name) == 0)
-            return object_temp;
+    relation = g_ptr_array_index(filter->relations, index);
+    g_hash_table_remove(filter->relations_index, &relation->key);
+    g_ptr_array_remove_index_fast(filter->relations, index);
+
+    objects[0] = relation->obj_a;
+    objects[1] = relation->obj_b;
+    for (i = 0; i < 2; ++i) {
+        if (--objects[i]->n_relations == 0) {
+            g_hash_table_remove(filter->objects_in_scene, GUINT_TO_POINTER(objects[i]->uid));
+            g_free(objects[i]->name);
+            g_free(objects[i]);
+        }
     }
 
-    return NULL;
+    g_free(relation);
+}
+
+// the distances themselves are not kept, only what classifies them
+static void
+gst_interpreter_interaction_add_distance(SceneRelation *relation, gfloat distance)
+{
+    RelationStats *stats = &relation->stats;
+    gfloat         g;
+
+    if (stats->len == 0) {
+        stats->first   = distance;
+        stats->val_min = stats->val_max = distance;
+    } else {
+        g = distance - stats->last;
+
+        if (g < 0) stats->sum_neg += g;
+        else       stats->sum_pos += g;
+
+        if (stats->val_min > distance) {
+            stats->val_min = distance;
+            stats->i_min   = stats->len;
+        }
+        if (stats->val_max < distance)
+            stats->val_max = distance;
+    }
+    stats->last = distance;
+    stats->len++;
 }
 
 static void
 gst_interpreter_interaction_process_events(GstInterpreterInteraction *filter, const guint64 old_timestampdiff_to_process)
 {
-    ObjectList *objectlist, *objectlist2;
-    gint        j, m;
-    guint       k;
+    SceneRelation *relation;
+    RelationStats *stats;
+    guint          i;
 
     // sanity checks
     g_assert(filter != NULL);
 
-    // return if no objects have been received yet
-    if ((filter->objects_in_scene == NULL) || (filter->objects_in_scene->len == 0))
-        return;
-
-    for (j = filter->objects_in_scene->len - 1; j >= 0; --j) {
-        objectlist = &g_array_index(filter->objects_in_scene, ObjectList, j);
-
-        for (m = objectlist->relations->len - 1; m >= 0; --m) {
-            objectlist2 = &g_array_index(objectlist->relations, ObjectList, m);
-
-            if ((filter->timestamp - objectlist2->last_timestamp) >= old_timestampdiff_to_process) {
-                if (objectlist2->relations->len >= 2) {
-                    gfloat sum_neg, sum_pos, val_min, val_max, a, b, g, perc_hit;
-                    guint  i_min;
-
-                    i_min             = 0;
-                    sum_pos = sum_neg = 0.0f;
-                    val_min = val_max = g_array_index(objectlist2->relations, gfloat, 0);
-                    for (k = 1; k < objectlist2->relations->len; ++k) {
-                        a = g_array_index(objectlist2->relations, gfloat, k - 1);
-                        b = g_array_index(objectlist2->relations, gfloat, k);
-                        g = b - a;
-
-                        if (g < 0) sum_neg += g;
-                        else       sum_pos += g;
-
-                        if (val_min > b) {
-                            val_min = b;
-                            i_min   = k;
-                        }
-                        if (val_max < b)
-                            val_max = b;
-                    }
-                    perc_hit = (val_max - val_min) == 0.0f ? 0.0f : (sum_neg + sum_pos) / (val_max - val_min);
-
-                    // jump inconclusive situations
-                    if (perc_hit >= MIN_PERC_HIT) {
-                        GstMessage   *message;
-                        GstEvent     *event;
-                        GstStructure *structure;
-                        char         *label;
-
-                        // manual processing of events; only obj->obj or obj->area interaction
-                        if (!objectlist->type_0ojb_1area) {
-                            // if the object is an area, identify if other object left him out
-                            if ((objectlist2->type_0ojb_1area == 1)  &&
-                                (perc_hit >= MIN_PERC_HIT_TO_CLOSED) &&
-                                (sum_pos > -sum_neg)                 &&
-                                (g_array_index(objectlist2->relations, gfloat, 0) <= filter->closed_min_threshold)) {
-                                label = g_strdup_printf("exit");
-                            } else {
-                                // if there is divergence of the distance signal, evaluates the possibility of A 'spent by' B
-                                if ((i_min != 0)                              &&
-                                    (val_min <= filter->closed_min_threshold) &&
-                                    (i_min != objectlist2->relations->len)    &&
-                                    (perc_hit < MIN_PERC_HIT_TO_CLOSED)) {
-                                    label = g_strdup_printf("overlap");
-                                } else {
-                                    // in the latter case, saying A approached or departed of B
-                                    if (sum_pos > -sum_neg)
-                                        label = g_strdup_printf("leave");
-                                    else
-                                        label = g_strdup_printf("approach");
-                                }
-                            }
-
-                            if (filter->verbose)
-                                GST_INFO("%s '%s' %s (perc_hit: %1.2f)", objectlist->name, label, objectlist2->name, perc_hit);
-
-                            // send downstream event
-                            structure = gst_structure_new("tracked-objects-interaction",
-                                                          "obj1",       G_TYPE_STRING, objectlist->name,
-                                                          "obj2",       G_TYPE_STRING, objectlist2->name,
-                                                          "event",      G_TYPE_STRING, label,
-                                                          "confidence", G_TYPE_FLOAT,  perc_hit,
-                                                          "timestamp",  G_TYPE_UINT64, objectlist2->last_timestamp,
-                                                          NULL);
-
-                            message = gst_message_new_element(GST_OBJECT(filter), gst_structure_copy(structure));
-                            gst_element_post_message(GST_ELEMENT(filter), message);
-                            event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-                            gst_pad_push_event(filter->srcpad, event);
-
-                            g_free(label);
-                        }
-                    }
-                }
-
-                g_array_free(objectlist2->relations, TRUE);
-                g_array_remove_index_fast(objectlist->relations, m);
+    for (i = filter->relations->len; i-- > 0; ) {
+        relation = g_ptr_array_index(filter->relations, i);
+        stats    = &relation->stats;
+
+        if ((filter->timestamp - relation->last_timestamp) < old_timestampdiff_to_process)
+            continue;
+
+        if (stats->len >= 2) {
+            stats->perc_hit = (stats->val_max - stats->val_min) == 0.0f ? 0.0f :
+                              (stats->sum_neg + stats->sum_pos) / (stats->val_max - stats->val_min);
+
+            // jump inconclusive situations; manual processing of events, only
+            // obj->obj or obj->area interaction
+            if (stats->perc_hit >= MIN_PERC_HIT) {
+                if (!relation->obj_a->type_0ojb_1area)
+                    gst_interpreter_interaction_publish_event(filter, relation, relation->obj_a, relation->obj_b, stats);
+                if (!relation->obj_b->type_0ojb_1area)
+                    gst_interpreter_interaction_publish_event(filter, relation, relation->obj_b, relation->obj_a, stats);
             }
         }
 
-        if (!objectlist->relations->len)
-            g_array_remove_index_fast(filter->objects_in_scene, j);
+        gst_interpreter_interaction_remove_relation(filter, i);
+    }
+}
+
+// interaction of 'object' with 'other'
+static void
+gst_interpreter_interaction_publish_event(GstInterpreterInteraction *filter, SceneRelation *relation,
+                                          SceneObject *object, SceneObject *other, const RelationStats *stats)
+{
+    GstMessage   *message;
+    GstEvent     *event;
+    GstStructure *structure;
+    const gchar  *label;
+
+    // if the object is an area, identify if other object left him out
+    if ((other->type_0ojb_1area == 1)               &&
+        (stats->perc_hit >= MIN_PERC_HIT_TO_CLOSED) &&
+        (stats->sum_pos > -stats->sum_neg)          &&
+        (stats->first <= filter->closed_min_threshold)) {
+        label = "exit";
+    } else {
+        // if there is divergence of the distance signal, evaluates the possibility of A 'spent by' B
+        if ((stats->i_min != 0)                              &&
+            (stats->val_min <= filter->closed_min_threshold) &&
+            (stats->i_min != stats->len)                     &&
+            (stats->perc_hit < MIN_PERC_HIT_TO_CLOSED)) {
+            label = "overlap";
+        } else {
+            // in the latter case, saying A approached or departed of B
+            if (stats->sum_pos > -stats->sum_neg)
+                label = "leave";
+            else
+                label = "approach";
+        }
     }
+
+    if (filter->verbose)
+        GST_INFO("%s '%s' %s (perc_hit: %1.2f)", object->name, label, other->name, stats->perc_hit);
+
+    // send downstream event
+    structure = gst_structure_new("tracked-objects-interaction",
+                                  "obj1",       G_TYPE_STRING, object->name,
+                                  "obj2",       G_TYPE_STRING, other->name,
+                                  "event",      G_TYPE_STRING, label,
+                                  "confidence", G_TYPE_FLOAT,  stats->perc_hit,
+                                  "timestamp",  G_TYPE_UINT64, relation->last_timestamp,
+                                  NULL);
+
+    message = gst_message_new_element(GST_OBJECT(filter), gst_structure_copy(structure));
+    gst_element_post_message(GST_ELEMENT(filter), message);
+    event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+    gst_pad_push_event(filter->srcpad, event);
 }
 
 // entry point to initialize the plug-in; initialize the plug-in itself
@@ -60,7 +60,8 @@ G_BEGIN_DECLS
 
 typedef struct _GstInterpreterInteraction GstInterpreterInteraction;
 typedef struct _GstInterpreterInteractionClass GstInterpreterInteractionClass;
-typedef struct _ObjectList ObjectList;
+typedef struct _SceneObject SceneObject;
+typedef struct _SceneRelation SceneRelation;
 typedef struct _EventInteractionInDistance EventInteractionInDistance;
 
 struct _GstInterpreterInteraction
@@ -76,10 +77,18 @@ struct _GstInterpreterInteraction
     gboolean      display_data;
     gfloat        closed_min_threshold;
 
-    GArray       *objects_in_scene;
+    // integer ids of the object names, local to the element; only those
+    // of the objects in the scene are kept between frames
+    GHashTable   *object_uids;
+    guint         next_uid;
+
+    // objects by uid, and their relations by pair of uids
+    GHashTable   *objects_in_scene;
+    GPtrArray    *relations;
+    GHashTable   *relations_index;
 
     GArray       *event_interaction_in_distance;
-    GArray       *event_interaction_in_objects;
+    GHashTable   *event_interaction_in_objects;
     GstClockTime  timestamp;
 };
 
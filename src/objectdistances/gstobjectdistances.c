@@ -69,12 +69,16 @@
 #include "gstobjectdistances.h"
 #include "tracked-object.h"
 #include "draw.h"
+#include "spatial-index.h"
 
 #include <gst/gst.h>
 #include <gst/gststructure.h>
 
 #define LINE_COLOR CV_RGB(127, 31, 127)
 
+// Distances above it are not published (0 = no limit)
+#define DEFAULT_MAX_DISTANCE 0.0f
+
 GST_DEBUG_CATEGORY_STATIC(gst_object_distances_debug);
 #define GST_CAT_DEFAULT gst_object_distances_debug
 
@@ -82,7 +86,8 @@ enum {
     PROP_0,
     PROP_VERBOSE,
     PROP_OBJECTS,
-    PROP_DISPLAY
+    PROP_DISPLAY,
+    PROP_MAX_DISTANCE
 };
 
 // the capabilities of the inputs and outputs.
@@ -106,6 +111,7 @@ static gboolean      gst_object_distances_set_caps          (GstPad *pad, GstCap
 static GstFlowReturn gst_object_distances_chain             (GstPad *pad, GstBuffer *buf);
 static gboolean      gst_object_distances_parse_objects_str (GstObjectDistances *filter);
 static gboolean      gst_object_distances_events_cb         (GstPad *pad, GstEvent *event, gpointer user_data);
+static void          gst_object_distances_find_pairs        (GstObjectDistances *filter, GPtrArray *objects, GArray *pairs);
 static float         gst_object_distance_euclidian_distance (TrackedObject *object1, TrackedObject *object2, CvPoint2D32f *point1, CvPoint2D32f *point2);
 
 static void
@@ -159,6 +165,11 @@ gst_object_distances_class_init(GstObjectDistancesClass *klass)
                                     g_param_spec_boolean("display", "Display",
                                                          "Highligh the interations in the video output",
                                                          FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_MAX_DISTANCE,
+                                    g_param_spec_float("max-distance", "Max distance",
+                                                       "Largest distance, in pixels, published between two objects (0 = no limit); farther pairs aren't even measured",
+                                                       0.0f, G_MAXFLOAT, DEFAULT_MAX_DISTANCE, G_PARAM_READWRITE));
 }
 
 // initialize the new element
@@ -182,6 +193,7 @@ gst_object_distances_init(GstObjectDistances *filter, GstObjectDistancesClass *g
 
     filter->verbose      = FALSE;
     filter->display      = FALSE;
+    filter->max_distance = DEFAULT_MAX_DISTANCE;
     filter->objects_list = NULL;
 }
 
@@ -197,6 +209,9 @@ gst_object_distances_set_property(GObject *object, guint prop_id, const GValue *
         case PROP_DISPLAY:
             filter->display = g_value_get_boolean(value);
             break;
+        case PROP_MAX_DISTANCE:
+            filter->max_distance = g_value_get_float(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -215,6 +230,9 @@ gst_object_distances_get_property(GObject *object, guint prop_id, GValue *value,
         case PROP_DISPLAY:
             g_value_set_boolean(value, filter->display);
             break;
+        case PROP_MAX_DISTANCE:
+            g_value_set_float(value, filter->max_distance);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -251,7 +269,10 @@ static GstFlowReturn
 gst_object_distances_chain(GstPad *pad, GstBuffer *buf)
 {
     GstObjectDistances *filter;
-    GList              *iter1, *iter2, *iter_next;
+    GList              *iter, *iter_next;
+    GPtrArray          *objects;
+    GArray             *pairs;
+    guint               i;
 
     // sanity checks
     g_return_val_if_fail(pad != NULL, GST_FLOW_ERROR);
@@ -260,74 +281,138 @@ gst_object_distances_chain(GstPad *pad, GstBuffer *buf)
     filter = GST_OBJECT_DISTANCES(GST_OBJECT_PARENT(pad));
     filter->image->imageData = (char*) GST_BUFFER_DATA(buf);
 
+    // take the tracked objects of this frame out of the list; the others
+    // (where the timestamp doesn't match) are kept
+    objects = g_ptr_array_new();
+    for (iter = filter->objects_list; iter != NULL; iter = iter_next) {
+        iter_next = iter->next;
+
+        if (((TrackedObject*) iter->data)->timestamp != GST_BUFFER_TIMESTAMP(buf))
+            continue;
+
+        g_ptr_array_add(objects, iter->data);
+        filter->objects_list = g_list_delete_link(filter->objects_list, iter);
+    }
+
     // send downstream events with the euclidian distance between each pair
     // of tracked objects
-    for (iter1 = filter->objects_list; iter1 != NULL; iter1 = iter_next) {
-        TrackedObject *tracked_object1 = iter1->data;
-
-        iter_next = iter1->next;
+    pairs = g_array_new(FALSE, FALSE, sizeof(SpatialPair));
+    gst_object_distances_find_pairs(filter, objects, pairs);
+
+    for (i = 0; i < pairs->len; ++i) {
+        GstEvent      *event;
+        GstStructure  *structure;
+        TrackedObject *tracked_object1, *tracked_object2;
+        CvPoint2D32f   point1, point2;
+        float          distance;
+
+        tracked_object1 = g_ptr_array_index(objects, g_array_index(pairs, SpatialPair, i).a);
+        tracked_object2 = g_ptr_array_index(objects, g_array_index(pairs, SpatialPair, i).b);
+
+        // dont't calculate/publish distances between static objects
+        if ((tracked_object1->type == TRACKED_OBJECT_STATIC) &&
+            (tracked_object2->type == TRACKED_OBJECT_STATIC))
+            continue;
 
-        // skip objects where the timestamp doesn't match
-        if (tracked_object1->timestamp != GST_BUFFER_TIMESTAMP(buf))
+        point1.x = point1.y = point2.x = point2.y = 0.0f; // avoid gcc warnings
+        distance = gst_object_distance_euclidian_distance(tracked_object1, tracked_object2,
+                                                          &point1, &point2);
+        if ((filter->max_distance > 0) && (distance > filter->max_distance))
             continue;
 
-        for (iter2 = iter1->next; iter2 != NULL; iter2 = iter2->next) {
-            GstEvent      *event;
-            GstStructure  *structure;
-            TrackedObject *tracked_object2;
-            CvPoint2D32f   point1, point2;
-            float          distance;
-
-            tracked_object2 = iter2->data;
-
-            // skip objects where the timestamp doesn't match
-            if (tracked_object2->timestamp != GST_BUFFER_TIMESTAMP(buf))
-                continue;
-
-            // dont't calculate/publish distances between static objects
-            if ((tracked_object1->type == TRACKED_OBJECT_STATIC) &&
-                (tracked_object2->type == TRACKED_OBJECT_STATIC))
-                continue;
-
-            point1.x = point1.y = point2.x = point2.y = 0.0f; // avoid gcc warnings
-            distance = gst_object_distance_euclidian_distance(tracked_object1, tracked_object2,
-                                                              &point1, &point2);
-            if (filter->verbose)
-                GST_DEBUG_OBJECT(filter, "distance between %s and %s: %.2f",
-                                 tracked_object1->id, tracked_object2->id, distance);
-
-            if (filter->display) {
-                gchar *distance_label;
-
-                // draw a line between the objects and a label between them
-                cvLine(filter->image, cvPointFrom32f(point1), cvPointFrom32f(point2), LINE_COLOR, 2, 8, 0);
-
-                // then, draw a label with the distance in the middle of the line
-                distance_label = g_strdup_printf("%.2fm", distance);
-                printText(filter->image, cvPoint((point1.x + point2.x) / 2, (point1.y + point2.y) / 2),
-                          distance_label, LINE_COLOR, 0.3, TRUE);
-                g_free(distance_label);
-            }
+        if (filter->verbose)
+            GST_DEBUG_OBJECT(filter, "distance between %s and %s: %.2f",
+                             tracked_object1->id, tracked_object2->id, distance);
 
-            structure = gst_structure_new("tracked-objects-distance", 
-                                          "obj1",      G_TYPE_STRING, tracked_object1->id,
-                                          "obj2",      G_TYPE_STRING, tracked_object2->id,
-                                          "distance",  G_TYPE_FLOAT,  distance,
-                                          "timestamp", G_TYPE_UINT64, tracked_object1->timestamp,
-                                          NULL);
-            event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-            gst_pad_push_event(filter->srcpad, event);
+        if (filter->display) {
+            gchar *distance_label;
+
+            // draw a line between the objects and a label between them
+            cvLine(filter->image, cvPointFrom32f(point1), cvPointFrom32f(point2), LINE_COLOR, 2, 8, 0);
+
+            // then, draw a label with the distance in the middle of the line
+            distance_label = g_strdup_printf("%.2fm", distance);
+            printText(filter->image, cvPoint((point1.x + point2.x) / 2, (point1.y + point2.y) / 2),
+                      distance_label, LINE_COLOR, 0.3, TRUE);
+            g_free(distance_label);
         }
 
-        // free the current tracked object and add its list node to a 'to_remove' list
-        tracked_object_free(tracked_object1);
-        filter->objects_list = g_list_delete_link(filter->objects_list, iter1);
+        structure = gst_structure_new("tracked-objects-distance", 
+                                      "obj1",      G_TYPE_STRING, tracked_object1->id,
+                                      "obj2",      G_TYPE_STRING, tracked_object2->id,
+                                      "distance",  G_TYPE_FLOAT,  distance,
+                                      "timestamp", G_TYPE_UINT64, tracked_object1->timestamp,
+                                      NULL);
+        event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+        gst_pad_push_event(filter->srcpad, event);
     }
 
+    g_array_free(pairs, TRUE);
+    g_ptr_array_foreach(objects, (GFunc) tracked_object_free, NULL);
+    g_ptr_array_free(objects, TRUE);
+
     gst_buffer_set_data(buf, (guint8*) filter->image->imageData, (guint) filter->image->imageSize);
     return gst_pad_push(filter->srcpad, buf);
 }
 
+// pairs of the objects whose distance may be published, in the order of the
+// objects. Without a maximum distance, that is every pair; otherwise the
+// pairs are found from the bounding boxes of the objects, which hold the
+// points the distance is measured between
+static void
+gst_object_distances_find_pairs(GstObjectDistances *filter, GPtrArray *objects, GArray *pairs)
+{
+    CvRect *rects;
+    guint  *rect_object;
+    guint   i, j, n_rects;
+
+    if (filter->max_distance <= 0) {
+        for (i = 0; i < objects->len; ++i) {
+            for (j = i + 1; j < objects->len; ++j) {
+                SpatialPair pair;
+
+                pair.a = i;
+                pair.b = j;
+                g_array_append_val(pairs, pair);
+            }
+        }
+        return;
+    }
+
+    // objects with less than two points are never close to any other
+    rects       = g_new(CvRect, MAX(objects->len, 1));
+    rect_object = g_new(guint, MAX(objects->len, 1));
+    n_rects     = 0;
+    for (i = 0; i < objects->len; ++i) {
+        TrackedObject *object = g_ptr_array_index(objects, i);
+        CvPoint        p, min, max;
+
+        if (object->point_array->len < 2)
+            continue;
+
+        min = max = g_array_index(object->point_array, CvPoint, 0);
+        for (j = 1; j < object->point_array->len; ++j) {
+            p = g_array_index(object->point_array, CvPoint, j);
+            min.x = MIN(min.x, p.x);
+            min.y = MIN(min.y, p.y);
+            max.x = MAX(max.x, p.x);
+            max.y = MAX(max.y, p.y);
+        }
+
+        rects[n_rects]         = cvRect(min.x, min.y, max.x - min.x, max.y - min.y);
+        rect_object[n_rects++] = i;
+    }
+
+    spatial_index_find_pairs(rects, n_rects, filter->max_distance, pairs);
+    for (i = 0; i < pairs->len; ++i) {
+        g_array_index(pairs, SpatialPair, i).a = rect_object[g_array_index(pairs, SpatialPair, i).a];
+        g_array_index(pairs, SpatialPair, i).b = rect_object[g_array_index(pairs, SpatialPair, i).b];
+    }
+
+    g_free(rects);
+    g_free(rect_object);
+}
+
 // calculates the euclidian distance between the tracked objects passed
 // as parameters 'object1' and 'object2'.
 //
@@ -351,8 +436,8 @@ gst_object_distance_euclidian_distance(TrackedObject *object1, TrackedObject *ob
         centroid1.y = (p1.y + p2.y) / 2;
 
         for (j = 1; j < object2->point_array->len; ++j) {
-            p1 = cvPointTo32f(g_array_index(object2->point_array, CvPoint, i - 1));
-            p2 = cvPointTo32f(g_array_index(object2->point_array, CvPoint, i));
+            p1 = cvPointTo32f(g_array_index(object2->point_array, CvPoint, j - 1));
+            p2 = cvPointTo32f(g_array_index(object2->point_array, CvPoint, j));
 
             centroid2.x = (p1.x + p2.x) / 2;
             centroid2.y = (p1.y + p2.y) / 2;
@@ -71,6 +71,7 @@ struct _GstObjectDistances
 
     gboolean    verbose;
     gboolean    display;
+    gfloat      max_distance;
     GList      *objects_list;
 };
 
@@ -69,6 +69,7 @@
 #endif
 
 #include <gstobjectsinteraction.h>
+#include <spatial-index.h>
 
 #include <gst/gst.h>
 #include <gst/gststructure.h>
@@ -265,69 +266,78 @@ gst_objectsinteraction_chain(GstPad *pad, GstBuffer *buf)
 
     // Process all objects
     if ((filter->object_in_array != NULL) && (filter->object_in_array->len > 0)) {
-        // Find interceptions rects pairs
-        guint i, j;
-
-        for (i = 0; i < filter->object_in_array->len; ++i) {
-            for (j = i + 1; j < filter->object_in_array->len; ++j) {
-                InstanceObjectIn obj_a, obj_b;
-                gint             interception;
-
-                obj_a = g_array_index(filter->object_in_array, InstanceObjectIn, i);
-                obj_b = g_array_index(filter->object_in_array, InstanceObjectIn, j);
-                interception = 100 * MIN(rectIntercept(&obj_a.rect, &obj_b.rect), rectIntercept(&obj_b.rect, &obj_a.rect));
-
-                if (interception) {
-                    GstEvent     *event;
-                    GstMessage   *message;
-                    GstStructure *structure;
-                    CvRect        rect;
-
-                    // Interception percentage
-                    rect = rectIntersection(&obj_a.rect, &obj_b.rect);
-
-                    if (filter->verbose)
-                        GST_INFO_OBJECT(filter, "INTERCEPTION %i%%: rect_a(%i, %i, %i, %i), rect_b(%i, %i, %i, %i), rect_intercept(%i, %i, %i, %i)\n",
-                                        interception,
-                                        obj_a.rect.x, obj_a.rect.y, obj_a.rect.width, obj_a.rect.height,
-                                        obj_b.rect.x, obj_b.rect.y, obj_b.rect.width, obj_b.rect.height,
-                                        rect.x, rect.y, rect.width, rect.height);
-
-                    // Draw intercept rect and label
-                    if (filter->display) {
-                        char *label;
-                        float font_scaling;
-
-                        cvRectangle(filter->image,
-                                    cvPoint(rect.x, rect.y),
-                                    cvPoint(rect.x + rect.width, rect.y + rect.height),
-                                    PRINT_COLOR, -1, 8, 0);
-                        font_scaling = ((filter->image->width * filter->image->height) > (320 * 240)) ? 0.5f : 0.3f;
-                        label = g_strdup_printf("%i+%i (%i%%)", obj_a.id, obj_b.id, interception);
-                        printText(filter->image, cvPoint(rect.x + (rect.width / 2), rect.y + (rect.height / 2)), label, PRINT_COLOR, font_scaling, 1);
-                        g_free(label);
-                    }
-
-                    // Send downstream event and bus message with the rect info
-                    structure = gst_structure_new("object-interaction",
-                                                  "id_a",       G_TYPE_UINT,   obj_a.id,
-                                                  "id_b",       G_TYPE_UINT,   obj_b.id,
-                                                  "percentage", G_TYPE_UINT,   interception,
-                                                  "x",          G_TYPE_UINT,   rect.x,
-                                                  "y",          G_TYPE_UINT,   rect.y,
-                                                  "width",      G_TYPE_UINT,   rect.width,
-                                                  "height",     G_TYPE_UINT,   rect.height,
-                                                  "timestamp",  G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
-                                                  NULL);
-                    message = gst_message_new_element(GST_OBJECT(filter), gst_structure_copy(structure));
-                    gst_element_post_message(GST_ELEMENT(filter), message);
-                    event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
-                    gst_pad_push_event(filter->srcpad, event);
-
+        // Find interceptions rects pairs; only the rects that touch or
+        // overlap are compared
+        GArray *pairs;
+        CvRect *rects;
+        guint   i, k;
+
+        rects = g_new(CvRect, filter->object_in_array->len);
+        for (i = 0; i < filter->object_in_array->len; ++i)
+            rects[i] = g_array_index(filter->object_in_array, InstanceObjectIn, i).rect;
+        pairs = g_array_new(FALSE, FALSE, sizeof(SpatialPair));
+        spatial_index_find_pairs(rects, filter->object_in_array->len, 0, pairs);
+
+        for (k = 0; k < pairs->len; ++k) {
+            InstanceObjectIn obj_a, obj_b;
+            gint             interception;
+
+            obj_a = g_array_index(filter->object_in_array, InstanceObjectIn, g_array_index(pairs, SpatialPair, k).a);
+            obj_b = g_array_index(filter->object_in_array, InstanceObjectIn, g_array_index(pairs, SpatialPair, k).b);
+            interception = 100 * MIN(rectIntercept(&obj_a.rect, &obj_b.rect), rectIntercept(&obj_b.rect, &obj_a.rect));
+
+            if (interception) {
+                GstEvent     *event;
+                GstMessage   *message;
+                GstStructure *structure;
+                CvRect        rect;
+
+                // Interception percentage
+                rect = rectIntersection(&obj_a.rect, &obj_b.rect);
+
+                if (filter->verbose)
+                    GST_INFO_OBJECT(filter, "INTERCEPTION %i%%: rect_a(%i, %i, %i, %i), rect_b(%i, %i, %i, %i), rect_intercept(%i, %i, %i, %i)\n",
+                                    interception,
+                                    obj_a.rect.x, obj_a.rect.y, obj_a.rect.width, obj_a.rect.height,
+                                    obj_b.rect.x, obj_b.rect.y, obj_b.rect.width, obj_b.rect.height,
+                                    rect.x, rect.y, rect.width, rect.height);
+
+                // Draw intercept rect and label
+                if (filter->display) {
+                    char *label;
+                    float font_scaling;
+
+                    cvRectangle(filter->image,
+                                cvPoint(rect.x, rect.y),
+                                cvPoint(rect.x + rect.width, rect.y + rect.height),
+                                PRINT_COLOR, -1, 8, 0);
+                    font_scaling = ((filter->image->width * filter->image->height) > (320 * 240)) ? 0.5f : 0.3f;
+                    label = g_strdup_printf("%i+%i (%i%%)", obj_a.id, obj_b.id, interception);
+                    printText(filter->image, cvPoint(rect.x + (rect.width / 2), rect.y + (rect.height / 2)), label, PRINT_COLOR, font_scaling, 1);
+                    g_free(label);
                 }
+
+                // Send downstream event and bus message with the rect info
+                structure = gst_structure_new("object-interaction",
+                                              "id_a",       G_TYPE_UINT,   obj_a.id,
+                                              "id_b",       G_TYPE_UINT,   obj_b.id,
+                                              "percentage", G_TYPE_UINT,   interception,
+                                              "x",          G_TYPE_UINT,   rect.x,
+                                              "y",          G_TYPE_UINT,   rect.y,
+                                              "width",      G_TYPE_UINT,   rect.width,
+                                              "height",     G_TYPE_UINT,   rect.height,
+                                              "timestamp",  G_TYPE_UINT64, GST_BUFFER_TIMESTAMP(buf),
+                                              NULL);
+                message = gst_message_new_element(GST_OBJECT(filter), gst_structure_copy(structure));
+                gst_element_post_message(GST_ELEMENT(filter), message);
+                event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+                gst_pad_push_event(filter->srcpad, event);
+
             }
         }
 
+        g_array_free(pairs, TRUE);
+        g_free(rects);
     }
 
     // Clean objects
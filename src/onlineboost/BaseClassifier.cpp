@@ -1,8 +1,33 @@
 #include "BaseClassifier.h"
+#include "Parallel.h"
 #include <iostream>
 
-BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, Size patchSize)
+// weak classifiers are handed out to the threads in chunks of this size
+#define BASE_CLASSIFIER_CHUNK_SIZE 32
+
+struct TrainWork
+{
+	WeakClassifier** weakClassifier;
+	ImageRepresentation* image;
+	Rect ROI;
+	int target;
+	int K;
+	bool* errorMask;
+};
+
+static void trainWeakClassifiers(void* data, int begin, int end)
 {
+	TrainWork* work = (TrainWork*)data;
+
+	// each weak classifier only updates its own feature and distributions
+	for (int curWeakClassifier = begin; curWeakClassifier < end; curWeakClassifier++)
+		for (int curK = 0; curK <= work->K; curK++)
+			work->errorMask[curWeakClassifier] = work->weakClassifier[curWeakClassifier]->update (work->image, work->ROI, work->target);
+}
+
+BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, Size patchSize, Random* random)
+{
+	m_random = random;
 	this->m_numWeakClassifier = numWeakClassifier;
 	this->m_iterationInit = iterationInit;
 
@@ -13,6 +38,7 @@ BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, Size pa
 
 	m_referenceWeakClassifier = false;
 	m_selectedClassifier = 0;
+	m_parallel = NULL;
 
 	m_wCorrect = new float[numWeakClassifier+iterationInit];
 	memset (m_wCorrect, 0, sizeof(float)*numWeakClassifier+iterationInit);
@@ -24,14 +50,16 @@ BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, Size pa
 		m_wWrong[curWeakClassifier] = m_wCorrect[curWeakClassifier] = 1;
 }
 
-BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, WeakClassifier** weakClassifier)
+BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, WeakClassifier** weakClassifier, Random* random)
 {
+	m_random = random;
 	this->m_numWeakClassifier = numWeakClassifier;
 	this->m_iterationInit = iterationInit;
 	this->weakClassifier = weakClassifier;
 	m_referenceWeakClassifier = true;
 	m_selectedClassifier = 0;
 	m_idxOfNewWeakClassifier = numWeakClassifier;
+	m_parallel = NULL;
 
 	m_wCorrect = new float[numWeakClassifier+iterationInit];
 	memset (m_wCorrect, 0, sizeof(float)*numWeakClassifier+iterationInit);
@@ -42,6 +70,73 @@ BaseClassifier::BaseClassifier(int numWeakClassifier, int iterationInit, WeakCla
 		m_wWrong[curWeakClassifier] = m_wCorrect[curWeakClassifier] = 1;
 }
 
+BaseClassifier::BaseClassifier(ModelReader* reader, WeakClassifier** weakClassifier, Random* random)
+{
+	m_random = random;
+	m_parallel = NULL;
+
+	this->m_numWeakClassifier = reader->readInt();
+	this->m_iterationInit = reader->readInt();
+	m_selectedClassifier = reader->readInt();
+	m_idxOfNewWeakClassifier = reader->readInt();
+	bool ownsWeakClassifier = (reader->readInt() != 0);
+
+	int numAllWeakClassifier = m_numWeakClassifier+m_iterationInit;
+	if (m_numWeakClassifier <= 0 || m_iterationInit < 0 || numAllWeakClassifier > 100000 ||
+		m_selectedClassifier < 0 || m_selectedClassifier >= numAllWeakClassifier ||
+		m_idxOfNewWeakClassifier < m_numWeakClassifier || m_idxOfNewWeakClassifier >= numAllWeakClassifier ||
+		(!ownsWeakClassifier && weakClassifier == NULL))
+	{
+		reader->invalidate();
+		this->m_numWeakClassifier = 1;
+		this->m_iterationInit = 0;
+		m_selectedClassifier = 0;
+		m_idxOfNewWeakClassifier = 0;
+		numAllWeakClassifier = 1;
+		ownsWeakClassifier = true;
+	}
+
+	m_wCorrect = new float[numAllWeakClassifier];
+	m_wWrong = new float[numAllWeakClassifier];
+	for (int curWeakClassifier = 0; curWeakClassifier < numAllWeakClassifier; curWeakClassifier++)
+	{
+		m_wCorrect[curWeakClassifier] = reader->readFloat();
+		m_wWrong[curWeakClassifier] = reader->readFloat();
+	}
+
+	m_referenceWeakClassifier = !ownsWeakClassifier;
+	if (ownsWeakClassifier)
+	{
+		this->weakClassifier = new WeakClassifier*[numAllWeakClassifier];
+		for (int curWeakClassifier = 0; curWeakClassifier < numAllWeakClassifier; curWeakClassifier++)
+			this->weakClassifier[curWeakClassifier] = new WeakClassifierHaarFeature(reader);
+	}
+	else
+		this->weakClassifier = weakClassifier;
+}
+
+void BaseClassifier::save(ModelWriter* writer)
+{
+	int numAllWeakClassifier = m_numWeakClassifier+m_iterationInit;
+
+	writer->writeInt(m_numWeakClassifier);
+	writer->writeInt(m_iterationInit);
+	writer->writeInt(m_selectedClassifier);
+	writer->writeInt(m_idxOfNewWeakClassifier);
+	writer->writeInt(m_referenceWeakClassifier ? 0 : 1);
+
+	for (int curWeakClassifier = 0; curWeakClassifier < numAllWeakClassifier; curWeakClassifier++)
+	{
+		writer->writeFloat(m_wCorrect[curWeakClassifier]);
+		writer->writeFloat(m_wWrong[curWeakClassifier]);
+	}
+
+	// the pool only ever holds Haar feature classifiers
+	if (!m_referenceWeakClassifier)
+		for (int curWeakClassifier = 0; curWeakClassifier < numAllWeakClassifier; curWeakClassifier++)
+			((WeakClassifierHaarFeature*)weakClassifier[curWeakClassifier])->save(writer);
+}
+
 BaseClassifier::~BaseClassifier()
 {
 	if (!m_referenceWeakClassifier)
@@ -60,7 +155,7 @@ void BaseClassifier::generateRandomClassifier (Size patchSize)
 {
 	for (int curWeakClassifier = 0; curWeakClassifier< m_numWeakClassifier+m_iterationInit; curWeakClassifier++)
 	{
-		weakClassifier[curWeakClassifier] = new WeakClassifierHaarFeature(patchSize);
+		weakClassifier[curWeakClassifier] = new WeakClassifierHaarFeature(patchSize, m_random);
 	}
 }
 
@@ -84,17 +179,25 @@ void BaseClassifier::trainClassifier(ImageRepresentation* image, Rect ROI, int t
 	int K_max = 10;
 	while (1)
 	{
-		double U_k = (double)rand()/RAND_MAX;
+		double U_k = m_random->nextDouble();
 		A*=U_k;
 		if (K > K_max || A<exp(-importance))
 			break;
 		K++;
 	}
 
-	for (int curK = 0; curK <= K; curK++)
-		for (int curWeakClassifier = 0; curWeakClassifier < m_numWeakClassifier+m_iterationInit; curWeakClassifier++)
-			errorMask[curWeakClassifier] = weakClassifier[curWeakClassifier]->update (image, ROI, target); 
+	TrainWork work;
+	work.weakClassifier = weakClassifier;
+	work.image = image;
+	work.ROI = ROI;
+	work.target = target;
+	work.K = K;
+	work.errorMask = errorMask;
 
+	if (m_parallel != NULL)
+		m_parallel->run(m_numWeakClassifier+m_iterationInit, BASE_CLASSIFIER_CHUNK_SIZE, trainWeakClassifiers, &work);
+	else
+		trainWeakClassifiers(&work, 0, m_numWeakClassifier+m_iterationInit);
 }
 
 void BaseClassifier::getErrorMask(ImageRepresentation* image, Rect ROI, int target, bool* errorMask) 
@@ -203,7 +306,7 @@ int BaseClassifier::replaceWeakestClassifier(float* errors, Size patchSize)
 		m_wCorrect[index] = m_wCorrect[m_idxOfNewWeakClassifier];
 		m_wCorrect[m_idxOfNewWeakClassifier] = 1;
 
-		weakClassifier[m_idxOfNewWeakClassifier] = new WeakClassifierHaarFeature (patchSize);
+		weakClassifier[m_idxOfNewWeakClassifier] = new WeakClassifierHaarFeature (patchSize, m_random);
 	
 		return index;
 	}
@@ -11,6 +11,8 @@
 #include "WeakClassifier.h"
 #include "WeakClassifierHaarFeature.h"
 #include "ImageRepresentation.h"
+#include "Random.h"
+#include "Parallel.h"
 
 
 using namespace std;
@@ -19,8 +21,12 @@ class BaseClassifier
 {
 public:
 	
-	BaseClassifier(int numWeakClassifier, int iterationInit, Size patchSize); 
-	BaseClassifier(int numWeakClassifier, int iterationInit, WeakClassifier** weakClassifier); 
+	BaseClassifier(int numWeakClassifier, int iterationInit, Size patchSize, Random* random); 
+	BaseClassifier(int numWeakClassifier, int iterationInit, WeakClassifier** weakClassifier, Random* random); 
+	// reads a base classifier written by save(); it reads its own weak
+	// classifiers if it owned them when saved, otherwise it refers to
+	// weakClassifier, the pool of the base classifier read before
+	BaseClassifier(ModelReader* reader, WeakClassifier** weakClassifier, Random* random);
 
 	virtual ~BaseClassifier();
 
@@ -35,6 +41,8 @@ public:
 
 	void replaceClassifierStatistic(int sourceIndex, int targetIndex);
 
+	void save(ModelWriter* writer);
+
  	int eval(ImageRepresentation* image, Rect ROI); 
 	
 	float getValue(ImageRepresentation *image, Rect ROI, int weakClassifierIdx = -1);
@@ -51,7 +59,12 @@ public:
 
 	int getTypeOfSelectedClassifier(){return weakClassifier[m_selectedClassifier]->getType();};
 	int getIdxOfSelectedClassifier(){return m_selectedClassifier;};
+	WeakClassifier* getSelectedClassifier(){return weakClassifier[m_selectedClassifier];};
 	int getIdxOfNewWeakClassifier(){return m_idxOfNewWeakClassifier;};
+
+	// threads the weak classifiers are trained with, owned by the strong
+	// classifier; without one (the default) they are trained serially
+	void setParallelPool(ParallelPool* parallel){m_parallel = parallel;};
 	
 protected:
 
@@ -63,6 +76,8 @@ protected:
 	float* m_wCorrect;
 	float* m_wWrong;
 	int m_iterationInit;
+	ParallelPool* m_parallel;
+	Random* m_random;  // generator of the owning strong classifier
 	void generateRandomClassifier (Size patchSize);
 
 };
@@ -1,6 +1,94 @@
 #include <opencv/cxcore.h>
 #include "Classifier.h"
 
+// leading words of a model file
+#define CLASSIFIER_MODEL_MAGIC   0x4d43424f  // "OBCM"
+#define CLASSIFIER_MODEL_VERSION 1
+
+// updates run on a new patch, from scratch or from a model
+#define INIT_ITERATIONS       50
+#define WARM_START_ITERATIONS 5
+
+ClassifierModel::ClassifierModel(void) {}
+
+ClassifierModel::~ClassifierModel(void) {}
+
+bool ClassifierModel::load(const char *filename) {
+
+    data.clear();
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return false;
+
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof (buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + length);
+    fclose(file);
+
+    // a trial read checks the whole file once, so that createClassifier()
+    // cannot fail later on
+    StrongClassifier *classifier = createClassifier();
+    if (classifier == NULL) {
+        data.clear();
+        return false;
+    }
+    delete classifier;
+    return true;
+}
+
+StrongClassifier* ClassifierModel::createClassifier() {
+
+    ModelReader reader(data.empty() ? NULL : &data[0], (int) data.size());
+    if (reader.readInt() != CLASSIFIER_MODEL_MAGIC || reader.readInt() != CLASSIFIER_MODEL_VERSION)
+        return NULL;
+
+    StrongClassifier *classifier = new StrongClassifierDirectSelection(&reader);
+    if (!reader.isValid()) {
+        delete classifier;
+        return NULL;
+    }
+    return classifier;
+}
+
+ClassifierFrame::ClassifierFrame(void) {
+    gray = NULL;
+    dataCh = NULL;
+    representation = NULL;
+}
+
+ClassifierFrame::~ClassifierFrame(void) {
+    if (gray != NULL) cvReleaseImage(&gray);
+    delete[] dataCh;
+    delete representation;
+}
+
+void ClassifierFrame::update(IplImage *image) {
+
+    // the buffers are only reallocated when the frame size changes
+    if (gray == NULL || gray->width != image->width || gray->height != image->height) {
+        if (gray != NULL) cvReleaseImage(&gray);
+        delete[] dataCh;
+        delete representation;
+
+        size.height = image->height;
+        size.width = image->width;
+        gray = cvCreateImage(cvGetSize(image), 8, 1);
+        dataCh = new unsigned char[size.height * size.width];
+        representation = new ImageRepresentation(NULL, size);
+    }
+
+    cvCvtColor(image, gray, CV_RGB2GRAY);
+
+    unsigned char *buffer = reinterpret_cast<unsigned char*> (gray->imageData);
+    for (int i = 0; i < size.height; i++) {
+        memcpy(dataCh + i*size.width, buffer + i*gray->widthStep, sizeof (unsigned char) * size.width);
+    }
+
+    representation->setNewImage(dataCh);
+}
+
 Classifier::Classifier(void) {}
 
 Classifier::Classifier(IplImage *image, Rect trackedPatch){
@@ -56,36 +144,55 @@ void Classifier::update_dataCh(IplImage *m_grayImage, unsigned char **dataCh) {
 
 void Classifier::init(IplImage *image, Rect trackedPatch) {
 
-    update_dataCh(image, &this->dataCh);
+    ClassifierFrame frame;
+
+    frame.update(image);
+    init(&frame, trackedPatch);
+}
+
+void Classifier::init(ClassifierFrame *frame, Rect trackedPatch, __uint32 seed, int numThreads) {
 
     numBaseClassifier = 100;
+    int numWeakClassifier = numBaseClassifier * 10;
+    bool useFeatureExchange = true;
+    int iterationInit = 50;
+    Size patchSize;
+    patchSize = trackedPatch;
+
+    classifier = new StrongClassifierDirectSelection(numBaseClassifier, numWeakClassifier, patchSize, useFeatureExchange, iterationInit, seed);
+    classifier->setNumThreads(numThreads);
+    initTraining(frame, trackedPatch, INIT_ITERATIONS);
+}
+
+void Classifier::init(ClassifierFrame *frame, Rect trackedPatch, ClassifierModel *model, __uint32 seed, int numThreads) {
+
+    classifier = model->createClassifier();
+    classifier->setSeed(seed);
+    classifier->setNumThreads(numThreads);
+    numBaseClassifier = classifier->getNumBaseClassifier();
+    initTraining(frame, trackedPatch, WARM_START_ITERATIONS);
+}
+
+void Classifier::initTraining(ClassifierFrame *frame, Rect trackedPatch, int iterations) {
+
     searchFactor = 2;
     overlap = 0.99;
 
     Size imageSize2;
-    imageSize2.height = image->height;
-    imageSize2.width = image->width;
+    imageSize2 = frame->getSize();
     this->validROI = imageSize2;
 
-    this->curFrameRep = new ImageRepresentation(this->dataCh, imageSize2);
+    this->curFrameRep = new ImageRepresentation(frame->getData(), imageSize2);
 
-    int numWeakClassifier = numBaseClassifier * 10;
-    bool useFeatureExchange = true;
-    int iterationInit = 50;
-    Size patchSize;
-    patchSize = trackedPatch;
     init_trackingRect = trackedPatch;
     trackingRectSize = init_trackingRect;
 
-    classifier = new StrongClassifierDirectSelection(numBaseClassifier, numWeakClassifier, patchSize, useFeatureExchange, iterationInit);
-
     Rect trackingROI = getTrackingROI(searchFactor, trackedPatch);
     Size trackedPatchSize;
     trackedPatchSize = trackedPatch;
     Patches* trackingPatches = new PatchesRegularScan(trackingROI, this->validROI, trackedPatchSize, 0.99f);
 
-    iterationInit = 50;
-    for (int curInitStep = 0; curInitStep < iterationInit; curInitStep++) {
+    for (int curInitStep = 0; curInitStep < iterations; curInitStep++) {
         classifier->update(this->curFrameRep, trackingPatches->getSpecialRect("UpperLeft"), -1);
         classifier->update(this->curFrameRep, trackedPatch, 1);
         classifier->update(this->curFrameRep, trackingPatches->getSpecialRect("UpperRight"), -1);
@@ -101,36 +208,44 @@ void Classifier::init(IplImage *image, Rect trackedPatch) {
 
 float Classifier::classify(IplImage *image, Rect trackedPatch) {
 
-    ImageRepresentation* rep;
-    unsigned char *dataCh;
-    float eval;
-    Size imageSize2;
+    ClassifierFrame frame;
 
-    imageSize2.height = image->height;
-    imageSize2.width = image->width;
+    frame.update(image);
+    return classify(&frame, trackedPatch);
+}
 
-    update_dataCh(image, &dataCh);
-    rep = new ImageRepresentation(dataCh, imageSize2);
-    eval = classifier->eval(rep, trackedPatch);
+float Classifier::classify(ClassifierFrame *frame, Rect trackedPatch) {
 
-    delete rep;
-    delete dataCh;
-    return eval;
+    // the frame representation covers the whole frame, so that it can be
+    // shared by any number of patches
+    return classifier->eval(frame->getRepresentation(), trackedPatch);
+}
+
+void Classifier::classify(ClassifierFrame *frame, const Rect *trackedPatches, int numPatches, float *confidences) {
+
+    classifier->evalBatch(frame->getRepresentation(), trackedPatches, numPatches, confidences);
 }
 
 bool Classifier::train(IplImage *image, Rect trackedPatch) {
 
+    ClassifierFrame frame;
+
+    frame.update(image);
+    return train(&frame, trackedPatch);
+}
+
+bool Classifier::train(ClassifierFrame *frame, Rect trackedPatch) {
+
     Patches *trackingPatches;
     Rect searchRegion;
 
-    update_dataCh(image, &this->dataCh);
     searchRegion = this->getTrackingROI(searchFactor, trackedPatch);
 
     if(searchRegion.height < trackingRectSize.height || searchRegion.width < trackingRectSize.width)
         return false;
 
     trackingPatches = new PatchesRegularScan(searchRegion, this->validROI, trackingRectSize, overlap);
-    this->curFrameRep->setNewImageAndROI(this->dataCh, searchRegion);
+    this->curFrameRep->setNewImageAndROI(frame->getData(), searchRegion);
 
     classifier->update(this->curFrameRep, trackingPatches->getSpecialRect("UpperLeft"), -1);
     classifier->update(this->curFrameRep, trackedPatch, 1);
@@ -145,6 +260,19 @@ bool Classifier::train(IplImage *image, Rect trackedPatch) {
     return true;
 }
 
+bool Classifier::save(const char *filename) {
+
+    ModelWriter writer;
+    writer.writeInt(CLASSIFIER_MODEL_MAGIC);
+    writer.writeInt(CLASSIFIER_MODEL_VERSION);
+    classifier->save(&writer);
+    return writer.saveToFile(filename);
+}
+
+void Classifier::setNumThreads(int numThreads) {
+    classifier->setNumThreads(numThreads);
+}
+
 Rect Classifier::convert_cvrect_to_rect(CvRect rect){
     Rect trackedPatch;
     trackedPatch.upper = rect.y;
@@ -175,6 +303,94 @@ float classifier_intermediate_classify(CClassifier* cls, IplImage *image, CvRect
     return ((Classifier*) cls->cplusplus_classifier)->classify(image, rrect);
 }
 
+extern "C"
+CClassifierFrame* classifier_intermediate_frame_new(void) {
+    CClassifierFrame* frame = (CClassifierFrame*) cvAlloc(sizeof(CClassifierFrame));
+    frame->cplusplus_frame = new ClassifierFrame();
+    return frame;
+}
+
+extern "C"
+void classifier_intermediate_frame_release(CClassifierFrame* frame) {
+    if (frame == NULL) return;
+    delete (ClassifierFrame*) frame->cplusplus_frame;
+    cvFree(&frame);
+}
+
+extern "C"
+void classifier_intermediate_frame_update(CClassifierFrame* frame, IplImage *image) {
+    ((ClassifierFrame*) frame->cplusplus_frame)->update(image);
+}
+
+extern "C"
+CClassifier* classifier_intermediate_init_frame(CClassifierFrame* frame, CvRect rect, unsigned int seed, int n_threads) {
+    CClassifier* cls = (CClassifier*) cvAlloc(sizeof(CClassifier));
+    cls->cplusplus_classifier = new Classifier();
+    Rect rrect = ((Classifier*) cls->cplusplus_classifier)->convert_cvrect_to_rect(rect);
+    ((Classifier*) cls->cplusplus_classifier)->init((ClassifierFrame*) frame->cplusplus_frame, rrect, seed, n_threads);
+    return cls;
+}
+
+extern "C"
+int classifier_intermediate_train_frame(CClassifier* cls, CClassifierFrame* frame, CvRect rect) {
+    Rect rrect = ((Classifier*) cls->cplusplus_classifier)->convert_cvrect_to_rect(rect);
+    return (((Classifier*) cls->cplusplus_classifier)->train((ClassifierFrame*) frame->cplusplus_frame, rrect))?1:0;
+}
+
+extern "C"
+float classifier_intermediate_classify_frame(CClassifier* cls, CClassifierFrame* frame, CvRect rect) {
+    Rect rrect = ((Classifier*) cls->cplusplus_classifier)->convert_cvrect_to_rect(rect);
+    return ((Classifier*) cls->cplusplus_classifier)->classify((ClassifierFrame*) frame->cplusplus_frame, rrect);
+}
+
+extern "C"
+void classifier_intermediate_classify_frame_batch(CClassifier* cls, CClassifierFrame* frame, const CvRect *rects, int n_rects, float *confidences) {
+    Classifier *classifier = (Classifier*) cls->cplusplus_classifier;
+    Rect *rrects = new Rect[n_rects];
+    for (int i = 0; i < n_rects; i++)
+        rrects[i] = classifier->convert_cvrect_to_rect(rects[i]);
+    classifier->classify((ClassifierFrame*) frame->cplusplus_frame, rrects, n_rects, confidences);
+    delete[] rrects;
+}
+
+extern "C"
+int classifier_intermediate_save(CClassifier* cls, const char *filename) {
+    return (((Classifier*) cls->cplusplus_classifier)->save(filename))?1:0;
+}
+
+extern "C"
+CClassifierModel* classifier_intermediate_model_load(const char *filename) {
+    ClassifierModel *model = new ClassifierModel();
+    if (!model->load(filename)) {
+        delete model;
+        return NULL;
+    }
+    CClassifierModel* cmodel = (CClassifierModel*) cvAlloc(sizeof(CClassifierModel));
+    cmodel->cplusplus_model = model;
+    return cmodel;
+}
+
+extern "C"
+void classifier_intermediate_model_release(CClassifierModel* model) {
+    if (model == NULL) return;
+    delete (ClassifierModel*) model->cplusplus_model;
+    cvFree(&model);
+}
+
+extern "C"
+CClassifier* classifier_intermediate_init_frame_model(CClassifierFrame* frame, CvRect rect, CClassifierModel* model, unsigned int seed, int n_threads) {
+    CClassifier* cls = (CClassifier*) cvAlloc(sizeof(CClassifier));
+    cls->cplusplus_classifier = new Classifier();
+    Rect rrect = ((Classifier*) cls->cplusplus_classifier)->convert_cvrect_to_rect(rect);
+    ((Classifier*) cls->cplusplus_classifier)->init((ClassifierFrame*) frame->cplusplus_frame, rrect, (ClassifierModel*) model->cplusplus_model, seed, n_threads);
+    return cls;
+}
+
+extern "C"
+void classifier_intermediate_set_num_threads(CClassifier* cls, int n_threads) {
+    ((Classifier*) cls->cplusplus_classifier)->setNumThreads(n_threads);
+}
+
 extern "C"
 void classifier_intermediate_release(CClassifier* cls) {
     if (cls == NULL) return;
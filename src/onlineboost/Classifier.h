@@ -3,11 +3,53 @@
 
 #ifdef __cplusplus
 
+#include <vector>
+
 #include "ImageRepresentation.h"
+#include "ModelStream.h"
 #include "Patches.h"
 #include "StrongClassifier.h"
 #include "StrongClassifierDirectSelection.h"
 
+// gray version of a frame and its integral images; built once per frame and
+// shared by all the classifiers that are trained or evaluated on it
+class ClassifierFrame {
+public:
+
+    ClassifierFrame();
+    virtual ~ClassifierFrame();
+
+    void update(IplImage *image);
+
+    unsigned char* getData() { return dataCh; };
+    Size getSize() { return size; };
+    ImageRepresentation* getRepresentation() { return representation; };
+
+private:
+
+    IplImage *gray;
+    unsigned char *dataCh;
+    Size size;
+    ImageRepresentation* representation;
+};
+
+// a classifier trained beforehand, e.g. a generic person model; the file is
+// read and checked once, then kept in its serialised form and shared
+// read-only by the trackers, each of which reads its own copy to adapt
+class ClassifierModel {
+public:
+
+    ClassifierModel();
+    virtual ~ClassifierModel();
+
+    bool load(const char *filename);
+    StrongClassifier* createClassifier();
+
+private:
+
+    std::vector<char> data;
+};
+
 class Classifier {
 public:
 
@@ -19,19 +61,32 @@ public:
     bool train(IplImage *image, Rect trackedPatch);
     float classify(IplImage *image, Rect trackedPatch);
 
+    // 'numThreads' applies from the initial training on, see setNumThreads
+    void init(ClassifierFrame *frame, Rect trackedPatch, __uint32 seed = 0, int numThreads = 1);
+    // starts from the model and adapts it to the patch with a few updates
+    // only; 'seed' is reapplied so that trackers sharing the model diverge
+    void init(ClassifierFrame *frame, Rect trackedPatch, ClassifierModel *model, __uint32 seed = 0, int numThreads = 1);
+    bool train(ClassifierFrame *frame, Rect trackedPatch);
+    float classify(ClassifierFrame *frame, Rect trackedPatch);
+    void classify(ClassifierFrame *frame, const Rect *trackedPatches, int numPatches, float *confidences);
+
     Rect getTrackingROI(float searchFactor, Rect trackedPatch);
     float getConfidence();
     void update_dataCh(IplImage *m_grayImage, unsigned char **dataCh);
     float getSumAlphaClassifier();
     StrongClassifier* getClassifier();
     Rect convert_cvrect_to_rect(CvRect rect);
+    bool save(const char *filename);
+    // threads the weak classifiers are trained with, see StrongClassifier
+    void setNumThreads(int numThreads);
 
 private:
 
+    void initTraining(ClassifierFrame *frame, Rect trackedPatch, int iterations);
+
     StrongClassifier* classifier;
     ImageRepresentation* curFrameRep;
     Rect init_trackingRect;
-    unsigned char *dataCh;
     Rect validROI;
     int numBaseClassifier;
     float searchFactor;
@@ -54,11 +109,48 @@ extern "C" {
     };
     typedef struct _CClassifier CClassifier;
 
+    struct _CClassifierFrame {
+        void* cplusplus_frame;
+    };
+    typedef struct _CClassifierFrame CClassifierFrame;
+
+    struct _CClassifierModel {
+        void* cplusplus_model;
+    };
+    typedef struct _CClassifierModel CClassifierModel;
+
     CVAPI(CClassifier*) classifier_intermediate_init(IplImage *image, CvRect rect);
     void classifier_intermediate_release(CClassifier* cls);
     int classifier_intermediate_train(CClassifier* cls, IplImage *image, CvRect rect);
     float classifier_intermediate_classify(CClassifier* cls, IplImage *image, CvRect rect);
 
+    // the '_frame' variants work on a frame prepared beforehand, so that
+    // the gray conversion and the integral images are computed only once
+    // per frame, whatever the number of classifiers and patches
+    CVAPI(CClassifierFrame*) classifier_intermediate_frame_new(void);
+    void classifier_intermediate_frame_release(CClassifierFrame* frame);
+    void classifier_intermediate_frame_update(CClassifierFrame* frame, IplImage *image);
+    // 'seed' determines the random features and samples of the classifier
+    // 'n_threads' as in classifier_intermediate_set_num_threads(), from the
+    // initial training on
+    CVAPI(CClassifier*) classifier_intermediate_init_frame(CClassifierFrame* frame, CvRect rect, unsigned int seed, int n_threads);
+    int classifier_intermediate_train_frame(CClassifier* cls, CClassifierFrame* frame, CvRect rect);
+    float classifier_intermediate_classify_frame(CClassifier* cls, CClassifierFrame* frame, CvRect rect);
+    // confidences of 'n_rects' patches at once; patches of equal size are
+    // evaluated together on the flattened classifier
+    void classifier_intermediate_classify_frame_batch(CClassifier* cls, CClassifierFrame* frame, const CvRect *rects, int n_rects, float *confidences);
+
+    // models written by classifier_intermediate_save() serve to warm-start
+    // new classifiers; loading returns NULL if the file is missing or invalid
+    int classifier_intermediate_save(CClassifier* cls, const char *filename);
+    CVAPI(CClassifierModel*) classifier_intermediate_model_load(const char *filename);
+    void classifier_intermediate_model_release(CClassifierModel* model);
+    CVAPI(CClassifier*) classifier_intermediate_init_frame_model(CClassifierFrame* frame, CvRect rect, CClassifierModel* model, unsigned int seed, int n_threads);
+
+    // 0 trains on one thread per processor, 1 serially; the latter suits
+    // classifiers that are already updated from several threads at once
+    void classifier_intermediate_set_num_threads(CClassifier* cls, int n_threads);
+
 #ifdef __cplusplus
 
 }
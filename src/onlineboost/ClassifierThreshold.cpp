@@ -8,6 +8,22 @@ ClassifierThreshold::ClassifierThreshold()
 	m_parity = 0;
 }
 
+ClassifierThreshold::ClassifierThreshold(ModelReader* reader)
+{
+	m_posSamples = new EstimatedGaussDistribution(reader);
+	m_negSamples = new EstimatedGaussDistribution(reader);
+	m_threshold = reader->readFloat();
+	m_parity = reader->readInt();
+}
+
+void ClassifierThreshold::save(ModelWriter* writer)
+{
+	m_posSamples->save(writer);
+	m_negSamples->save(writer);
+	writer->writeFloat(m_threshold);
+	writer->writeInt(m_parity);
+}
+
 ClassifierThreshold::~ClassifierThreshold()
 {
 	if (m_posSamples!=NULL) delete m_posSamples;
@@ -10,6 +10,7 @@ class ClassifierThreshold
 public:
 
 	ClassifierThreshold();
+	ClassifierThreshold(ModelReader* reader);
 	virtual ~ClassifierThreshold();
 
 	void update(float value, int target);
@@ -17,6 +18,11 @@ public:
 
 	void* getDistribution(int target);
 
+	void save(ModelWriter* writer);
+
+	float getThreshold(){return m_threshold;};
+	int getParity(){return m_parity;};
+
 private:
 
 	EstimatedGaussDistribution* m_posSamples;
@@ -1,5 +1,24 @@
 #include "Detector.h"
 
+#include "Parallel.h"
+
+// patches are handed out to the threads in chunks of this size
+#define DETECTOR_CHUNK_SIZE 64
+
+struct DetectorWork
+{
+	StrongClassifier* classifier;
+	ImageRepresentation* image;
+	const Rect* patches;
+	float* confidences;
+};
+
+static void detectorEvalChunk(void* data, int begin, int end)
+{
+	DetectorWork* work = (DetectorWork*)data;
+	work->classifier->evalBatch(work->image, work->patches+begin, end-begin, work->confidences+begin);
+}
+
 Detector::Detector(StrongClassifier* classifier)
 {
 	this->m_classifier = classifier;
@@ -9,11 +28,11 @@ Detector::Detector(StrongClassifier* classifier)
 	m_maxConfidence = -FLT_MAX;
 	m_numDetections = 0;
 	m_idxDetections = NULL;
+	m_sizeDetections = 0;
 	m_idxBestDetection = -1;
 
   m_confMatrix = cvCreateMat(1,1,CV_32FC1);
 	m_confMatrixSmooth = cvCreateMat(1,1,CV_32FC1);
-
 }
 
 Detector::~Detector()
@@ -51,6 +70,37 @@ void Detector::prepareDetectionsMemory(int numDetections)
     m_idxDetections = new int[numDetections];
 }
 
+void Detector::evalPatches(ImageRepresentation* image, Patches* patches)
+{
+	int numPatches = patches->getNum();
+	const Rect* rects = patches->getRects();
+
+	DetectorWork work;
+	work.classifier = m_classifier;
+	work.image = image;
+	work.patches = rects;
+	work.confidences = m_confidences;
+
+	// the threads only share the classifier if its flattened form covers
+	// all the patches, i.e. they are all of the same size; every patch has
+	// its own slot, so the result does not depend on the scheduling
+	bool concurrent = m_parallel.numThreadsFor(numPatches, DETECTOR_CHUNK_SIZE) > 1 &&
+		!image->getUseVariance();
+	for (int curPatch = 1; concurrent && curPatch < numPatches; curPatch++)
+		concurrent = rects[curPatch].width == rects[0].width && rects[curPatch].height == rects[0].height;
+	if (concurrent)
+	{
+		Size patchSize;
+		patchSize = rects[0];
+		concurrent = m_classifier->compile(patchSize);
+	}
+
+	if (concurrent)
+		m_parallel.run(numPatches, DETECTOR_CHUNK_SIZE, detectorEvalChunk, &work);
+	else
+		m_classifier->evalBatch(image, rects, numPatches, m_confidences);
+}
+
 
 void Detector::classify(ImageRepresentation* image, Patches* patches, float minMargin)
 {
@@ -63,10 +113,10 @@ void Detector::classify(ImageRepresentation* image, Patches* patches, float minM
 	m_maxConfidence = -FLT_MAX;
 	int numBaseClassifiers = m_classifier->getNumBaseClassifier();
 
+	evalPatches(image, patches);
+
 	for (int curPatch=0; curPatch < numPatches; curPatch++)
 	{
-		m_confidences[curPatch] = m_classifier->eval(image, patches->getRect(curPatch));
-	
 		if (m_confidences[curPatch] > m_maxConfidence)
 		{
 			m_maxConfidence = m_confidences[curPatch];
@@ -109,11 +159,9 @@ void Detector::classifySmooth(ImageRepresentation* image, Patches* patches, floa
 	
 	int curPatch = 0;
 	// Eval and filter
+	evalPatches(image, patches);
 	for(int row = 0; row < patchGrid.height; row++) {
 		for( int col = 0; col < patchGrid.width; col++) {
-			int returnedInLayer;
-			m_confidences[curPatch] = m_classifier->eval(image, patches->getRect(curPatch)); 
-		
 			// fill matrix
 			cvmSet(m_confMatrix,row,col,m_confidences[curPatch]);
 			curPatch++;
@@ -7,6 +7,7 @@
 #include "StrongClassifier.h"
 #include "ImageRepresentation.h"
 #include "Patches.h"
+#include "Parallel.h"
 
 class Detector
 {
@@ -33,10 +34,16 @@ public:
 	int* getIdxDetections(){return m_idxDetections;};
 	float* getConfidences(){return m_confidences;};
 
+	// number of threads the patches are evaluated with, see ParallelPool;
+	// 1 (the default) evaluates them serially
+	void setNumThreads(int numThreads){m_parallel.setNumThreads(numThreads);};
+	int getNumThreads(){return m_parallel.getNumThreads();};
+
 private:
 
 	void prepareConfidencesMemory(int numPatches);
 	void prepareDetectionsMemory(int numDetections);
+	void evalPatches(ImageRepresentation* image, Patches* patches);
 
 	StrongClassifier* m_classifier;
 	float* m_confidences;
@@ -48,6 +55,7 @@ private:
 	float m_maxConfidence;
  	CvMat *m_confMatrix;
 	CvMat *m_confMatrixSmooth;
+	ParallelPool m_parallel;
 
 };
 
@@ -21,6 +21,25 @@ EstimatedGaussDistribution::EstimatedGaussDistribution(float P_mean, float R_mea
 	this->m_R_sigma = R_sigma;
 }
 
+EstimatedGaussDistribution::EstimatedGaussDistribution(ModelReader* reader)
+{
+	m_mean = reader->readFloat();
+	m_sigma = reader->readFloat();
+	m_P_mean = reader->readFloat();
+	m_R_mean = reader->readFloat();
+	m_P_sigma = reader->readFloat();
+	m_R_sigma = reader->readFloat();
+}
+
+void EstimatedGaussDistribution::save(ModelWriter* writer)
+{
+	writer->writeFloat(m_mean);
+	writer->writeFloat(m_sigma);
+	writer->writeFloat(m_P_mean);
+	writer->writeFloat(m_R_mean);
+	writer->writeFloat(m_P_sigma);
+	writer->writeFloat(m_R_sigma);
+}
 
 EstimatedGaussDistribution::~EstimatedGaussDistribution()
 {
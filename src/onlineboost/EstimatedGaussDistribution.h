@@ -7,6 +7,7 @@
 #include <math.h>
 
 #include "Regions.h"
+#include "ModelStream.h"
 
 using namespace std;
 
@@ -16,6 +17,7 @@ public:
 
 	EstimatedGaussDistribution();
 	EstimatedGaussDistribution(float P_mean, float R_mean, float P_sigma, float R_sigma);
+	EstimatedGaussDistribution(ModelReader* reader);
 	virtual ~EstimatedGaussDistribution();
 
 	void update(float value); //, float timeConstant = -1.0);
@@ -24,6 +26,8 @@ public:
 	float getSigma(){return m_sigma;};
 	void setValues(float mean, float sigma);
 
+	void save(ModelWriter* writer);
+
 private:
 
 	float m_mean;
@@ -4,11 +4,11 @@
 #define SQROOTHALF 0.7071
 #define INITSIGMA( numAreas ) ( static_cast<float>( sqrt( 256.0f*256.0f / 12.0f * (numAreas) ) ) );
 
-FeatureHaar::FeatureHaar(Size patchSize)
+FeatureHaar::FeatureHaar(Size patchSize, Random* random)
 : m_areas(NULL), m_weights(NULL), m_scaleAreas(NULL), m_scaleWeights(NULL)
 {
 	try {
-		generateRandomFeature(patchSize);
+		generateRandomFeature(patchSize, random);
 	}
 	catch (...) {
 		delete[] m_scaleWeights;
@@ -19,6 +19,78 @@ FeatureHaar::FeatureHaar(Size patchSize)
 	}
 }
 
+FeatureHaar::FeatureHaar(ModelReader* reader)
+: m_areas(NULL), m_weights(NULL), m_scaleAreas(NULL), m_scaleWeights(NULL)
+{
+	reader->readBytes(m_type, sizeof(m_type));
+	m_type[sizeof(m_type)-1] = '\0';
+
+	// features have 2 to 4 areas
+	m_numAreas = reader->readInt();
+	if (m_numAreas < 1 || m_numAreas > 4)
+	{
+		reader->invalidate();
+		m_numAreas = 1;
+	}
+
+	m_weights = new int[m_numAreas];
+	m_areas = new Rect[m_numAreas];
+	for (int curArea = 0; curArea < m_numAreas; curArea++)
+	{
+		m_weights[curArea] = reader->readInt();
+		m_areas[curArea].upper = reader->readInt();
+		m_areas[curArea].left = reader->readInt();
+		m_areas[curArea].height = reader->readInt();
+		m_areas[curArea].width = reader->readInt();
+	}
+	m_initMean = reader->readFloat();
+	m_initSigma = reader->readFloat();
+
+	Size patchSize;
+	patchSize.height = reader->readInt();
+	patchSize.width = reader->readInt();
+	if (patchSize.height <= 0 || patchSize.width <= 0)
+	{
+		reader->invalidate();
+		patchSize = Size(1,1);
+	}
+
+	// areas must lie within the patch
+	for (int curArea = 0; curArea < m_numAreas; curArea++)
+	{
+		Rect area = m_areas[curArea];
+		if (area.upper < 0 || area.left < 0 || area.height <= 0 || area.width <= 0 ||
+			area.upper+area.height > patchSize.height || area.left+area.width > patchSize.width)
+		{
+			reader->invalidate();
+			m_areas[curArea] = Rect(0, 0, 1, 1);
+		}
+	}
+
+	initScaling(patchSize);
+}
+
+void FeatureHaar::save(ModelWriter* writer)
+{
+	// padded with zeros, so that equal features give equal bytes
+	char type[sizeof(m_type)];
+	memset(type, 0, sizeof(type));
+	strncpy(type, m_type, sizeof(type)-1);
+	writer->writeBytes(type, sizeof(type));
+	writer->writeInt(m_numAreas);
+	for (int curArea = 0; curArea < m_numAreas; curArea++)
+	{
+		writer->writeInt(m_weights[curArea]);
+		writer->writeInt(m_areas[curArea].upper);
+		writer->writeInt(m_areas[curArea].left);
+		writer->writeInt(m_areas[curArea].height);
+		writer->writeInt(m_areas[curArea].width);
+	}
+	writer->writeFloat(m_initMean);
+	writer->writeFloat(m_initSigma);
+	writer->writeInt(m_initSize.height);
+	writer->writeInt(m_initSize.width);
+}
 
 FeatureHaar::~FeatureHaar()
 {
@@ -28,7 +100,7 @@ FeatureHaar::~FeatureHaar()
 	delete[] m_weights;
 }
 
-void FeatureHaar::generateRandomFeature(Size patchSize)
+void FeatureHaar::generateRandomFeature(Size patchSize, Random* random)
 {	
 	Point2D position;
 	Size baseDim;
@@ -42,16 +114,16 @@ void FeatureHaar::generateRandomFeature(Size patchSize)
 	while (!valid)
 	{
 		//chosse position and scale
-		position.row = rand()%(patchSize.height);
-		position.col = rand()%(patchSize.width);
+		position.row = random->nextInt(patchSize.height);
+		position.col = random->nextInt(patchSize.width);
 
-		baseDim.width = (int) ((1-sqrt(1-(float)rand()/RAND_MAX))*patchSize.width);
-		baseDim.height = (int) ((1-sqrt(1-(float)rand()/RAND_MAX))*patchSize.height);
+		baseDim.width = (int) ((1-sqrt(1-random->nextFloat()))*patchSize.width);
+		baseDim.height = (int) ((1-sqrt(1-random->nextFloat()))*patchSize.height);
 		
 		//select types
 		//float probType[11] = {0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0909f, 0.0950f};
 		float probType[11] = {0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
-		float prob = (float)rand()/RAND_MAX;
+		float prob = random->nextFloat();
 
 		if (prob < probType[0]) 
 		{
@@ -432,6 +504,11 @@ void FeatureHaar::generateRandomFeature(Size patchSize)
 			assert (false);	
 	}
 
+	initScaling(patchSize);
+}
+
+void FeatureHaar::initScaling(Size patchSize)
+{
 	m_initSize = patchSize;
 	m_curSize = m_initSize;
 	m_scaleFactorWidth = m_scaleFactorHeight = 1.0f;
@@ -510,6 +587,41 @@ bool FeatureHaar::eval(ImageRepresentation* image, Rect ROI, float* result)
 	return true;
 }
 
+bool FeatureHaar::getScaledAreas(Size patchSize, Rect* areas, float* weights)
+{
+	// define the minimum size
+	Size minSize = Size(3,3);
+
+	if (m_initSize == patchSize)
+	{
+		for (int curArea = 0; curArea<m_numAreas; curArea++) {
+			areas[curArea] = m_areas[curArea];
+			weights[curArea] = (float)m_weights[curArea] /
+				(float)((m_areas[curArea].width)*(m_areas[curArea].height));
+		}
+		return true;
+	}
+
+	float scaleFactorHeight = (float)patchSize.height/m_initSize.height;
+	float scaleFactorWidth = (float)patchSize.width/m_initSize.width;
+
+	for (int curArea = 0; curArea < m_numAreas; curArea++)
+	{
+		areas[curArea].height = floor((float)m_areas[curArea].height*scaleFactorHeight+0.5);
+		areas[curArea].width = floor((float)m_areas[curArea].width*scaleFactorWidth+0.5);
+
+		if (areas[curArea].height < minSize.height || areas[curArea].width < minSize.width)
+			return false;
+
+		areas[curArea].left = floor( (float)m_areas[curArea].left*scaleFactorWidth+0.5);
+		areas[curArea].upper = floor( (float)m_areas[curArea].upper*scaleFactorHeight+0.5);
+		weights[curArea] = (float)m_weights[curArea] /
+			(float)((areas[curArea].width)*(areas[curArea].height));
+	}
+
+	return true;
+}
+
 void FeatureHaar::getInitialDistribution(EstimatedGaussDistribution* distribution)
 {
 	distribution->setValues(m_initMean, m_initSigma);
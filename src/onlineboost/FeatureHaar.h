@@ -8,24 +8,31 @@
 
 #include "EstimatedGaussDistribution.h"
 #include "ImageRepresentation.h"
+#include "Random.h"
 
 class FeatureHaar
 {
 
 public:
 
-	FeatureHaar(Size patchSize);
+	FeatureHaar(Size patchSize, Random* random);
+	FeatureHaar(ModelReader* reader);
 	virtual ~FeatureHaar();
 
 	void getInitialDistribution(EstimatedGaussDistribution *distribution);
 
 	bool eval(ImageRepresentation* image, Rect ROI, float* result); 
+	// areas and weights eval() uses for patches of the given size, computed
+	// without touching the cached scaling state; false if not evaluable
+	bool getScaledAreas(Size patchSize, Rect* areas, float* weights);
 	
 	float getResponse(){return m_response;};
 
 	int getNumAreas(){return m_numAreas;};
 	int* getWeights(){return m_weights;};
 	Rect* getAreas(){return m_areas;};
+
+	void save(ModelWriter* writer);
 	
 private:
 
@@ -35,7 +42,8 @@ private:
 	float m_initMean;
 	float m_initSigma;
 
-	void generateRandomFeature(Size imageSize);
+	void generateRandomFeature(Size imageSize, Random* random);
+	void initScaling(Size patchSize);
 	Rect* m_areas;     // areas within the patch over which to compute the feature
 	Size m_initSize;   // size of the patch used during training
 	Size m_curSize;    // size of the patches currently under investigation
@@ -25,8 +25,8 @@ ImageRepresentation::ImageRepresentation(unsigned char* image, Size imageSize, R
 
 	intImage = NULL;
 	intSqImage = NULL;
-        intImage = new __uint32[(m_ROI.width+1)*(m_ROI.height+1)];
-        intSqImage = new __uint64[(m_ROI.width+1)*(m_ROI.height+1)];
+	m_capacity = 0;
+	allocateIntegrals();
 
 	if (image!= NULL)
 		this->createIntegralsOfROI(image);
@@ -47,10 +47,8 @@ void ImageRepresentation::defaultInit(unsigned char* image, Size imageSize)
 
 	intImage = NULL;
 	intSqImage = NULL;
-
-
-        intImage = new __uint32[(m_ROI.width+1)*(m_ROI.height+1)];
-        intSqImage = new __uint64[(m_ROI.width+1)*(m_ROI.height+1)];
+	m_capacity = 0;
+	allocateIntegrals();
 
 	if (image != NULL)
 		this->createIntegralsOfROI(image);
@@ -72,18 +70,38 @@ void ImageRepresentation::setNewImage(unsigned char* image)
 
 void ImageRepresentation::setNewROI(Rect ROI)
 {
-	if (this->m_ROI.height*this->m_ROI.width != ROI.height*ROI.width)
-	{	
-		delete[] intImage;
-		delete[] intSqImage;
-                intImage = new __uint32[(ROI.width+1)*(ROI.height+1)];
-                intSqImage = new __uint64[(ROI.width+1)*(ROI.height+1)];
-	}
 	this->m_ROI = ROI;
 	m_offset = ROI;
+	allocateIntegrals();
 	return;
 }
 
+void ImageRepresentation::setUseVariance(bool useVariance)
+{
+	this->m_useVariance = useVariance;
+	allocateIntegrals();
+}
+
+void ImageRepresentation::allocateIntegrals()
+{
+	// buffers only grow, so that a tracker moving its ROI around does not
+	// reallocate them every frame
+	unsigned long ROIlength = (m_ROI.width+1)*(m_ROI.height+1);
+	if (ROIlength > m_capacity)
+	{
+		delete[] intImage;
+		delete[] intSqImage;
+		intImage = new __uint32[ROIlength];
+		intSqImage = NULL;
+		m_capacity = ROIlength;
+	}
+
+	if (m_useVariance && intSqImage == NULL)
+		intSqImage = new __uint64[m_capacity];
+
+	m_sqValid = false;
+}
+
 void ImageRepresentation::setNewImageSize( Rect ROI )
 {
 	this->m_imageSize = ROI;
@@ -104,6 +122,8 @@ __uint32 ImageRepresentation::getValue(Point2D imagePosition)
 
 long ImageRepresentation::getSqSum(Rect imageROI)
 {
+	assert (m_sqValid);
+
 	// left upper Origin
 	int OriginX = imageROI.left-m_offset.col;
 	int OriginY = imageROI.upper-m_offset.row;
@@ -186,48 +206,60 @@ float ImageRepresentation::getMean(Rect imageROI)
 
 void ImageRepresentation::createIntegralsOfROI(unsigned char* image)
 {
-	unsigned long ROIlength = (m_ROI.width+1)*(m_ROI.height+1);
+	int step = m_ROI.width+1;
 	int columnidx, rowidx;
-	unsigned long curPointer;
-	unsigned long dptr;
-
-
-	curPointer = 0;
-	dptr = 0;
 
-	memset(intImage, 0x00, ROIlength * sizeof( unsigned int ) );
-	memset(intSqImage, 0x00, ROIlength * sizeof( unsigned int64_t) ); 
-
-	// current sum
-	unsigned int value_tmp = 0;
-	unsigned int value_tmpSq = 0;
+	// only the first row and column stay zero, the rest is overwritten
+	memset(intImage, 0x00, step * sizeof( __uint32 ) );
+	if (m_useVariance)
+		memset(intSqImage, 0x00, step * sizeof( __uint64 ) );
 
 	for (rowidx = 0; rowidx<m_ROI.height; rowidx++)
 	{
 		// current Image Position
-		curPointer = (rowidx+m_ROI.upper)*m_imageSize.width+m_ROI.left;
-
-		// current Integral Image Position
-		dptr = (m_ROI.width+1)*(rowidx+1) + 1;
+		unsigned char *curImage = image + (rowidx+m_ROI.upper)*m_imageSize.width+m_ROI.left;
 
-		value_tmp = 0;
-		value_tmpSq = 0;
+		// current and previous Integral Image rows
+		__uint32 *curRow = intImage + step*(rowidx+1);
+		__uint32 *prevRow = curRow - step;
 
-		for (columnidx = 0; columnidx<m_ROI.width; columnidx++)
+		// cumulative row sums, the only sequential part
+		__uint32 value_tmp = 0;
+		curRow[0] = 0;
+		if (m_useVariance)
 		{
-			// cumulative row sum
-			value_tmp += image[curPointer];
-			value_tmpSq += image[curPointer]*image[curPointer];
-
-			// update Integral Image
-			intImage[dptr] = intImage[ dptr - (m_ROI.width+1) ] + value_tmp;
-			intSqImage[dptr] = intSqImage[ dptr - (m_ROI.width+1) ] + value_tmpSq;
-
-			dptr++;
-			curPointer++;
+			__uint64 *curSqRow = intSqImage + step*(rowidx+1);
+			__uint64 *prevSqRow = curSqRow - step;
+			__uint64 value_tmpSq = 0;
+
+			curSqRow[0] = 0;
+			for (columnidx = 0; columnidx<m_ROI.width; columnidx++)
+			{
+				value_tmp += curImage[columnidx];
+				value_tmpSq += curImage[columnidx]*curImage[columnidx];
+				curRow[columnidx+1] = value_tmp;
+				curSqRow[columnidx+1] = value_tmpSq;
+			}
+
+			for (columnidx = 1; columnidx<step; columnidx++)
+				curSqRow[columnidx] += prevSqRow[columnidx];
+		}
+		else
+		{
+			for (columnidx = 0; columnidx<m_ROI.width; columnidx++)
+			{
+				value_tmp += curImage[columnidx];
+				curRow[columnidx+1] = value_tmp;
+			}
 		}
 
+		// adding the previous row is independent per column, so the
+		// compiler vectorises it
+		for (columnidx = 1; columnidx<step; columnidx++)
+			curRow[columnidx] += prevRow[columnidx];
 	}
 
+	m_sqValid = m_useVariance;
+
 	return;
 }
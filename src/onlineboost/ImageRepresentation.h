@@ -29,19 +29,27 @@ public:
 	float getVariance(Rect imageROI);
 	long getSqSum(Rect imageROI);
 	bool getUseVariance(){return m_useVariance;};
-	void setUseVariance(bool useVariance){ this->m_useVariance = useVariance; };
+	// the squared integral image is only built while variance normalisation
+	// is on, starting with the next image
+	void setUseVariance(bool useVariance);
+
+	// integral image of the ROI, one row of (ROI width+1) entries per ROI row + 1
+	__uint32* getIntegralImage(){return intImage;};
 
 
 private:
 
 	bool m_useVariance;
 	void createIntegralsOfROI(unsigned char* image);
+	void allocateIntegrals();
 
 	Size m_imageSize;
         __uint32* intImage;
         __uint64* intSqImage;
 	Rect m_ROI;
 	Point2D m_offset;
+	unsigned long m_capacity;  // entries allocated for the integral images
+	bool m_sqValid;            // intSqImage matches the current image
 };
 
 #endif // __IMAGE_REPRESENTATION_H__
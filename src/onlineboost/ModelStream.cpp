@@ -0,0 +1,65 @@
+#include "ModelStream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void ModelWriter::writeInt(int value)
+{
+	writeBytes(&value, sizeof(int));
+}
+
+void ModelWriter::writeFloat(float value)
+{
+	writeBytes(&value, sizeof(float));
+}
+
+void ModelWriter::writeBytes(const void* data, int length)
+{
+	const char* bytes = (const char*)data;
+	m_data.insert(m_data.end(), bytes, bytes+length);
+}
+
+bool ModelWriter::saveToFile(const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+		return false;
+
+	bool written = fwrite(getData(), 1, getLength(), file) == (size_t)getLength();
+	return (fclose(file) == 0) && written;
+}
+
+ModelReader::ModelReader(const char* data, int length)
+{
+	m_data = data;
+	m_length = length;
+	m_position = 0;
+	m_valid = true;
+}
+
+int ModelReader::readInt()
+{
+	int value;
+	readBytes(&value, sizeof(int));
+	return value;
+}
+
+float ModelReader::readFloat()
+{
+	float value;
+	readBytes(&value, sizeof(float));
+	return value;
+}
+
+void ModelReader::readBytes(void* data, int length)
+{
+	if (!m_valid || length < 0 || length > m_length-m_position)
+	{
+		m_valid = false;
+		memset(data, 0, length > 0 ? length : 0);
+		return;
+	}
+
+	memcpy(data, m_data+m_position, length);
+	m_position += length;
+}
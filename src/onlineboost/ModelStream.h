@@ -0,0 +1,52 @@
+#ifndef __MODEL_STREAM_H__
+#define __MODEL_STREAM_H__
+
+#include <vector>
+
+#include "OS_specific.h"
+
+// compact binary form of the classifiers, in host byte order; each class
+// writes its own state with save(ModelWriter*) and reads it back from a
+// constructor taking a ModelReader*
+class ModelWriter
+{
+public:
+
+	void writeInt(int value);
+	void writeFloat(float value);
+	void writeBytes(const void* data, int length);
+
+	const char* getData(){return m_data.empty() ? NULL : &m_data[0];};
+	int getLength(){return (int)m_data.size();};
+
+	bool saveToFile(const char* filename);
+
+private:
+
+	std::vector<char> m_data;
+};
+
+class ModelReader
+{
+public:
+
+	ModelReader(const char* data, int length);
+
+	int readInt();
+	float readFloat();
+	void readBytes(void* data, int length);
+
+	// false once a read went past the end of the data or a value was out
+	// of range; the values read from then on are zeros
+	bool isValid(){return m_valid;};
+	void invalidate(){m_valid = false;};
+
+private:
+
+	const char* m_data;
+	int m_length;
+	int m_position;
+	bool m_valid;
+};
+
+#endif // __MODEL_STREAM_H__
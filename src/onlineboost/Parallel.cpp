@@ -0,0 +1,95 @@
+#include "Parallel.h"
+
+#include "worker-pool.h"
+
+struct ParallelWork
+{
+	ParallelFunc func;
+	void* data;
+	int numItems;
+	int chunkSize;
+	gint nextItem;
+};
+
+static void parallelWorker(gpointer task, gpointer user_data)
+{
+	ParallelWork* work = (ParallelWork*)task;
+
+	for (;;)
+	{
+		int begin = g_atomic_int_exchange_and_add(&work->nextItem, work->chunkSize);
+		if (begin >= work->numItems)
+			break;
+
+		int end = begin+work->chunkSize < work->numItems ? begin+work->chunkSize : work->numItems;
+		work->func(work->data, begin, end);
+	}
+}
+
+ParallelPool::ParallelPool()
+{
+	m_pool = NULL;
+	m_tasks = NULL;
+	m_numThreads = 1;
+}
+
+ParallelPool::~ParallelPool()
+{
+	worker_pool_free(m_pool);
+	delete[] m_tasks;
+}
+
+void ParallelPool::setNumThreads(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = (int)worker_pool_default_n_threads();
+	if (numThreads == m_numThreads)
+		return;
+
+	worker_pool_free(m_pool);
+	delete[] m_tasks;
+	m_pool = NULL;
+	m_tasks = NULL;
+	m_numThreads = 1;
+
+	if (numThreads > 1)
+	{
+		m_pool = worker_pool_new(parallelWorker, NULL, numThreads);
+		m_numThreads = (int)worker_pool_get_n_threads(m_pool);
+		m_tasks = new void*[m_numThreads];
+	}
+}
+
+int ParallelPool::numThreadsFor(int numItems, int chunkSize)
+{
+	int numChunks = (numItems+chunkSize-1)/chunkSize;
+	int numThreads = m_numThreads;
+	if (numThreads > numChunks)
+		numThreads = numChunks;
+	if (numThreads < 1)
+		numThreads = 1;
+
+	return numThreads;
+}
+
+void ParallelPool::run(int numItems, int chunkSize, ParallelFunc func, void* data)
+{
+	ParallelWork work;
+	work.func = func;
+	work.data = data;
+	work.numItems = numItems;
+	work.chunkSize = chunkSize;
+	work.nextItem = 0;
+
+	int numThreads = numThreadsFor(numItems, chunkSize);
+	if (numThreads <= 1)
+	{
+		parallelWorker(&work, NULL);
+		return;
+	}
+
+	// every task pulls chunks from the same work until none is left
+	for (int curThread = 0; curThread < numThreads; curThread++)
+		m_tasks[curThread] = &work;
+	worker_pool_run(m_pool, m_tasks, numThreads);
+}
@@ -0,0 +1,46 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include "OS_specific.h"
+
+struct _WorkerPool;
+
+// processes the items [begin, end) of a ParallelPool::run()
+typedef void (*ParallelFunc)(void* data, int begin, int end);
+
+// worker threads from the common worker pool, started once by
+// setNumThreads() and kept for all the runs. A pool runs one batch at a
+// time, so it must not be shared by callers that may run concurrently
+class ParallelPool
+{
+public:
+
+	ParallelPool();
+	~ParallelPool();
+
+	// 0 uses one thread per online processor, 1 (the default) runs the
+	// chunks serially without starting any thread
+	void setNumThreads(int numThreads);
+	int getNumThreads(){return m_numThreads;};
+
+	// number of threads run() actually uses for such a run
+	int numThreadsFor(int numItems, int chunkSize);
+
+	// calls func over [0, numItems) in chunks of chunkSize items; the calling
+	// thread takes part and the call returns once all the chunks are done.
+	// Threads claim the next chunk as soon as they are free, so func must
+	// only write state owned by its own items for the result not to depend
+	// on scheduling
+	void run(int numItems, int chunkSize, ParallelFunc func, void* data);
+
+private:
+
+	ParallelPool(const ParallelPool&);
+	ParallelPool& operator=(const ParallelPool&);
+
+	struct _WorkerPool* m_pool;
+	void** m_tasks;
+	int m_numThreads;
+};
+
+#endif // __PARALLEL_H__
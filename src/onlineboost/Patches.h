@@ -22,6 +22,7 @@ public:
 
 	virtual Rect getROI();
 	virtual int getNum(void){return num;};
+	Rect* getRects(){return patches;};
 
 	int checkOverlap(Rect rect);
 	
@@ -0,0 +1,63 @@
+#include "Random.h"
+
+static inline __uint32 rotl(__uint32 x, int k)
+{
+	return (x << k) | (x >> (32-k));
+}
+
+Random::Random(__uint32 seed)
+{
+	setSeed(seed);
+}
+
+void Random::setSeed(__uint32 seed)
+{
+	// expand the seed with splitmix32, which never yields an all zero state
+	for (int i = 0; i < 4; i++)
+	{
+		__uint32 z = (seed += 0x9e3779b9u);
+		z = (z ^ (z >> 16)) * 0x85ebca6bu;
+		z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+		m_state[i] = z ^ (z >> 16);
+	}
+}
+
+__uint32 Random::next()
+{
+	__uint32 result = rotl(m_state[1]*5, 7)*9;
+	__uint32 t = m_state[1] << 9;
+
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = rotl(m_state[3], 11);
+
+	return result;
+}
+
+int Random::nextInt(int n)
+{
+	return (int)(next() % (__uint32)n);
+}
+
+float Random::nextFloat()
+{
+	return (float)nextDouble();
+}
+
+double Random::nextDouble()
+{
+	return (double)next()/4294967295.0;
+}
+
+void Random::save(ModelWriter* writer)
+{
+	writer->writeBytes(m_state, sizeof(m_state));
+}
+
+void Random::load(ModelReader* reader)
+{
+	reader->readBytes(m_state, sizeof(m_state));
+}
@@ -0,0 +1,31 @@
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include "OS_specific.h"
+#include "ModelStream.h"
+
+// small and fast pseudo random generator (xoshiro128**); each classifier
+// owns one, so that its features and sampling only depend on its seed and
+// no state is shared with rand() or with other threads
+class Random
+{
+public:
+
+	Random(__uint32 seed = 0);
+
+	void setSeed(__uint32 seed);
+
+	__uint32 next();
+	int nextInt(int n);      // in [0, n)
+	float nextFloat();       // in [0, 1], like (float)rand()/RAND_MAX
+	double nextDouble();     // in [0, 1]
+
+	void save(ModelWriter* writer);
+	void load(ModelReader* reader);
+
+private:
+
+	__uint32 m_state[4];
+};
+
+#endif // __RANDOM_H__
@@ -5,7 +5,9 @@ StrongClassifier::StrongClassifier(int numBaseClassifier,
 								   int numWeakClassifier, 
 								   Size patchSize, 
 								   bool useFeatureExchange, 
-								   int iterationInit)
+								   int iterationInit,
+								   __uint32 seed)
+: m_random(seed)
 {
 	this->numBaseClassifier = numBaseClassifier;
 	this->numAllWeakClassifier = numWeakClassifier+iterationInit;
@@ -15,6 +17,51 @@ StrongClassifier::StrongClassifier(int numBaseClassifier,
 
 	this->patchSize = patchSize;
 	this->useFeatureExchange = useFeatureExchange;
+
+	m_compiled = false;
+	m_compiledHaar = false;
+	m_compiledRight = m_compiledLower = 0;
+}
+
+StrongClassifier::StrongClassifier(ModelReader* reader)
+{
+	this->numBaseClassifier = reader->readInt();
+	this->numAllWeakClassifier = reader->readInt();
+	if (numBaseClassifier <= 0 || numBaseClassifier > 100000 || numAllWeakClassifier <= 0 || numAllWeakClassifier > 100000)
+	{
+		reader->invalidate();
+		numBaseClassifier = 1;
+		numAllWeakClassifier = 1;
+	}
+
+	alpha = new float[numBaseClassifier];
+	for (int curBaseClassifier = 0; curBaseClassifier < numBaseClassifier; curBaseClassifier++)
+		alpha[curBaseClassifier] = reader->readFloat();
+
+	patchSize.height = reader->readInt();
+	patchSize.width = reader->readInt();
+	useFeatureExchange = (reader->readInt() != 0);
+	m_random.load(reader);
+
+	m_compiled = false;
+	m_compiledHaar = false;
+	m_compiledRight = m_compiledLower = 0;
+}
+
+void StrongClassifier::save(ModelWriter* writer)
+{
+	writer->writeInt(numBaseClassifier);
+	writer->writeInt(numAllWeakClassifier);
+	for (int curBaseClassifier = 0; curBaseClassifier < numBaseClassifier; curBaseClassifier++)
+		writer->writeFloat(alpha[curBaseClassifier]);
+
+	writer->writeInt(patchSize.height);
+	writer->writeInt(patchSize.width);
+	writer->writeInt(useFeatureExchange ? 1 : 0);
+	m_random.save(writer);
+
+	for (int curBaseClassifier = 0; curBaseClassifier < numBaseClassifier; curBaseClassifier++)
+		baseClassifier[curBaseClassifier]->save(writer);
 }
 
 StrongClassifier::~StrongClassifier()
@@ -25,6 +72,13 @@ StrongClassifier::~StrongClassifier()
 	delete[] alpha;
 }
 
+void StrongClassifier::setNumThreads(int numThreads)
+{
+	m_parallel.setNumThreads(numThreads);
+	for (int curBaseClassifier = 0; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
+		baseClassifier[curBaseClassifier]->setParallelPool(m_parallel.getNumThreads() > 1 ? &m_parallel : NULL);
+}
+
 float StrongClassifier::getFeatureValue(ImageRepresentation *image, Rect ROI, int baseClassifierIdx)
 {
 	return baseClassifier[baseClassifierIdx]->getValue(image, ROI);
@@ -42,6 +96,176 @@ float StrongClassifier::eval(ImageRepresentation *image, Rect ROI)
 	return value;
 }
 
+bool StrongClassifier::compile(Size patchSize)
+{
+	if (m_compiled && m_compiledSize == patchSize)
+		return m_compiledHaar;
+
+	m_compiledAreaEnd.clear();
+	m_compiledThreshold.clear();
+	m_compiledParity.clear();
+	m_compiledAlpha.clear();
+	m_compiledLeft.clear();
+	m_compiledUpper.clear();
+	m_compiledWidth.clear();
+	m_compiledHeight.clear();
+	m_compiledWeight.clear();
+	m_compiledRight = m_compiledLower = 0;
+
+	m_compiled = true;
+	m_compiledHaar = true;
+	m_compiledSize = patchSize;
+
+	for (int curBaseClassifier = 0; curBaseClassifier<numBaseClassifier; curBaseClassifier++)
+	{
+		WeakClassifier *weakClassifier = baseClassifier[curBaseClassifier]->getSelectedClassifier();
+		if (weakClassifier->getType() != 1)
+		{
+			m_compiledHaar = false;
+			return false;
+		}
+
+		WeakClassifierHaarFeature *haar = (WeakClassifierHaarFeature*)weakClassifier;
+		FeatureHaar *feature = haar->getFeature();
+		int numAreas = feature->getNumAreas();
+
+		Rect *areas = new Rect[numAreas];
+		float *weights = new float[numAreas];
+
+		// a feature that cannot be scaled to this size votes 0; its end is
+		// stored as -1 and it is skipped altogether
+		bool valid = feature->getScaledAreas(patchSize, areas, weights);
+		if (valid)
+		{
+			for (int curArea = 0; curArea < numAreas; curArea++)
+			{
+				m_compiledLeft.push_back(areas[curArea].left);
+				m_compiledUpper.push_back(areas[curArea].upper);
+				m_compiledWidth.push_back(areas[curArea].width);
+				m_compiledHeight.push_back(areas[curArea].height);
+				m_compiledWeight.push_back(weights[curArea]);
+
+				if (areas[curArea].left+areas[curArea].width > m_compiledRight)
+					m_compiledRight = areas[curArea].left+areas[curArea].width;
+				if (areas[curArea].upper+areas[curArea].height > m_compiledLower)
+					m_compiledLower = areas[curArea].upper+areas[curArea].height;
+			}
+		}
+
+		delete[] areas;
+		delete[] weights;
+
+		m_compiledAreaEnd.push_back(valid ? (int)m_compiledLeft.size() : -1);
+		m_compiledThreshold.push_back(haar->getClassifierThreshold()->getThreshold());
+		m_compiledParity.push_back(haar->getClassifierThreshold()->getParity());
+		m_compiledAlpha.push_back(alpha[curBaseClassifier]);
+	}
+
+	return true;
+}
+
+void StrongClassifier::evalBatch(ImageRepresentation *image, const Rect *patches, int numPatches, float *confidences)
+{
+	int curPatch = 0;
+
+	while (curPatch < numPatches)
+	{
+		// run of patches sharing the same size
+		int endPatch = curPatch+1;
+		while (endPatch < numPatches && patches[endPatch].width == patches[curPatch].width &&
+			patches[endPatch].height == patches[curPatch].height)
+			endPatch++;
+
+		Size size;
+		size = patches[curPatch];
+		compile(size);
+
+		// variance normalisation is per patch, keep it on the scalar path
+		if (m_compiledHaar && !image->getUseVariance())
+			evalCompiled(image, patches+curPatch, endPatch-curPatch, confidences+curPatch);
+		else
+			for (int idx = curPatch; idx < endPatch; idx++)
+				confidences[idx] = eval(image, patches[idx]);
+
+		curPatch = endPatch;
+	}
+}
+
+void StrongClassifier::evalCompiled(ImageRepresentation *image, const Rect *patches, int numPatches, float *confidences)
+{
+	// patches are processed in blocks, so that the per patch accumulators
+	// stay in cache while all the areas are swept over them
+	const int blockSize = 64;
+	int origin[blockSize];
+	bool inside[blockSize];
+	float value[blockSize];
+
+	Rect ROI = image->getImageROI();
+	int step = ROI.width+1;
+	__uint32 *intImage = image->getIntegralImage();
+
+	for (int blockBegin = 0; blockBegin < numPatches; blockBegin += blockSize)
+	{
+		int blockPatches = numPatches-blockBegin < blockSize ? numPatches-blockBegin : blockSize;
+		const Rect *block = patches+blockBegin;
+
+		for (int curPatch = 0; curPatch < blockPatches; curPatch++)
+		{
+			int originX = block[curPatch].left-ROI.left;
+			int originY = block[curPatch].upper-ROI.upper;
+
+			// areas touching the border are clipped by getSum(), only
+			// patches whose areas are all strictly inside go the fast way
+			inside[curPatch] = originX >= 0 && originY >= 0 &&
+				originX+m_compiledRight < ROI.width && originY+m_compiledLower < ROI.height;
+			origin[curPatch] = originY*step+originX;
+			confidences[blockBegin+curPatch] = 0.0f;
+		}
+
+		int areaBegin = 0;
+		for (int curBaseClassifier = 0; curBaseClassifier < numBaseClassifier; curBaseClassifier++)
+		{
+			int areaEnd = m_compiledAreaEnd[curBaseClassifier];
+			if (areaEnd < 0)
+				continue;
+
+			for (int curPatch = 0; curPatch < blockPatches; curPatch++)
+				value[curPatch] = 0.0f;
+
+			for (int curArea = areaBegin; curArea < areaEnd; curArea++)
+			{
+				int offset = m_compiledUpper[curArea]*step+m_compiledLeft[curArea];
+				int right = m_compiledWidth[curArea];
+				int down = m_compiledHeight[curArea]*step;
+				float weight = m_compiledWeight[curArea];
+
+				for (int curPatch = 0; curPatch < blockPatches; curPatch++)
+				{
+					int32_t sum;
+					if (inside[curPatch])
+					{
+						__uint32 *originPtr = intImage+origin[curPatch]+offset;
+						sum = originPtr[down+right] + originPtr[0] - originPtr[right] - originPtr[down];
+					}
+					else
+						sum = image->getSum(Rect(block[curPatch].upper+m_compiledUpper[curArea],
+							block[curPatch].left+m_compiledLeft[curArea],
+							m_compiledHeight[curArea], m_compiledWidth[curArea]));
+					value[curPatch] += (float)sum*weight;
+				}
+			}
+
+			float threshold = m_compiledThreshold[curBaseClassifier];
+			int parity = m_compiledParity[curBaseClassifier];
+			float alpha = m_compiledAlpha[curBaseClassifier];
+			for (int curPatch = 0; curPatch < blockPatches; curPatch++)
+				confidences[blockBegin+curPatch] += (((parity*(value[curPatch]-threshold))>0) ? 1 : -1)*alpha;
+
+			areaBegin = areaEnd;
+		}
+	}
+}
+
 bool StrongClassifier::update(ImageRepresentation *image, Rect ROI, int target, float importance) 
 {
 	assert (true);
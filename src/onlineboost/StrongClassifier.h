@@ -2,10 +2,13 @@
 #define __STRONG_CLASSIFIER_H__
 
 #include <stdio.h>
+#include <vector>
 
 #include "ImageRepresentation.h"
 #include "BaseClassifier.h"
 #include "EstimatedGaussDistribution.h"
+#include "Random.h"
+#include "Parallel.h"
 
 #if OS_type==2
 #include "win32/windefs.h"
@@ -19,11 +22,20 @@ public:
 		              int numWeakClassifier, 
 		              Size patchSize, 
 					  bool useFeatureExchange = false, 
-					  int iterationInit = 0);
+					  int iterationInit = 0,
+					  __uint32 seed = 0);
 
 	~StrongClassifier();
 
 	virtual float eval(ImageRepresentation *image, Rect ROI); 
+	// same as eval() for each of the patches, on the flattened form of the
+	// selected weak classifiers; consecutive patches of equal size share it
+	void evalBatch(ImageRepresentation *image, const Rect *patches, int numPatches, float *confidences);
+	// builds the flattened form for patches of the given size, if out of date;
+	// once it returned true, evalBatch() on patches of that size (without
+	// variance normalisation) only reads the classifier and may run from
+	// several threads at once
+	bool compile(Size patchSize);
 
 	virtual bool update(ImageRepresentation *image, Rect ROI, int target, float importance = 1.0f); 
 	virtual bool updateSemi(ImageRepresentation *image, Rect ROI, float priorConfidence);
@@ -41,8 +53,22 @@ public:
 
 	void resetWeightDistribution();
 
+	// threads used to train the weak classifiers, see ParallelPool; they
+	// are started here and shared by all the base classifiers, which are
+	// trained one after the other
+	void setNumThreads(int numThreads);
+
+	// writes the whole state, including that of the random generator, so
+	// that the classifier read back goes on exactly as this one would
+	void save(ModelWriter* writer);
+	void setSeed(__uint32 seed){m_random.setSeed(seed);};
+
 protected:
 
+	// reads the part written by save() up to the base classifiers, which
+	// the derived classes read themselves
+	StrongClassifier(ModelReader* reader);
+
 	int numBaseClassifier;
 	int numAllWeakClassifier;
 
@@ -52,6 +78,31 @@ protected:
 	
 	bool useFeatureExchange;
 
+	// features and training samples are drawn from this generator only, so
+	// that a classifier is fully determined by its seed and its input
+	Random m_random;
+
+	ParallelPool m_parallel;
+
+	// flattened form of the selected weak classifiers, one entry per base
+	// classifier and one per Haar area; rebuilt after each update
+	bool m_compiled;
+	bool m_compiledHaar;      // false if some selected classifier is not a Haar feature
+	Size m_compiledSize;
+	std::vector<int> m_compiledAreaEnd;
+	std::vector<float> m_compiledThreshold;
+	std::vector<int> m_compiledParity;
+	std::vector<float> m_compiledAlpha;
+	std::vector<int> m_compiledLeft;
+	std::vector<int> m_compiledUpper;
+	std::vector<int> m_compiledWidth;
+	std::vector<int> m_compiledHeight;
+	std::vector<float> m_compiledWeight;
+	int m_compiledRight;      // extent of the areas within the patch
+	int m_compiledLower;
+
+	void evalCompiled(ImageRepresentation *image, const Rect *patches, int numPatches, float *confidences);
+
 };
 
 #endif // __STRONG_CLASSIFIER_H__
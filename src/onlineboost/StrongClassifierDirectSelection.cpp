@@ -1,15 +1,37 @@
 #include "StrongClassifierDirectSelection.h"
 
 StrongClassifierDirectSelection::StrongClassifierDirectSelection(int numBaseClassifier, int numWeakClassifier, 
-																 Size patchSize, bool useFeatureExchange, int iterationInit) 
-																 : StrongClassifier(numBaseClassifier, numWeakClassifier, patchSize, useFeatureExchange, iterationInit)
+																 Size patchSize, bool useFeatureExchange, int iterationInit, __uint32 seed) 
+																 : StrongClassifier(numBaseClassifier, numWeakClassifier, patchSize, useFeatureExchange, iterationInit, seed)
 {
 	this->useFeatureExchange = useFeatureExchange;
 	baseClassifier = new BaseClassifier*[numBaseClassifier];
-	baseClassifier[0] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize);
+	baseClassifier[0] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize, &m_random);
 
 	for (int curBaseClassifier = 1; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
-		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, baseClassifier[0]->getReferenceWeakClassifier());
+		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, baseClassifier[0]->getReferenceWeakClassifier(), &m_random);
+
+	m_errorMask = new bool[numAllWeakClassifier];
+	m_errors = new float[numAllWeakClassifier];
+	m_sumErrors = new float[numAllWeakClassifier];
+}
+
+StrongClassifierDirectSelection::StrongClassifierDirectSelection(ModelReader* reader)
+: StrongClassifier(reader)
+{
+	// the first base classifier owns the pool of weak classifiers, the
+	// others refer to it
+	baseClassifier = new BaseClassifier*[numBaseClassifier];
+	baseClassifier[0] = new BaseClassifier(reader, NULL, &m_random);
+
+	for (int curBaseClassifier = 1; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
+		baseClassifier[curBaseClassifier] = new BaseClassifier(reader, baseClassifier[0]->getReferenceWeakClassifier(), &m_random);
+
+	// all of them must share the pool, of the size given in the header
+	for (int curBaseClassifier = 0; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
+		if (baseClassifier[curBaseClassifier]->getNumWeakClassifier()+baseClassifier[curBaseClassifier]->getIterationInit() != numAllWeakClassifier ||
+			baseClassifier[curBaseClassifier]->getReferenceWeakClassifier() != baseClassifier[0]->getReferenceWeakClassifier())
+			reader->invalidate();
 
 	m_errorMask = new bool[numAllWeakClassifier];
 	m_errors = new float[numAllWeakClassifier];
@@ -26,6 +48,8 @@ StrongClassifierDirectSelection::~StrongClassifierDirectSelection()
 
 bool StrongClassifierDirectSelection::update(ImageRepresentation *image, Rect ROI, int target, float importance)
 {
+	m_compiled = false;
+
 	memset(m_errorMask, 0, numAllWeakClassifier*sizeof(bool));
 	memset(m_errors, 0, numAllWeakClassifier*sizeof(float));
 	memset(m_sumErrors, 0, numAllWeakClassifier*sizeof(float));
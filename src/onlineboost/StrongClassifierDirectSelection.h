@@ -7,7 +7,11 @@ class StrongClassifierDirectSelection : public StrongClassifier
 {
 public:
 
-	StrongClassifierDirectSelection(int numBaseClassifier, int numWeakClassifier, Size patchSize, bool useFeatureExchange = false, int iterationInit = 0); 
+	StrongClassifierDirectSelection(int numBaseClassifier, int numWeakClassifier, Size patchSize, bool useFeatureExchange = false, int iterationInit = 0, __uint32 seed = 0); 
+
+	// reads a classifier written by StrongClassifier::save(); check
+	// reader->isValid() before using it
+	StrongClassifierDirectSelection(ModelReader* reader);
 
 	virtual ~StrongClassifierDirectSelection();
 
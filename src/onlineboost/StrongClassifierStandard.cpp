@@ -4,19 +4,21 @@ StrongClassifierStandard::StrongClassifierStandard(int numBaseClassifier,
 												   int numWeakClassifier, 
 												   Size patchSize, 
 												   bool useFeatureExchange,
-												   int iterationInit) 
+												   int iterationInit,
+												   __uint32 seed) 
 												   : StrongClassifier(  numBaseClassifier, 
 												   numWeakClassifier, 
 												   patchSize,
 												   useFeatureExchange,
-												   iterationInit)
+												   iterationInit,
+												   seed)
 {
 	// init Base Classifier
 	baseClassifier = new BaseClassifier*[numBaseClassifier];
 
 	for (int curBaseClassifier = 0; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
 	{
-		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize);
+		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize, &m_random);
 	}
 
 	m_errorMask = new bool[numAllWeakClassifier];
@@ -32,6 +34,8 @@ StrongClassifierStandard::~StrongClassifierStandard()
 
 bool StrongClassifierStandard::update(ImageRepresentation *image, Rect ROI, int target, float importance)
 {
+	m_compiled = false;
+
 	int curBaseClassifier;
 	for (curBaseClassifier = 0; curBaseClassifier<numBaseClassifier; curBaseClassifier++)
 	{
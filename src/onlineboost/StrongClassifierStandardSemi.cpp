@@ -4,12 +4,14 @@ StrongClassifierStandardSemi::StrongClassifierStandardSemi(int numBaseClassifier
 												   int numWeakClassifier, 
 												   Size patchSize, 
 												   bool useFeatureExchange,
-												   int iterationInit)
+												   int iterationInit,
+												   __uint32 seed)
 												 : StrongClassifier(  numBaseClassifier, 
 																      numWeakClassifier, 
 																	  patchSize,
 																	  useFeatureExchange,
-																	  iterationInit)
+																	  iterationInit,
+																	  seed)
 {
 	// init Base Classifier
 	baseClassifier = new BaseClassifier*[numBaseClassifier];
@@ -19,7 +21,7 @@ StrongClassifierStandardSemi::StrongClassifierStandardSemi(int numBaseClassifier
 	
 	for (int curBaseClassifier = 0; curBaseClassifier< numBaseClassifier; curBaseClassifier++)
 	{
-		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize);
+		baseClassifier[curBaseClassifier] = new BaseClassifier(numWeakClassifier, iterationInit, patchSize, &m_random);
 	}
 
 	m_errorMask = new bool[numAllWeakClassifier];
@@ -39,6 +41,7 @@ StrongClassifierStandardSemi::~StrongClassifierStandardSemi()
 
 bool StrongClassifierStandardSemi::updateSemi(ImageRepresentation *image, Rect ROI, float priorConfidence)
 {
+	m_compiled = false;
 
 	float value = 0.0f, kvalue = 0.0f;
 
@@ -10,7 +10,7 @@ public:
 
 	StrongClassifierStandardSemi(int numBaseClassifier, int numWeakClassifier, 
                                  Size patchSize,  bool useFeatureExchange = false,
-                                 int iterationInit = 0);
+                                 int iterationInit = 0, __uint32 seed = 0);
 
 	virtual ~StrongClassifierStandardSemi();
 	
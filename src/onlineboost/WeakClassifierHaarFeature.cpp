@@ -1,13 +1,25 @@
 #include "WeakClassifierHaarFeature.h"
 
-WeakClassifierHaarFeature::WeakClassifierHaarFeature(Size patchSize)
+WeakClassifierHaarFeature::WeakClassifierHaarFeature(Size patchSize, Random* random)
 {
-	m_feature = new FeatureHaar(patchSize);
+	m_feature = new FeatureHaar(patchSize, random);
 	generateRandomClassifier();
 	m_feature->getInitialDistribution((EstimatedGaussDistribution*) m_classifier->getDistribution(-1));
 	m_feature->getInitialDistribution((EstimatedGaussDistribution*) m_classifier->getDistribution(1));
 }
 
+WeakClassifierHaarFeature::WeakClassifierHaarFeature(ModelReader* reader)
+{
+	m_feature = new FeatureHaar(reader);
+	m_classifier = new ClassifierThreshold(reader);
+}
+
+void WeakClassifierHaarFeature::save(ModelWriter* writer)
+{
+	m_feature->save(writer);
+	m_classifier->save(writer);
+}
+
 void WeakClassifierHaarFeature::resetPosDist()
 {
 	m_feature->getInitialDistribution((EstimatedGaussDistribution*) m_classifier->getDistribution(1));
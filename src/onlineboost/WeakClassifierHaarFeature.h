@@ -11,7 +11,8 @@ class WeakClassifierHaarFeature : public WeakClassifier
 
 public:
 
-	WeakClassifierHaarFeature(Size patchSize);
+	WeakClassifierHaarFeature(Size patchSize, Random* random);
+	WeakClassifierHaarFeature(ModelReader* reader);
 	virtual ~WeakClassifierHaarFeature();
 
 	bool update(ImageRepresentation* image, Rect ROI, int target); 
@@ -28,6 +29,11 @@ public:
 	void resetPosDist();
 	void initPosDist();
 
+	void save(ModelWriter* writer);
+
+	FeatureHaar* getFeature(){return m_feature;};
+	ClassifierThreshold* getClassifierThreshold(){return m_classifier;};
+
 private:
 
 	FeatureHaar* m_feature;
@@ -195,7 +195,7 @@ void on_mouse( int event, int x, int y, int flags, void* param )
 }
 
 
-void track(ImageSource::InputDevice input, int numBaseClassifier, float overlap, float searchFactor, char* resultDir, Rect initBB, char* source = NULL)
+void track(ImageSource::InputDevice input, int numBaseClassifier, float overlap, float searchFactor, char* resultDir, Rect initBB, char* source = NULL, int numThreads = 1)
 {
 	unsigned char *curFrame=NULL;
         int key;
@@ -282,6 +282,7 @@ void track(ImageSource::InputDevice input, int numBaseClassifier, float overlap,
 	printf ("init tracker...");
 	BoostingTracker* tracker;
 	tracker = new BoostingTracker (curFrameRep, trackingRect, wholeImage, numBaseClassifier);
+	tracker->setNumThreads (numThreads);
 	printf (" done.\n");
 
 	Size trackingRectSize;
@@ -427,8 +428,13 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	//optional number of detection threads, to compare the frame rates
+	int numThreads = 1;
+	if (argc >= 3)
+		numThreads = atoi(argv[2]);
+
 	//start tracking
-	track(input, numBaseClassifier, overlap, searchFactor, resultDir, initBB, source);
+	track(input, numBaseClassifier, overlap, searchFactor, resultDir, initBB, source, numThreads);
 
 	return 0;
 }
@@ -104,3 +104,8 @@ Point2D BoostingTracker::getCenter()
 	center.col =  trackedPatch.left +trackedPatch.width/2 ;
 	return center;
 }
+
+void BoostingTracker::setNumThreads(int numThreads)
+{
+	detector->setNumThreads(numThreads);
+}
@@ -19,6 +19,7 @@ public:
 	float getConfidence();
 	Rect getTrackedPatch();
 	Point2D getCenter();
+	void setNumThreads(int numThreads);
 	
 private:
 	StrongClassifier* classifier;
@@ -184,7 +184,7 @@ Rect getTrackingROI(float searchFactor, Rect rect, Rect validROI) {
     return searchRegion;
 }
 
-void track3(ImageSource::InputDevice input, int numBaseClassifier, float overlap, float searchFactor, char* resultDir, Rect initBB, char* source = NULL)
+void track3(ImageSource::InputDevice input, int numBaseClassifier, float overlap, float searchFactor, char* resultDir, Rect initBB, char* source = NULL, char* modelFile = NULL)
 {
 	unsigned char *curFrame=NULL;
         int key;
@@ -315,6 +315,10 @@ printf("\n");
 		key=cvWaitKey(200);
 	}
 
+	//keep the trained classifier, to warm-start trackers with it
+	if (modelFile != NULL && !tracker->save(modelFile))
+		printf("ERROR: unable to save the model to %s\n", modelFile);
+
 	//clean up
 	delete tracker;
 	delete imageSequenceSource;
@@ -357,8 +361,13 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
+    //optional file the trained classifier is saved to
+    char* modelFile = NULL;
+    if (argc >= 3)
+        modelFile = argv[2];
+
     //start tracking
-    track3(input, numBaseClassifier, overlap, searchFactor, resultDir, initBB, source);
+    track3(input, numBaseClassifier, overlap, searchFactor, resultDir, initBB, source, modelFile);
 
     return 0;
 }
@@ -85,6 +85,7 @@
 #endif
 
 #include "gstoptflowtracker.h"
+#include "roi-features.h"
 #include "tracked-object.h"
 #include "util.h"
 
@@ -92,6 +93,7 @@
 #include <gst/gststructure.h>
 #include <cvaux.h>
 #include <highgui.h>
+#include <string.h>
 
 
 GST_DEBUG_CATEGORY_STATIC(gst_optical_flow_tracker_debug);
@@ -137,7 +139,9 @@ struct _InstanceObject
     guint         id;
     CvPoint2D32f *features;
     CvPoint2D32f *prev_features;
+    guint         max_features;
     guint         n_features;
+    guint         points_offset; // first feature in the batched LK arrays
     guint         haar_n_features;
     guint         n_haar_frames;
     guint         last_frame;
@@ -166,19 +170,38 @@ static void          gst_optical_flow_tracker_set_property    (GObject *object,
 static void          gst_optical_flow_tracker_get_property    (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 static gboolean      gst_optical_flow_tracker_set_caps        (GstPad *pad, GstCaps *caps);
 static GstFlowReturn gst_optical_flow_tracker_chain           (GstPad *pad, GstBuffer *buf);
-static IplImage*     gst_optical_flow_tracker_print_fg_mask   (GstOpticalFlowTracker *filter);
-static IplImage*     gst_optical_flow_tracker_print_haar_mask (GstOpticalFlowTracker *filter, CvRect *rect);
 static gboolean      events_cb                                (GstPad *pad, GstEvent *event, gpointer user_data);
 static float         rect_area_overlap_perc                   (const CvRect *a, const CvRect *b);
+static InstanceObject* instance_object_acquire                (GstOpticalFlowTracker *filter);
+static void          instance_object_release                  (GstOpticalFlowTracker *filter, InstanceObject *object);
+static void          instance_object_free                     (InstanceObject *object);
 
 // gobject vmethod implementations
 static void
 gst_optical_flow_tracker_finalize(GObject *obj)
 {
     GstOpticalFlowTracker *filter = GST_OPTICAL_FLOW_TRACKER(obj);
-
-    if (filter->image) cvReleaseImage(&filter->image);
-    if (filter->gray)  cvReleaseImage(&filter->gray);
+    guint                  i;
+
+    if (filter->image)        cvReleaseImage(&filter->image);
+    if (filter->gray)         cvReleaseImage(&filter->gray);
+    if (filter->prev_gray)    cvReleaseImage(&filter->prev_gray);
+    if (filter->pyramid)      cvReleaseImage(&filter->pyramid);
+    if (filter->prev_pyramid) cvReleaseImage(&filter->prev_pyramid);
+    if (filter->prev_points)  g_free(filter->prev_points);
+    if (filter->points)       g_free(filter->points);
+    if (filter->status)       g_free(filter->status);
+
+    for (i = 0; i < filter->stored_objects->len; ++i)
+        instance_object_free(g_ptr_array_index(filter->stored_objects, i));
+    for (i = 0; i < filter->free_objects->len; ++i)
+        instance_object_free(g_ptr_array_index(filter->free_objects, i));
+    g_ptr_array_free(filter->stored_objects, TRUE);
+    g_ptr_array_free(filter->free_objects,   TRUE);
+
+    fg_mask_clear(&filter->fg_mask);
+    gst_buffer_replace(&filter->haar_rois, NULL);
+    gst_buffer_replace(&filter->fg_rois,   NULL);
 
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -318,13 +341,17 @@ gst_optical_flow_tracker_init(GstOpticalFlowTracker *filter, GstOpticalFlowTrack
 
     filter->n_frames                  = 0;
     filter->n_objects                 = 0;
-    filter->haar_roi_timestamp        = 0;
-    filter->fg_roi_timestamp          = 0;
-    filter->fg_mask_timestamp         = 0;
-    filter->haar_roi_array            = g_array_new(FALSE, FALSE, sizeof(CvRect));
-    filter->fg_roi_array              = g_array_new(FALSE, FALSE, sizeof(CvRect));
-    filter->stored_objects            = g_ptr_array_new_with_free_func(g_free);
-    filter->fg_mask                   = NULL;
+    filter->haar_rois                 = NULL;
+    filter->fg_rois                   = NULL;
+    filter->stored_objects            = g_ptr_array_new();
+    filter->free_objects              = g_ptr_array_new();
+    filter->prev_points               = NULL;
+    filter->points                    = NULL;
+    filter->status                    = NULL;
+    filter->points_size               = 0;
+    filter->fg_mask.buffer            = NULL;
+    filter->fg_mask.image             = NULL;
+    filter->fg_mask.timestamp         = 0;
 }
 
 static void
@@ -473,10 +500,9 @@ static GstFlowReturn
 gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
 {
     GstOpticalFlowTracker *filter;
-    IplImage          *bgr;
     GstClockTime       timestamp;
     gpointer           swap_pointer;
-    guint              i;
+    guint              i, n_points;
 
     // sanity checks
     g_return_val_if_fail(pad != NULL, GST_FLOW_ERROR);
@@ -487,9 +513,6 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
 
     // Create the gray image for the surf 'features' search process
     cvCvtColor(filter->image, filter->gray, CV_RGB2GRAY);
-    bgr = cvCreateImage(cvGetSize(filter->image), filter->image->depth, 3);
-    cvCopy(filter->image, bgr, NULL);
-    cvCvtColor(filter->image, bgr, CV_RGB2BGR);
 
     ++filter->n_frames;
     timestamp = GST_BUFFER_TIMESTAMP(buf);
@@ -497,39 +520,40 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
     GST_DEBUG_OBJECT(filter, "------------------- frame %d ----------------------", filter->n_frames);
 
     // first, process all ROIs received from the 'haar adjust' element
-    if ((filter->haar_roi_timestamp == timestamp) && (filter->haar_roi_array != NULL)) {
+    if (detections_timestamp(filter->haar_rois) == timestamp) {
         GST_DEBUG_OBJECT(filter, "processing haar ROIs");
-        for (i = 0; i < filter->haar_roi_array->len; ++i) {
-            IplImage       *mask;
+        for (i = 0; i < detections_count(filter->haar_rois); ++i) {
             InstanceObject *object;
-            CvRect         *rect;
+            CvRect          rect, roi;
+            IplImage       *mask;
             float           max_area_overlap;
             gint            best_match_idx;
             guint           j;
 
-            rect = &g_array_index(filter->haar_roi_array, CvRect, i);
+            rect = detections_get(filter->haar_rois, i)->rect;
 
-            mask                  = gst_optical_flow_tracker_print_haar_mask(filter, rect);
-            if ((filter->fg_mask != NULL) && (timestamp == filter->fg_mask_timestamp))
-                cvAnd(mask, filter->fg_mask, mask, NULL);
+            // the feature search runs on the part of the ROI that lies inside
+            // the frame, so its cost depends on the ROI area only
+            roi  = cvRect(0, 0, filter->gray->width, filter->gray->height);
+            roi  = rect_intersection(&rect, &roi);
+            if ((roi.width <= 0) || (roi.height <= 0))
+                continue;
 
-            object                = g_new(InstanceObject, 1);
-            object->rect          = *rect;
+            object                = instance_object_acquire(filter);
+            object->rect          = rect;
             object->timestamp     = timestamp;
             object->n_features    = filter->features_max_size;
-            object->features      = g_new(CvPoint2D32f, object->n_features);
-            object->prev_features = g_new(CvPoint2D32f, object->n_features);
             object->last_frame    = object->last_haar_frame = filter->n_frames;
 
-            // select features
-            cvGoodFeaturesToTrack(filter->gray, NULL, NULL, object->features, (int*) &object->n_features,
-                                  filter->features_quality_level, filter->features_min_distance, mask,
-                                  3, 0, 0.04); // 3, 0, 0.04 => opencv defaults
+            mask = NULL;
+            if ((filter->fg_mask.image != NULL) && (timestamp == filter->fg_mask.timestamp))
+                mask = filter->fg_mask.image;
 
-            cvFindCornerSubPix(filter->gray, object->features, object->n_features,
-                               cvSize(filter->corner_subpix_win_size, filter->corner_subpix_win_size),
-                               cvSize(-1, -1), cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,
-                                                              filter->term_criteria_iterations, filter->term_criteria_accuracy));
+            roi_features_find(filter->gray, mask, roi, object->features, &object->n_features,
+                              filter->features_quality_level, filter->features_min_distance,
+                              filter->corner_subpix_win_size,
+                              cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,
+                                             filter->term_criteria_iterations, filter->term_criteria_accuracy));
 
             object->haar_n_features = object->n_features;
 
@@ -543,7 +567,7 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
                 float area_overlap;
 
                 other = (InstanceObject*) g_ptr_array_index(filter->stored_objects, j);
-                area_overlap = rect_area_overlap_perc(rect, &other->rect);
+                area_overlap = rect_area_overlap_perc(&rect, &other->rect);
                 if ((area_overlap > filter->min_overlap_area_perc) &&
                     (area_overlap > max_area_overlap)) {
                     max_area_overlap = area_overlap;
@@ -554,11 +578,10 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
             // if a matching object was found, replace it; otherwise, add a new one
             if (best_match_idx >= 0) {
                 InstanceObject *other = (InstanceObject*) g_ptr_array_index(filter->stored_objects, best_match_idx);
-                g_free(other->features);
-                g_free(other->prev_features);
-                object->id = other->id; // save id before overwriting the other fields
-                *other = *object;
-                object = other;
+                object->id            = other->id;
+                object->n_haar_frames = other->n_haar_frames;
+                g_ptr_array_index(filter->stored_objects, best_match_idx) = object;
+                instance_object_release(filter, other);
             } else {
                 // add new object
                 object->id            = filter->n_objects++;
@@ -594,19 +617,17 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
         if (frames_since_haar >= max_ellapsed_frames) {
             // discard object
             GST_INFO_OBJECT(filter, "removing object %d (frames since haar (%d) >= max ellapsed frames (%d))\n", object->id, frames_since_haar, max_ellapsed_frames);
-            g_free(object->features);
-            g_free(object->prev_features);
             g_ptr_array_remove_index(filter->stored_objects, i);
+            instance_object_release(filter, object);
         }
     }
 
-    // then, search for objects that haven't been associated with a haar ROI
+    // then, search for objects that haven't been associated with a haar ROI;
+    // the features of all of them are tracked by a single LK pass, so that
+    // the pyramid of the current frame is built only once
+    n_points = 0;
     for (i = 0; i < filter->stored_objects->len; ++i) {
         InstanceObject *object;
-        CvRect          rect;
-        CvPoint         bounding_point1, bounding_point2;
-        gchar          *status;
-        guint           j, k;
 
         object = (InstanceObject*) g_ptr_array_index(filter->stored_objects, i);
 
@@ -614,21 +635,62 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
         if (object->timestamp == timestamp)
             continue;
 
-        status = g_new(gchar, object->n_features);
+        object->points_offset = n_points;
+        n_points += object->n_features;
+    }
+
+    if (n_points > filter->points_size) {
+        filter->points_size = n_points;
+        filter->prev_points = g_renew(CvPoint2D32f, filter->prev_points, filter->points_size);
+        filter->points      = g_renew(CvPoint2D32f, filter->points,      filter->points_size);
+        filter->status      = g_renew(gchar,        filter->status,      filter->points_size);
+    }
+
+    for (i = 0; i < filter->stored_objects->len; ++i) {
+        InstanceObject *object;
+
+        object = (InstanceObject*) g_ptr_array_index(filter->stored_objects, i);
+        if (object->timestamp == timestamp)
+            continue;
+
+        memcpy(filter->prev_points + object->points_offset, object->prev_features,
+               object->n_features * sizeof(CvPoint2D32f));
+    }
 
+    if (n_points > 0) {
         cvCalcOpticalFlowPyrLK(filter->prev_gray, filter->gray,
                                filter->prev_pyramid, filter->pyramid,
-                               object->prev_features,
-                               object->features,
-                               object->n_features,
+                               filter->prev_points,
+                               filter->points,
+                               n_points,
                                cvSize(filter->corner_subpix_win_size, filter->corner_subpix_win_size),
                                filter->pyramid_levels,
-                               status,
+                               filter->status,
                                NULL,
                                cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS, filter->term_criteria_iterations, filter->term_criteria_accuracy),
                                filter->flags);
 
+        // the current pyramid will be the previous one on the next frame
         filter->flags |= CV_LKFLOW_PYR_A_READY;
+    } else {
+        filter->flags &= ~CV_LKFLOW_PYR_A_READY;
+    }
+
+    // walk the objects backwards, so that removing one doesn't skip the next
+    for (i = filter->stored_objects->len; i > 0; --i) {
+        InstanceObject *object;
+        CvRect          rect;
+        CvPoint         bounding_point1, bounding_point2;
+        CvPoint2D32f   *points;
+        gchar          *status;
+        guint           j, k;
+
+        object = (InstanceObject*) g_ptr_array_index(filter->stored_objects, i - 1);
+        if (object->timestamp == timestamp)
+            continue;
+
+        points = filter->points + object->points_offset;
+        status = filter->status + object->points_offset;
 
         rect            = cvRect(filter->image->width, filter->image->height, 0, 0);
         bounding_point1 = cvPoint(MAX(0, object->rect.x * 0.95),
@@ -645,11 +707,11 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
 
             // skip features that lie outside the bounding perimeter (i.e.: 120% the original
             // bounding rectangle)
-            p = cvPointFrom32f(object->features[j]);
+            p = cvPointFrom32f(points[j]);
             if (p.x < bounding_point1.x || p.y < bounding_point1.y || p.x > bounding_point2.x || p.y > bounding_point2.y)
                 continue;
 
-            object->features[k++] = object->features[j];
+            object->features[k++] = points[j];
 
             // set coordinates of the new bounding rectangle
             if (p.x < rect.x) rect.x = p.x;
@@ -667,14 +729,9 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
         // MIN_MATCH_FEATURES_PERC, discard this object
         if (((float) object->n_features / object->haar_n_features) <= filter->min_match_features_perc) {
             GST_INFO_OBJECT(filter, "removing object %d (%d / %d (%.2f%%) features\n", object->id, object->n_features, object->haar_n_features, ((float) object->n_features / object->haar_n_features));
-            g_free(object->features);
-            g_free(object->prev_features);
-            g_ptr_array_remove_index(filter->stored_objects, i);
-            continue;
+            g_ptr_array_remove_index(filter->stored_objects, i - 1);
+            instance_object_release(filter, object);
         }
-
-
-        g_free(status);
     }
 
     // finally, generate the events for all the objects found in this frame
@@ -686,6 +743,10 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
 
         object = g_ptr_array_index(filter->stored_objects, i);
 
+        // skip objects not found on this frame
+        if (object->last_frame != filter->n_frames)
+            continue;
+
         // allocate and initialize 'TrackedObject' structure
         tracked_object            = tracked_object_new();
         tracked_object->id        = g_strdup_printf("OBJ#%d", object->id);
@@ -698,10 +759,6 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
         tracked_object_add_point(tracked_object, object->rect.x, object->rect.y + object->rect.height);
         tracked_object_add_point(tracked_object, object->rect.x + object->rect.width, object->rect.y + object->rect.height);
 
-        // skip objects not found on this frame
-        if (object->last_frame != filter->n_frames)
-            continue;
-
         tracked_object_str = tracked_object_to_string(tracked_object);
         GST_DEBUG_OBJECT(filter, "[object #%d] %s\n", tracked_object_str);
         g_free(tracked_object_str);
@@ -772,43 +829,48 @@ gst_optical_flow_tracker_chain(GstPad *pad, GstBuffer *buf)
     return gst_pad_push(filter->srcpad, buf);
 }
 
-static IplImage*
-gst_optical_flow_tracker_print_fg_mask(GstOpticalFlowTracker *filter)
+static float
+rect_area_overlap_perc(const CvRect *a, const CvRect *b)
 {
-    IplImage *mask;
-    guint     i;
-
-    mask = cvCreateImage(cvSize(filter->image->width, filter->image->height), filter->image->depth, 1);
-    cvSet(mask, cvScalarAll(0), 0); // draw black mask
-    for (i = 0; i < filter->fg_roi_array->len; ++i) {
-        CvRect *r = &g_array_index(filter->fg_roi_array, CvRect, i);
-        cvRectangle(mask, cvPoint(r->x, r->y), cvPoint(r->x + r->width, r->y + r->height),
-                    cvScalarAll(255), CV_FILLED, 8, 0);
-    }
-    return mask;
+    CvRect rect;
+
+    rect = rect_intersection(a, b);
+    return ((a->height * a->width == .0f) ? .0f : (float) (rect.height * rect.width) / (a->height * a->width));
 }
 
-static IplImage*
-gst_optical_flow_tracker_print_haar_mask(GstOpticalFlowTracker *filter, CvRect *r)
+// objects (and their feature arrays) are recycled instead of being
+// released, so that tracking doesn't allocate once the pool is warmed up
+static InstanceObject*
+instance_object_acquire(GstOpticalFlowTracker *filter)
 {
-    IplImage *mask;
-
-    mask = cvCreateImage(cvSize(filter->image->width, filter->image->height), filter->image->depth, 1);
-    cvSet(mask, cvScalarAll(0), 0); // draw black mask
-    cvRectangle(mask,
-                cvPoint(r->x, r->y),
-                cvPoint(r->x + r->width, r->y + r->height),
-                cvScalarAll(255), CV_FILLED, 8, 0);
-    return mask;
+    InstanceObject *object;
+
+    if (filter->free_objects->len > 0)
+        object = g_ptr_array_remove_index_fast(filter->free_objects, filter->free_objects->len - 1);
+    else
+        object = g_new0(InstanceObject, 1);
+
+    // the 'features-max-size' property may have grown since the object was created
+    if (object->max_features < filter->features_max_size) {
+        object->max_features  = filter->features_max_size;
+        object->features      = g_renew(CvPoint2D32f, object->features,      object->max_features);
+        object->prev_features = g_renew(CvPoint2D32f, object->prev_features, object->max_features);
+    }
+    return object;
 }
 
-static float
-rect_area_overlap_perc(const CvRect *a, const CvRect *b)
+static void
+instance_object_release(GstOpticalFlowTracker *filter, InstanceObject *object)
 {
-    CvRect rect;
+    g_ptr_array_add(filter->free_objects, object);
+}
 
-    rect = rect_intersection(a, b);
-    return ((a->height * a->width == .0f) ? .0f : (float) (rect.height * rect.width) / (a->height * a->width));
+static void
+instance_object_free(InstanceObject *object)
+{
+    g_free(object->features);
+    g_free(object->prev_features);
+    g_free(object);
 }
 
 // callbacks
@@ -827,66 +889,13 @@ events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
 
     structure = gst_event_get_structure(event);
 
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "bgfg-mask") == 0)) {
-        GArray      *data_array;
-        GstClockTime timestamp;
-        guint        width, height, depth, channels;
-
-        gst_structure_get((GstStructure*) structure,
-                          "data",      G_TYPE_POINTER, &data_array,
-                          "width",     G_TYPE_UINT,    &width,
-                          "height",    G_TYPE_UINT,    &height,
-                          "depth",     G_TYPE_UINT,    &depth,
-                          "channels",  G_TYPE_UINT,    &channels,
-                          "timestamp", G_TYPE_UINT64,  &timestamp,
-                          NULL);
-
-        if (filter->fg_mask != NULL)
-            cvReleaseImage(&filter->fg_mask);
-
-        filter->fg_mask_timestamp = timestamp;
-        filter->fg_mask = cvCreateImage(cvSize(width, height), depth, channels);
-        memcpy(filter->fg_mask->imageData, data_array->data, data_array->len);
-    }
-
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "haar-adjust-roi") == 0)) {
-        CvRect rect;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &rect.x,
-                          "y",         G_TYPE_UINT,   &rect.y,
-                          "width",     G_TYPE_UINT,   &rect.width,
-                          "height",    G_TYPE_UINT,   &rect.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp,
-                          NULL);
-
-        if (timestamp > filter->haar_roi_timestamp) {
-            filter->haar_roi_timestamp = timestamp;
-            g_array_free(filter->haar_roi_array, TRUE);
-            filter->haar_roi_array = g_array_sized_new(FALSE, FALSE, sizeof (CvRect), 1);
-        }
-        g_array_append_val(filter->haar_roi_array, rect);
-    }
+    // the mask buffer is shared with the upstream element; just keep a
+    // reference to it (and treat it as read-only)
+    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "bgfg-mask") == 0))
+        fg_mask_from_structure(structure, &filter->fg_mask);
 
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "bgfg-roi") == 0)) {
-        CvRect rect;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x", G_TYPE_UINT, &rect.x,
-                          "y", G_TYPE_UINT, &rect.y,
-                          "width", G_TYPE_UINT, &rect.width,
-                          "height", G_TYPE_UINT, &rect.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->fg_roi_timestamp) {
-            filter->fg_roi_timestamp = timestamp;
-            g_array_free(filter->fg_roi_array, TRUE);
-            filter->fg_roi_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 4);
-        }
-        g_array_append_val(filter->fg_roi_array, rect);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_HAAR_ADJUST, &filter->haar_rois);
+    detections_update_from_event(event, DETECTION_SOURCE_BGFG,        &filter->fg_rois);
 
     return TRUE;
 }
@@ -51,6 +51,8 @@
 #include <gst/gst.h>
 #include <cv.h>
 #include <draw.h>
+#include <fg-mask.h>
+#include <detections.h>
 
 G_BEGIN_DECLS
 
@@ -92,7 +94,7 @@ struct _GstOpticalFlowTracker
     IplImage          *pyramid;
     IplImage          *prev_gray;
     IplImage          *prev_pyramid;
-    IplImage          *fg_mask;
+    FgMask             fg_mask;
     gint               flags;
     float              font_scaling;
 
@@ -100,11 +102,15 @@ struct _GstOpticalFlowTracker
     guint              n_objects;
     GPtrArray         *stored_objects;
 
-    GstClockTime       haar_roi_timestamp;
-    GstClockTime       fg_roi_timestamp;
-    GstClockTime       fg_mask_timestamp;
-    GArray            *haar_roi_array;
-    GArray            *fg_roi_array;
+    // scratch storage recycled across frames
+    GPtrArray         *free_objects;
+    CvPoint2D32f      *prev_points;
+    CvPoint2D32f      *points;
+    gchar             *status;
+    guint              points_size;
+
+    GstBuffer         *haar_rois;
+    GstBuffer         *fg_rois;
 };
 
 struct _GstOpticalFlowTrackerClass
@@ -69,6 +69,7 @@
 
 #include "gstsurftracker.h"
 #include "tracked-object.h"
+#include "util.h"
 
 #include <gst/gst.h>
 #include <gst/gststructure.h>
@@ -84,12 +85,20 @@ GST_DEBUG_CATEGORY_STATIC(gst_surf_tracker_debug);
 #define MIN_MATCH_OBJECT                 .15
 #define DELOBJ_NFRAMES_IS_OLD            10
 #define DELOBJ_COMBOFRAMES_IS_IRRELEVANT 3
+#define DEFAULT_MATCH_CHECKS             0
+#define DEFAULT_LOCAL_SEARCH             FALSE
+#define DEFAULT_FULL_SEARCH_INTERVAL     10
+#define SEARCH_WINDOW_MARGIN             .5
+#define SEARCH_WINDOW_MIN_SIZE           16
 
 enum {
     PROP_0,
     PROP_VERBOSE,
     PROP_DISPLAY,
-    PROP_DISPLAY_FEATURES
+    PROP_DISPLAY_FEATURES,
+    PROP_MATCH_CHECKS,
+    PROP_LOCAL_SEARCH,
+    PROP_FULL_SEARCH_INTERVAL
 };
 
 // the capabilities of the inputs and outputs.
@@ -110,11 +119,8 @@ struct _InstanceObject
     gint          id;
     gint          last_frame_viewed;
     gint          range_viewed;
-    CvSeq        *surf_object_keypoints;
-    CvSeq        *surf_object_descriptors;
-    CvSeq        *surf_object_keypoints_last_match;
-    CvSeq        *surf_object_descriptors_last_match;
-    CvMemStorage *mem_storage;
+    SurfPoints   *surf_object_points;            // relative to 'rect'
+    SurfPoints   *surf_object_points_last_match; // frame coordinates
     CvRect        rect;
     CvRect        rect_estimated;
     GstClockTime  timestamp;
@@ -129,6 +135,8 @@ static void          gst_surf_tracker_get_property (GObject *object, guint prop_
 static gboolean      gst_surf_tracker_set_caps     (GstPad *pad, GstCaps *caps);
 static GstFlowReturn gst_surf_tracker_chain        (GstPad *pad, GstBuffer *buf);
 static gboolean      events_cb                     (GstPad *pad, GstEvent *event, gpointer user_data);
+static void          extract_surf                  (GstSURFTracker *filter, CvRect window, CvPoint pt_displacement, SurfPoints *points);
+static void          extract_surf_local            (GstSURFTracker *filter, SurfPoints *points);
 
 static void
 gst_surf_tracker_finalize(GObject *obj) {
@@ -137,6 +145,21 @@ gst_surf_tracker_finalize(GObject *obj) {
     if (filter->image) cvReleaseImage(&filter->image);
     if (filter->gray) cvReleaseImage(&filter->gray);
 
+    gst_buffer_replace(&filter->rects, NULL);
+
+    if (filter->stored_objects) {
+        guint i;
+
+        for (i = 0; i < filter->stored_objects->len; ++i) {
+            InstanceObject *object = &g_array_index(filter->stored_objects, InstanceObject, i);
+            surfPointsFree(object->surf_object_points);
+            surfPointsFree(object->surf_object_points_last_match);
+        }
+        g_array_free(filter->stored_objects, TRUE);
+    }
+    if (filter->surf_image_points) surfPointsFree(filter->surf_image_points);
+    if (filter->mem_storage) cvReleaseMemStorage(&filter->mem_storage);
+
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
 
@@ -183,6 +206,22 @@ gst_surf_tracker_class_init(GstSURFTrackerClass *klass) {
                                     g_param_spec_boolean("display-features", "Display features",
                                                          "Highlight the SURF feature points in the video output",
                                                          FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_MATCH_CHECKS,
+                                    g_param_spec_uint("match-checks", "Match checks",
+                                                      "Maximum number of frame descriptors compared against each object descriptor; "
+                                                      "higher values improve the matching recall at the expense of speed (0 = exact search)",
+                                                      0, G_MAXUINT, DEFAULT_MATCH_CHECKS, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_LOCAL_SEARCH,
+                                    g_param_spec_boolean("local-search", "Local search",
+                                                         "Extract the frame SURF features only around the estimated position of the stored objects",
+                                                         DEFAULT_LOCAL_SEARCH, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_FULL_SEARCH_INTERVAL,
+                                    g_param_spec_uint("full-search-interval", "Full search interval",
+                                                      "Number of frames between full frame SURF extractions when 'local-search' is set (0 = never)",
+                                                      0, G_MAXUINT, DEFAULT_FULL_SEARCH_INTERVAL, G_PARAM_READWRITE));
 }
 
 // initialize the new element
@@ -206,11 +245,15 @@ gst_surf_tracker_init(GstSURFTracker *filter, GstSURFTrackerClass *gclass) {
     filter->display              = FALSE;
     filter->display_features     = FALSE;
     filter->params               = cvSURFParams(100, 1);
+    filter->match_checks         = DEFAULT_MATCH_CHECKS;
+    filter->local_search         = DEFAULT_LOCAL_SEARCH;
+    filter->full_search_interval = DEFAULT_FULL_SEARCH_INTERVAL;
     filter->static_count_objects = 0;
     filter->frames_processed     = 0;
-    filter->rect_timestamp       = 0;
-    filter->rect_array           = g_array_new(FALSE, FALSE, sizeof(CvRect));
+    filter->rects                = NULL;
     filter->stored_objects       = g_array_new(FALSE, FALSE, sizeof(InstanceObject));
+    filter->surf_image_points    = surfPointsNew(filter->params.extended ? 128 : 64);
+    filter->mem_storage          = cvCreateMemStorage(0);
 }
 
 static void
@@ -227,6 +270,15 @@ gst_surf_tracker_set_property(GObject *object, guint prop_id, const GValue *valu
         case PROP_DISPLAY_FEATURES:
             filter->display_features = g_value_get_boolean(value);
             break;
+        case PROP_MATCH_CHECKS:
+            filter->match_checks = g_value_get_uint(value);
+            break;
+        case PROP_LOCAL_SEARCH:
+            filter->local_search = g_value_get_boolean(value);
+            break;
+        case PROP_FULL_SEARCH_INTERVAL:
+            filter->full_search_interval = g_value_get_uint(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -247,6 +299,15 @@ gst_surf_tracker_get_property(GObject *object, guint prop_id, GValue *value, GPa
         case PROP_DISPLAY_FEATURES:
             g_value_set_boolean(value, filter->display_features);
             break;
+        case PROP_MATCH_CHECKS:
+            g_value_set_uint(value, filter->match_checks);
+            break;
+        case PROP_LOCAL_SEARCH:
+            g_value_set_boolean(value, filter->local_search);
+            break;
+        case PROP_FULL_SEARCH_INTERVAL:
+            g_value_set_uint(value, filter->full_search_interval);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -298,53 +359,52 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
 
     // If exist stored_objects: search matching, update, cleaning
     if ((filter->stored_objects != NULL) && (filter->stored_objects->len > 0)) {
-        CvMemStorage *surf_image_mem_storage;
-        CvSeq        *surf_image_keypoints, *surf_image_descriptors;
-        guint         i;
-        gint          j;
+        SurfIndex *surf_image_index;
+        guint      i;
+        gint       j;
 
         // Update the match set 'features' for each object
-        surf_image_mem_storage = cvCreateMemStorage(0);
+        surfPointsClear(filter->surf_image_points);
+        if (filter->local_search &&
+            ((filter->full_search_interval == 0) || (filter->frames_processed % filter->full_search_interval != 0))) {
+            // Search 'features' only around the objects
+            extract_surf_local(filter, filter->surf_image_points);
+        } else {
+            // Search 'features' in full image
+            extract_surf(filter, cvRect(0, 0, filter->gray->width, filter->gray->height), cvPoint(0, 0),
+                         filter->surf_image_points);
+        }
 
-        // Search 'features' in full image
-        surf_image_keypoints = surf_image_descriptors = NULL;
-        cvExtractSURF(filter->gray, NULL, &surf_image_keypoints, &surf_image_descriptors,
-                      surf_image_mem_storage, filter->params, 0);
+        // index the frame 'features' once; all the objects are matched against it
+        surf_image_index = NULL;
+        if (filter->surf_image_points->total > 0)
+            surf_image_index = surfIndexNew(filter->surf_image_points, filter->match_checks);
 
-        for (i = 0; i < filter->stored_objects->len; ++i) {
+        for (i = 0; (surf_image_index != NULL) && (i < filter->stored_objects->len); ++i) {
             InstanceObject *object;
             GArray         *pairs;
 
             object = &g_array_index(filter->stored_objects, InstanceObject, i);
             pairs  = g_array_new(FALSE, FALSE, sizeof(IntPair));
 
-            findPairs(object->surf_object_keypoints, object->surf_object_descriptors,
-                      surf_image_keypoints, surf_image_descriptors, pairs);
+            findPairsIndexed(object->surf_object_points, surf_image_index, pairs);
 
             // if match, update object
-            if (pairs->len && (float) pairs->len / object->surf_object_descriptors->total >= MIN_MATCH_OBJECT) {
+            if (pairs->len && (float) pairs->len / object->surf_object_points->total >= MIN_MATCH_OBJECT) {
                 object->range_viewed++;
                 object->last_frame_viewed = filter->frames_processed;
                 object->timestamp         = timestamp;
 
-                if (object->surf_object_keypoints_last_match != NULL)
-                    cvClearSeq(object->surf_object_keypoints_last_match);
-                object->surf_object_keypoints_last_match = getMatchPoints(surf_image_keypoints, pairs, 1, object->mem_storage);
-
-                if (object->surf_object_descriptors_last_match != NULL)
-                    cvClearSeq(object->surf_object_descriptors_last_match);
-                object->surf_object_descriptors_last_match = getMatchPoints(surf_image_descriptors, pairs, 1, object->mem_storage);
+                surfPointsSelect(object->surf_object_points_last_match, filter->surf_image_points, pairs, 1);
 
                 // Estimate rect of objects localized
-                object->rect_estimated = rectDisplacement(object->surf_object_keypoints, surf_image_keypoints, pairs, object->rect, PAIRS_PERC_CONSIDERATE);
+                object->rect_estimated = rectDisplacement(object->surf_object_points, filter->surf_image_points, pairs, object->rect, PAIRS_PERC_CONSIDERATE);
             }
 
             g_array_free(pairs, TRUE);
         }
 
-        if (surf_image_keypoints != NULL) cvClearSeq(surf_image_keypoints);
-        if (surf_image_descriptors != NULL) cvClearSeq(surf_image_descriptors);
-        cvReleaseMemStorage(&surf_image_mem_storage);
+        if (surf_image_index != NULL) surfIndexFree(surf_image_index);
 
         // Clean old objects
         for (j = filter->stored_objects->len - 1; j >= 0; --j) {
@@ -353,11 +413,8 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
             object = &g_array_index(filter->stored_objects, InstanceObject, j);
             if ((filter->frames_processed - object->last_frame_viewed > DELOBJ_NFRAMES_IS_OLD) ||
                 (filter->frames_processed != object->last_frame_viewed && object->range_viewed < DELOBJ_COMBOFRAMES_IS_IRRELEVANT)) {
-                if (object->surf_object_keypoints != NULL) cvClearSeq(object->surf_object_keypoints);
-                if (object->surf_object_descriptors != NULL) cvClearSeq(object->surf_object_descriptors);
-                if (object->surf_object_keypoints_last_match != NULL) cvClearSeq(object->surf_object_keypoints_last_match);
-                if (object->surf_object_descriptors_last_match != NULL) cvClearSeq(object->surf_object_descriptors_last_match);
-                cvReleaseMemStorage(&object->mem_storage);
+                surfPointsFree(object->surf_object_points);
+                surfPointsFree(object->surf_object_points_last_match);
                 g_array_remove_index_fast(filter->stored_objects, j);
             }
         }
@@ -365,11 +422,11 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
     } // if any object exist
 
     // Process all haar rects
-    if ((filter->rect_array != NULL) && (filter->rect_array->len > 0)) {
+    if (detections_count(filter->rects) > 0) {
         guint i, j;
 
-        for (i = 0; i < filter->rect_array->len; ++i) {
-            CvRect rect = g_array_index(filter->rect_array, CvRect, i);
+        for (i = 0; i < detections_count(filter->rects); ++i) {
+            CvRect rect = detections_get(filter->rects, i)->rect;
 
             // If already exist in 'stored_objects', update features. Else save
             // as new.
@@ -380,14 +437,12 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
 
                 // It is considered equal if the "centroid match features" is inner
                 // haar rect AND max area deviation is PERC_RECT_TO_SAME_OBJECT
-                if (pointIntoRect(rect, (object->surf_object_keypoints_last_match != NULL) ? surfCentroid(object->surf_object_keypoints_last_match, cvPoint(0, 0)) : surfCentroid(object->surf_object_keypoints, cvPoint(0, 0))) &&
+                if (pointIntoRect(rect, (object->surf_object_points_last_match->total > 0) ? surfCentroid(object->surf_object_points_last_match, cvPoint(0, 0)) : surfCentroid(object->surf_object_points, cvPoint(0, 0))) &&
                     ((float) MIN((object->rect.width * object->rect.height), (rect.width * rect.height)) / (float) MAX((object->rect.width * object->rect.height), (rect.width * rect.height)) >= PERC_RECT_TO_SAME_OBJECT)) {
 
                     // Update the object features secound the new body rect
-                    cvSetImageROI(filter->gray, rect);
-                    cvExtractSURF(filter->gray, NULL, &object->surf_object_keypoints, &object->surf_object_descriptors,
-                                  object->mem_storage, filter->params, 0);
-                    cvResetImageROI(filter->gray);
+                    surfPointsClear(object->surf_object_points);
+                    extract_surf(filter, rect, cvPoint(0, 0), object->surf_object_points);
                     object->rect = object->rect_estimated = rect;
                     object->last_body_identify_timestamp = timestamp;
 
@@ -399,26 +454,20 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
             if (j >= filter->stored_objects->len) {
                 InstanceObject object;
 
-                object.surf_object_keypoints   = 0;
-                object.surf_object_descriptors = 0;
-                object.mem_storage             = cvCreateMemStorage(0);
-
-                cvSetImageROI(filter->gray, rect);
-                cvExtractSURF(filter->gray, NULL, &object.surf_object_keypoints, &object.surf_object_descriptors,
-                              object.mem_storage, filter->params, 0);
-                cvResetImageROI(filter->gray);
+                object.surf_object_points = surfPointsNew(filter->surf_image_points->length);
+                extract_surf(filter, rect, cvPoint(0, 0), object.surf_object_points);
 
-                if (object.surf_object_descriptors && object.surf_object_descriptors->total > 0) {
-                    object.id                                 = filter->static_count_objects++;
-                    object.last_frame_viewed                  = filter->frames_processed;
-                    object.range_viewed                       = 1;
-                    object.rect                               = object.rect_estimated               = rect;
-                    object.timestamp                          = object.last_body_identify_timestamp = timestamp;
-                    object.surf_object_keypoints_last_match   = NULL;
-                    object.surf_object_descriptors_last_match = NULL;
+                if (object.surf_object_points->total > 0) {
+                    object.id                            = filter->static_count_objects++;
+                    object.last_frame_viewed             = filter->frames_processed;
+                    object.range_viewed                  = 1;
+                    object.rect                          = object.rect_estimated               = rect;
+                    object.timestamp                     = object.last_body_identify_timestamp = timestamp;
+                    object.surf_object_points_last_match = surfPointsNew(filter->surf_image_points->length);
 
                     g_array_append_val(filter->stored_objects, object);
-                }
+                } else
+                    surfPointsFree(object.surf_object_points);
             } // new
         }
     }
@@ -440,12 +489,12 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
 
                 if (filter->verbose) {
                     GST_INFO("[object #%d rect] x: %d, y: %d, width: %d, height: %d\n", object.id, rect.x, rect.y, rect.width, rect.height);
-                    // drawSurfPoints(object.surf_object_keypoints, cvPoint(object.rect.x, object.rect.y), filter->image, PRINT_COLOR, 0);
-                    // drawSurfPoints(object.surf_object_keypoints_last_match, cvPoint(object.rect.x, object.rect.y), filter->image, PRINT_COLOR, 1);
+                    // drawSurfPoints(object.surf_object_points, cvPoint(object.rect.x, object.rect.y), filter->image, PRINT_COLOR, 0);
+                    // drawSurfPoints(object.surf_object_points_last_match, cvPoint(object.rect.x, object.rect.y), filter->image, PRINT_COLOR, 1);
                 }
 
                 if (filter->display_features) {
-                    drawSurfPoints(object.surf_object_keypoints_last_match, cvPoint(0, 0), filter->image, PRINT_COLOR, 1);
+                    drawSurfPoints(object.surf_object_points_last_match, cvPoint(0, 0), filter->image, PRINT_COLOR, 1);
                 }
 
                 if (filter->display) {
@@ -482,8 +531,7 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
     }
 
     // Clean body rects
-    g_array_free(filter->rect_array, TRUE);
-    filter->rect_array = g_array_sized_new(FALSE, FALSE, sizeof(CvRect), 1);
+    gst_buffer_replace(&filter->rects, NULL);
 
     // Draw number of objects stored
     if (filter->display) {
@@ -496,12 +544,79 @@ gst_surf_tracker_chain(GstPad *pad, GstBuffer *buf) {
     return gst_pad_push(filter->srcpad, buf);
 }
 
+// extracts the SURF 'features' inside 'window' and appends them to 'points',
+// displaced by 'pt_displacement'; the sequences returned by cvExtractSURF only
+// live until they are copied, so a single storage is reused for all the calls
+static void
+extract_surf(GstSURFTracker *filter, CvRect window, CvPoint pt_displacement, SurfPoints *points)
+{
+    CvSeq *keypoints, *descriptors;
+
+    keypoints = descriptors = NULL;
+
+    cvSetImageROI(filter->gray, window);
+    cvExtractSURF(filter->gray, NULL, &keypoints, &descriptors, filter->mem_storage, filter->params, 0);
+    cvResetImageROI(filter->gray);
+
+    surfPointsAppendSeq(points, keypoints, descriptors, pt_displacement);
+    cvClearMemStorage(filter->mem_storage);
+}
+
+// extracts the SURF 'features' inside windows around the estimated rect of
+// each stored object (overlapping windows are merged, so that no region is
+// searched twice); the points are appended in frame coordinates
+static void
+extract_surf_local(GstSURFTracker *filter, SurfPoints *points)
+{
+    GArray *windows;
+    CvRect  frame;
+    guint   i, j;
+
+    windows = g_array_new(FALSE, FALSE, sizeof(CvRect));
+    frame   = cvRect(0, 0, filter->gray->width, filter->gray->height);
+
+    for (i = 0; i < filter->stored_objects->len; ++i) {
+        InstanceObject *object;
+        CvRect          window, *r;
+
+        object = &g_array_index(filter->stored_objects, InstanceObject, i);
+        r      = &object->rect_estimated;
+        window = cvRect(r->x - r->width * SEARCH_WINDOW_MARGIN, r->y - r->height * SEARCH_WINDOW_MARGIN,
+                        r->width * (1 + 2 * SEARCH_WINDOW_MARGIN), r->height * (1 + 2 * SEARCH_WINDOW_MARGIN));
+        window = rect_intersection(&window, &frame);
+        if ((window.width < SEARCH_WINDOW_MIN_SIZE) || (window.height < SEARCH_WINDOW_MIN_SIZE))
+            continue;
+
+        // merge the window with every window it overlaps; the merged window
+        // may overlap windows already tested, so restart after each merge
+        for (j = 0; j < windows->len; ) {
+            CvRect *other, intersection;
+
+            other        = &g_array_index(windows, CvRect, j);
+            intersection = rect_intersection(&window, other);
+            if ((intersection.width > 0) && (intersection.height > 0)) {
+                window = cvMaxRect(&window, other);
+                g_array_remove_index_fast(windows, j);
+                j = 0;
+            } else
+                ++j;
+        }
+        g_array_append_val(windows, window);
+    }
+
+    for (i = 0; i < windows->len; ++i) {
+        CvRect window = g_array_index(windows, CvRect, i);
+        extract_surf(filter, window, cvPoint(window.x, window.y), points);
+    }
+
+    g_array_free(windows, TRUE);
+}
+
 // callbacks
 
 static
 gboolean events_cb(GstPad *pad, GstEvent *event, gpointer user_data) {
     GstSURFTracker *filter;
-    const GstStructure *structure;
 
     filter = GST_SURF_TRACKER(user_data);
 
@@ -510,24 +625,7 @@ gboolean events_cb(GstPad *pad, GstEvent *event, gpointer user_data) {
     g_return_val_if_fail(event  != NULL, FALSE);
     g_return_val_if_fail(filter != NULL, FALSE);
 
-    structure = gst_event_get_structure(event);
-
-    if ((structure != NULL) && (strcmp(gst_structure_get_name(structure), "haar-adjust-roi") == 0)) {
-        CvRect       rect;
-        GstClockTime timestamp;
-
-        gst_structure_get((GstStructure*) structure,
-                          "x", G_TYPE_UINT, &rect.x,
-                          "y", G_TYPE_UINT, &rect.y,
-                          "width", G_TYPE_UINT, &rect.width,
-                          "height", G_TYPE_UINT, &rect.height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->rect_timestamp) {
-            filter->rect_timestamp = timestamp;
-        }
-        g_array_append_val(filter->rect_array, rect);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_HAAR_ADJUST, &filter->rects);
 
     return TRUE;
 }
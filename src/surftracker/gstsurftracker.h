@@ -51,6 +51,7 @@
 #include <cv.h>
 #include <draw.h>
 #include <surf.h>
+#include <detections.h>
 
 G_BEGIN_DECLS
 
@@ -79,9 +80,13 @@ struct _GstSURFTracker
     int           frames_processed;
     int           static_count_objects;
     CvSURFParams  params;
-    GstClockTime  rect_timestamp;
-    GArray       *rect_array;
+    guint         match_checks;
+    gboolean      local_search;
+    guint         full_search_interval;
+    GstBuffer    *rects;
     GArray       *stored_objects;
+    SurfPoints   *surf_image_points;
+    CvMemStorage *mem_storage;
 };
 
 struct _GstSURFTrackerClass
@@ -63,11 +63,12 @@
 
 #include "gsttracker.h"
 #include "util.h"
+#include "assignment.h"
 
 GST_DEBUG_CATEGORY_STATIC(gst_tracker_debug);
 
 // New tracker
-#define TRACKER_NUM_PARTICLES               100
+#define DEFAULT_NUM_PARTICLES               100
 #define TRACKER_NUM_SUBSEQUENT_DETECTIONS   2
 
 // Remove tracker
@@ -79,8 +80,25 @@ GST_DEBUG_CATEGORY_STATIC(gst_tracker_debug);
 #define DEFAULT_DET_CONFIDENCE_PARAMETER    0.50
 #define DEFAULT_CLASSIFIER_PARAMETER        0.25
 
-// Greedy algorithm
-#define MIN_GREEDY_CONSIDER_PAIR            0.4f
+// Random numbers
+#define DEFAULT_SEED                        0
+
+// Classifier model
+#define DEFAULT_MODEL_LOCATION              NULL
+
+// New trackers are initialised off the streaming thread
+#define DEFAULT_ASYNC_INIT                  TRUE
+// and join the tracking this many frames after their detection
+#define ASYNC_INIT_FRAMES                   5
+
+// Threads the trackers run on (0 = one per processor)
+#define DEFAULT_NUM_WORKERS                 0
+
+// Association of the detections to the trackers
+#define MIN_CONSIDER_PAIR                   0.4f
+// a detection further from a tracker than this many diagonals (of the
+// tracker or of the detection, the bigger) is not considered for it
+#define ASSOCIATION_GATE                    3.0f
 
 enum {
     PROP_0,
@@ -89,14 +107,37 @@ enum {
     PROP_DETECTION_PARAMETER,
     PROP_DET_CONFIDENCE_PARAMETER,
     PROP_CLASSIFIER_PARAMETER,
-    PROP_SHOW_FEATURES_BOX
+    PROP_SHOW_FEATURES_BOX,
+    PROP_SEED,
+    PROP_MODEL_LOCATION,
+    PROP_ASYNC_INIT,
+    PROP_NUM_PARTICLES,
+    PROP_NUM_WORKERS
 };
 
 typedef struct {
-    CvRect  region;
-    guint   count;
+    CvRect   region;
+    guint    count;
+    gboolean pending;   // its tracker is being initialised
 } unassociated_obj_t;
 
+// a tracker to be initialised on the background thread; the image is a copy
+// since the element's one is reused for the next buffers
+typedef struct {
+    unassociated_obj_t *obj;
+    CvRect              region;
+    IplImage           *image;
+    gfloat              beta, gamma, eta;
+    guint               num_particles;
+    gint                id;
+    guint32             seed;
+    GstTrackerModel    *model;     // a reference, or NULL
+    gint                n_classifier_threads;
+    guint               join_frame;  // frame the tracker joins the tracking on
+    gboolean            initialized; // it was popped from initialized_trackers
+    Tracker            *tracker;
+} tracker_init_t;
+
 /* the capabilities of the inputs and outputs.*/
 static GstStaticPadTemplate sink_factory =
     GST_STATIC_PAD_TEMPLATE("sink",
@@ -119,10 +160,15 @@ static gboolean      gst_tracker_set_caps                   (GstPad *pad, GstCap
 static GstFlowReturn gst_tracker_chain                      (GstPad *pad, GstBuffer *buf);
 static gboolean      gst_tracker_events_cb                  (GstPad *pad, GstEvent *event, gpointer user_data);
 static GSList*       has_intersection                       (CvRect *obj, GSList *objects);
-static void          associate_detected_obj_to_tracker      (IplImage *image, GSList *detected_objects, GSList *trackers, GSList **unassociated_objects);
-static Tracker*      closer_tracker_with_a_detected_obj_to  (Tracker *tracker, GSList *trackers);
+static void          associate_detected_obj_to_tracker      (IplImage *image, CClassifierFrame *frame, GstBuffer *detected_objects, GPtrArray *trackers, GSList **unassociated_objects);
+static Tracker*      closer_tracker_with_a_detected_obj_to  (Tracker *tracker, GPtrArray *trackers);
 void                 print_tracker                          (Tracker *tracker, IplImage *image, gint id_tracker, gboolean show_particles);
-static void          remove_old_trackers                    (IplImage *image, GSList **trackers);
+static void          remove_old_trackers                    (CClassifierFrame *frame, GPtrArray *trackers);
+static void          gst_tracker_run_tracker                (gpointer task, gpointer user_data);
+static void          gst_tracker_load_model                 (GstTracker *filter);
+static void          gst_tracker_model_unref                (GstTrackerModel *model);
+static void          gst_tracker_init_tracker               (gpointer data, gpointer user_data);
+static void          gst_tracker_add_initialized_trackers   (GstTracker *filter);
 void                 distribution_test                      (CvRect rect, IplImage *image);
 
 // clean up
@@ -131,9 +177,32 @@ gst_tracker_finalize(GObject * obj)
 {
     GstTracker *filter = GST_TRACKER(obj);
 
+    // the pending trackers are finished and dropped before anything they use
+    if (filter->init_pool)    g_thread_pool_free(filter->init_pool, FALSE, TRUE);
+    if (filter->initialized_trackers) g_async_queue_unref(filter->initialized_trackers);
+    if (filter->pending_trackers) {
+        tracker_init_t *init;
+        while ((init = (tracker_init_t*) g_queue_pop_head(filter->pending_trackers)) != NULL) {
+            tracker_free(init->tracker);
+            g_free(init);
+        }
+        g_queue_free(filter->pending_trackers);
+    }
+    if (filter->workers)      worker_pool_free(filter->workers);
+    if (filter->trackers) {
+        g_ptr_array_foreach(filter->trackers, (GFunc) tracker_free, NULL);
+        g_ptr_array_free(filter->trackers, TRUE);
+    }
+
     if (filter->image)        cvReleaseImage(&filter->image);
+    if (filter->frame)        classifier_intermediate_frame_release(filter->frame);
+    if (filter->rand)         g_rand_free(filter->rand);
+    if (filter->model)        gst_tracker_model_unref(filter->model);
+    if (filter->model_location) g_free(filter->model_location);
     if (filter->verbose)      g_print("\n");
 
+    gst_buffer_replace(&filter->detected_objects, NULL);
+
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
 
@@ -189,6 +258,26 @@ gst_tracker_class_init(GstTrackerClass * klass)
     g_object_class_install_property(gobject_class, PROP_CLASSIFIER_PARAMETER,
                                     g_param_spec_float("classifier-influence", "Classifier Parameter (eta)", "How much classifier influences in particle update (eta parameter in Breitenstein paper).",
                                                        0.0, 20 * DEFAULT_CLASSIFIER_PARAMETER, DEFAULT_CLASSIFIER_PARAMETER, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_SEED,
+                                    g_param_spec_uint("seed", "Seed", "Seed of the random numbers used by the trackers; the same seed and input give the same tracks.",
+                                                      0, G_MAXUINT, DEFAULT_SEED, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_MODEL_LOCATION,
+                                    g_param_spec_string("model-location", "Model location", "Location of a classifier model used to warm-start the new trackers; when unset, each tracker is trained from scratch. Can only be set in the NULL or READY state.",
+                                                        DEFAULT_MODEL_LOCATION, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ASYNC_INIT,
+                                    g_param_spec_boolean("async-init", "Asynchronous initialisation", "Sets whether new trackers are initialised on a background thread, so that buffers are not held up meanwhile; they then join the tracking a fixed number of frames after their detection, waiting for their initialisation if needed, so that the tracks do not depend on the thread timing. Otherwise they are ready on the frame of their detection.",
+                                                         DEFAULT_ASYNC_INIT, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_NUM_PARTICLES,
+                                    g_param_spec_uint("particles", "Particles", "Number of particles of the new trackers; fewer particles track faster but less precisely.",
+                                                      2, 10000, DEFAULT_NUM_PARTICLES, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_NUM_WORKERS,
+                                    g_param_spec_uint("n-workers", "Number of workers", "Number of threads the trackers are run on, each tracker on one of them; takes effect when the caps are (re)negotiated (0 = one per processor)",
+                                                      0, 64, DEFAULT_NUM_WORKERS, G_PARAM_READWRITE));
 }
 
 /* initialize the new element
@@ -221,8 +310,26 @@ gst_tracker_init(GstTracker * filter, GstTrackerClass * gclass)
     filter->beta                         = DEFAULT_DETECTION_PARAMETER;
     filter->gamma                        = DEFAULT_DET_CONFIDENCE_PARAMETER;
     filter->eta                          = DEFAULT_CLASSIFIER_PARAMETER;
-    filter->detect_timestamp             = 0;
+    filter->seed                         = DEFAULT_SEED;
+    filter->rand                         = g_rand_new_with_seed(DEFAULT_SEED);
+    filter->model_location               = g_strdup(DEFAULT_MODEL_LOCATION);
+    filter->model                        = NULL;
+    filter->async_init                   = DEFAULT_ASYNC_INIT;
+    filter->num_particles                = DEFAULT_NUM_PARTICLES;
+    filter->n_workers                    = DEFAULT_NUM_WORKERS;
+    filter->workers                      = NULL;
+    filter->trackers                     = g_ptr_array_new();
+    filter->pending_trackers             = g_queue_new();
+    filter->n_frames                     = 0;
+
+    // a single thread initialises the trackers in the order of their
+    // detections, so that they are added in that same order
+    if (!g_thread_supported()) g_thread_init(NULL);
+    filter->initialized_trackers         = g_async_queue_new();
+    filter->init_pool                    = g_thread_pool_new(gst_tracker_init_tracker, filter, 1, FALSE, NULL);
+    filter->detected_objects             = NULL;
     filter->confidence_density_timestamp = 0;
+    filter->frame                        = classifier_intermediate_frame_new();
 }
 
 static void
@@ -250,6 +357,33 @@ gst_tracker_set_property(GObject *object, guint prop_id,
         case PROP_SHOW_FEATURES_BOX:
             filter->show_features_box = g_value_get_boolean(value);
             break;
+        case PROP_SEED:
+            filter->seed = g_value_get_uint(value);
+            g_rand_set_seed(filter->rand, filter->seed);
+            break;
+        case PROP_MODEL_LOCATION:
+            // the streaming thread hands the model to the new trackers, so
+            // it is only replaced while no buffer flows
+            GST_OBJECT_LOCK(filter);
+            if (GST_STATE(filter) > GST_STATE_READY || GST_STATE_PENDING(filter) > GST_STATE_READY) {
+                GST_OBJECT_UNLOCK(filter);
+                GST_WARNING_OBJECT(filter, "model-location can only be set in the NULL or READY state");
+                break;
+            }
+            GST_OBJECT_UNLOCK(filter);
+            if (filter->model_location) g_free(filter->model_location);
+            filter->model_location = g_value_dup_string(value);
+            gst_tracker_load_model(filter);
+            break;
+        case PROP_ASYNC_INIT:
+            filter->async_init = g_value_get_boolean(value);
+            break;
+        case PROP_NUM_PARTICLES:
+            filter->num_particles = g_value_get_uint(value);
+            break;
+        case PROP_NUM_WORKERS:
+            filter->n_workers = g_value_get_uint(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -281,6 +415,21 @@ gst_tracker_get_property(GObject * object, guint prop_id,
         case PROP_SHOW_FEATURES_BOX:
             g_value_set_boolean(value, filter->show_features_box);
             break;
+        case PROP_SEED:
+            g_value_set_uint(value, filter->seed);
+            break;
+        case PROP_MODEL_LOCATION:
+            g_value_set_string(value, filter->model_location);
+            break;
+        case PROP_ASYNC_INIT:
+            g_value_set_boolean(value, filter->async_init);
+            break;
+        case PROP_NUM_PARTICLES:
+            g_value_set_uint(value, filter->num_particles);
+            break;
+        case PROP_NUM_WORKERS:
+            g_value_set_uint(value, filter->n_workers);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -305,6 +454,11 @@ gst_tracker_set_caps(GstPad * pad, GstCaps * caps)
 
     filter->image = cvCreateImage(cvSize(width, height), 8, 3);
 
+    // the trackers of a frame are run on persistent workers
+    if (filter->workers) worker_pool_free(filter->workers);
+    filter->workers = worker_pool_new(gst_tracker_run_tracker, filter,
+                                      (filter->n_workers > 0) ? filter->n_workers : worker_pool_default_n_threads());
+
     // add event probe to capture detection rectangles and confidence density
     // sent by the upstream hog detect element
     gst_pad_add_event_probe(filter->sinkpad, (GCallback) gst_tracker_events_cb, filter);
@@ -315,40 +469,63 @@ gst_tracker_set_caps(GstPad * pad, GstCaps * caps)
     return gst_pad_set_caps(otherpad, caps);
 }
 
-/* The greedy algorithm */
+/* whether a detection is close enough to a tracker to be scored for it */
+static gboolean
+association_gate(Tracker *tracker, CvRect *detected_obj)
+{
+    CvPoint c_tr, c_d;
+    gfloat  diag_tr, diag_d, max_dist, dx, dy;
+
+    c_tr     = rect_centroid(&tracker->tracker_area);
+    c_d      = rect_centroid(detected_obj);
+    diag_tr  = sqrtf((gfloat) (tracker->tracker_area.width * tracker->tracker_area.width +
+                               tracker->tracker_area.height * tracker->tracker_area.height));
+    diag_d   = sqrtf((gfloat) (detected_obj->width * detected_obj->width +
+                               detected_obj->height * detected_obj->height));
+    max_dist = ASSOCIATION_GATE * MAX(diag_tr, diag_d);
+    dx       = c_tr.x - c_d.x;
+    dy       = c_tr.y - c_d.y;
+
+    return (dx * dx + dy * dy) <= max_dist * max_dist;
+}
+
+/* Scores the pairs of detection and tracker that pass the gate, then pairs
+ * them so that the sum of the scores is maximal (see assignment.h) */
 static void
-associate_detected_obj_to_tracker(IplImage *image, GSList *detected_objects, GSList *trackers, GSList **unassociated_objects)
+associate_detected_obj_to_tracker(IplImage *image, CClassifierFrame *frame, GstBuffer *detected_objects, GPtrArray *trackers, GSList **unassociated_objects)
 {
-    GSList      *it_detected_obj;
-    GSList      *it_tracker;
-    Tracker     *tracker;
-    CvRect      *detected_obj;
-    guint       it_d, it_tr, it_dxtr, size_tr, size_d;
-    gfloat      results_vet[g_slist_length(detected_objects)*g_slist_length(trackers)];
-    gfloat      partc_vet[g_slist_length(trackers)];
-    guint       remain_d[g_slist_length(detected_objects)];
+    Tracker        *tracker;
+    CvRect         *detected_obj;
+    guint           it_d, it_tr, size_tr, size_d;
+    gfloat         *partc_vet;
+    gint           *tracker_of_d;
+    GArray         *pairs;
+    AssignmentPair  pair;
 
     *unassociated_objects   = NULL;
-    size_d                  = g_slist_length(detected_objects);
-    size_tr                 = g_slist_length(trackers);
+    size_d                  = detections_count(detected_objects);
+    size_tr                 = trackers->len;
+
+    // scratch on the heap, since crowds can be large
+    partc_vet               = g_new(gfloat, MAX(size_tr, 1));
+    tracker_of_d            = g_new(gint, MAX(size_d, 1));
+    pairs                   = g_array_new(FALSE, FALSE, sizeof(AssignmentPair));
 
-    // Init the remain detected objects vector
     for (it_d = 0; it_d < size_d; ++it_d)
-        remain_d[it_d] = 1;
+        tracker_of_d[it_d] = -1;
 
     GST_INFO("detected_objects: %d, trackers: %d\n", size_d, size_tr);
 
     // If exist any tracker
     if (size_tr) {
 
-        // Init the greedy pairs array
-        for (it_dxtr = 0; it_dxtr < size_d * size_tr; ++it_dxtr)
-            results_vet[it_dxtr] = -1;
+        // the particles do not move during the association
+        for (it_tr = 0; it_tr < size_tr; it_tr++)
+            tracker_update_particle_cells((Tracker*) g_ptr_array_index(trackers, it_tr));
 
-        it_d = 0;
-        for (it_detected_obj = detected_objects; it_detected_obj; it_detected_obj = it_detected_obj->next) {
+        for (it_d = 0; it_d < size_d; ++it_d) {
             CvPoint rect_centroid_d;
-            detected_obj = (CvRect*) it_detected_obj->data;
+            detected_obj = (CvRect*) &detections_get(detected_objects, it_d)->rect;
             rect_centroid_d = rect_centroid(detected_obj);
 
             // PART C: probability according to the concentration of particles
@@ -356,51 +533,10 @@ associate_detected_obj_to_tracker(IplImage *image, GSList *detected_objects, GSL
                 gfloat max_partc;
 
                 max_partc = -1;
-                it_tr = 0;
-                for (it_tracker = trackers; it_tracker; it_tracker = it_tracker->next) {
-                    tracker = (Tracker*) it_tracker->data;
-                    {
-                        gint i, j, count_diff_particles;
-                        CvPoint vet_particles[tracker->filter->SamplesNum];
-
-                        // Cria o subconjunto de particulas diferentes entre si
-                        count_diff_particles = 0;
-                        for (i = 0; i < tracker->filter->SamplesNum; ++i) {
-                            CvPoint point_temp = cvPoint(tracker->filter->flSamples[i][0], tracker->filter->flSamples[i][1]);
-
-                            for (j = 0; j < count_diff_particles; ++j)
-                                if (point_temp.x == vet_particles[j].x && point_temp.y == vet_particles[j].y) break;
-
-                            if (j >= count_diff_particles) {
-                                vet_particles[count_diff_particles] = point_temp;
-                                count_diff_particles++;
-                            }
-                        }
-
-                        if (count_diff_particles <= 1) {
-                            partc_vet[it_tr] = -1;
-                        } else {
-                            gfloat mean, standard_deviation, part_c;
-
-                            mean = standard_deviation = part_c = 0;
-
-                            for (i = 0; i < count_diff_particles; ++i)
-                                mean += abs(euclidian_distance(rect_centroid_d, vet_particles[i]));
-                            mean /= count_diff_particles;
-
-                            for (i = 0; i < count_diff_particles; ++i)
-                                standard_deviation += pow((abs(euclidian_distance(rect_centroid_d, vet_particles[i])) - mean), 2);
-                            standard_deviation /= count_diff_particles;
-                            standard_deviation = sqrt(standard_deviation);
-
-                            for (i = 0; i < count_diff_particles; ++i)
-                                part_c += gaussian_function(abs(euclidian_distance(rect_centroid_d, vet_particles[i])), mean, standard_deviation);
-                            part_c /= count_diff_particles;
-                            partc_vet[it_tr] = part_c;
-                            if (part_c > max_partc) max_partc = part_c;
-                        }
-                    }
-                    it_tr++;
+                for (it_tr = 0; it_tr < size_tr; it_tr++) {
+                    tracker = (Tracker*) g_ptr_array_index(trackers, it_tr);
+                    partc_vet[it_tr] = tracker_particle_concentration(tracker, rect_centroid_d);
+                    if (partc_vet[it_tr] > max_partc) max_partc = partc_vet[it_tr];
                 }
 
                 // FIXME: apply alpha value (evaluate situation of only one particle)
@@ -410,15 +546,17 @@ associate_detected_obj_to_tracker(IplImage *image, GSList *detected_objects, GSL
                 }
             }
 
-            it_tr = 0;
-            for (it_tracker = trackers; it_tracker; it_tracker = it_tracker->next) {
+            for (it_tr = 0; it_tr < size_tr; it_tr++) {
                 gfloat part_a, part_b, result;
-                tracker = (Tracker*) it_tracker->data;
+                tracker = (Tracker*) g_ptr_array_index(trackers, it_tr);
 
                 // FIXME: clean the bad trackers
                 if ((tracker == NULL) || (tracker->tracker_area.x < 0 || tracker->tracker_area.y < 0))
                     continue;
 
+                if (!association_gate(tracker, detected_obj))
+                    continue;
+
                 // PART A: probability according to size and placement
                 {
                     gfloat area_proportion, area_tr, area_d;
@@ -454,89 +592,163 @@ associate_detected_obj_to_tracker(IplImage *image, GSList *detected_objects, GSL
 
                 // PART B: probability according to similarity
                 {
-                    part_b = classifier_intermediate_classify(tracker->classifier, image, *detected_obj);
+                    part_b = classifier_intermediate_classify_frame(tracker->classifier, frame, *detected_obj);
                     part_b = (part_b < 0) ? 0 : (part_b + 30) / 60;
                     part_b = pow(part_b, 4);
                 }
 
                 result = part_a * ((part_b + partc_vet[it_tr]) / 2);
-                results_vet[it_tr + (it_d * size_tr)] = result;
                 GST_INFO("A:%5.3f B:%5.3f C:%5.3f RESULT:%5.3f\n", part_a, part_b, partc_vet[it_tr], result);
-                it_tr++;
+
+                // Discards pairs with values irrelevant
+                if (result >= MIN_CONSIDER_PAIR) {
+                    pair.row   = it_d;
+                    pair.col   = it_tr;
+                    pair.score = result;
+                    g_array_append_val(pairs, pair);
+                }
             }
-            it_d++;
         }
 
-        // Discards pairs with values irrelevant
-        for (it_dxtr = 0; it_dxtr < size_d * size_tr; ++it_dxtr)
-            if (results_vet[it_dxtr] < MIN_GREEDY_CONSIDER_PAIR)
-                results_vet[it_dxtr] = -1;
-
         // Find pairs and Rect updating (tracker->detected_object) of the associated objects
-        for (;;) {
-
-            gfloat max_result;
-            guint  it_d_max, it_tr_max;
-
-            max_result = -1;
-
-            // Find the max result_value in array
-            for (it_dxtr = 0; it_dxtr < size_d * size_tr; ++it_dxtr)
-                if (results_vet[it_dxtr] > max_result){
-                    max_result = results_vet[it_dxtr];
-                    it_d_max = (guint) it_dxtr / size_tr;
-                    it_tr_max = it_dxtr - ((guint) (it_d_max * size_tr));
-                }
-
-            // If not exist any valid value, abort
-            if (max_result == -1) break;
+        assignment_solve((AssignmentPair*) pairs->data, pairs->len, size_d, size_tr, tracker_of_d);
+        for (it_d = 0; it_d < size_d; ++it_d) {
+            if (tracker_of_d[it_d] < 0)
+                continue;
 
-            // Add the detected object selected in tracker
-            detected_obj = (CvRect*) g_slist_nth_data(detected_objects, it_d_max);
-            tracker = (Tracker*) g_slist_nth_data(trackers, it_tr_max);
+            detected_obj = (CvRect*) &detections_get(detected_objects, it_d)->rect;
+            tracker = (Tracker*) g_ptr_array_index(trackers, tracker_of_d[it_d]);
             *tracker->detected_object = *detected_obj;
             tracker->frames_to_last_detecting = 0;
-            remain_d[it_d_max] = 0;
-
-            // Clean the row and column
-            for (it_dxtr = 0; it_dxtr < size_d * size_tr; ++it_dxtr){
-                guint it_d_temp, it_tr_temp;
-                it_d_temp = (guint) it_dxtr / size_tr;
-                it_tr_temp = it_dxtr - ((guint) (it_d_temp * size_tr));
-                if(it_d_temp == it_d_max || it_tr_temp == it_tr_max)
-                    results_vet[it_dxtr] = -1;
-            }
         }
     }
 
     // Include the detected object without tr in unassociated array
     for (it_d = 0; it_d < size_d; ++it_d) {
-        if (remain_d[it_d]) {
-            detected_obj = (CvRect*) g_slist_nth_data(detected_objects, it_d);
+        if (tracker_of_d[it_d] < 0) {
+            detected_obj = (CvRect*) &detections_get(detected_objects, it_d)->rect;
             *unassociated_objects = g_slist_prepend(*unassociated_objects, detected_obj);
             GST_INFO("adding CvRect(%d, %d, %d, %d) at unassociated_objects",
                     detected_obj->x, detected_obj->y, detected_obj->width,
                     detected_obj->height);
         }
     }
+
+    g_free(partc_vet);
+    g_free(tracker_of_d);
+    g_array_free(pairs, TRUE);
 }
 
 static void
-remove_old_trackers(IplImage *image, GSList **trackers) {
+remove_old_trackers(CClassifierFrame *frame, GPtrArray *trackers) {
 
-    GSList *it_tracker;
-    for (it_tracker = *trackers; it_tracker; it_tracker = it_tracker->next) {
-        Tracker *tracker = (Tracker*) it_tracker->data;
+    guint i = 0;
+    while (i < trackers->len) {
+        Tracker *tracker = (Tracker*) g_ptr_array_index(trackers, i);
 
-        if (classifier_intermediate_classify(tracker->classifier, image, tracker->tracker_area) >= 0)
+        if (classifier_intermediate_classify_frame(tracker->classifier, frame, tracker->tracker_area) >= 0)
             tracker->frames_of_wrong_classifier_to_del = 0;
         else
             tracker->frames_of_wrong_classifier_to_del++;
 
-        //printf("%i) %f #notdet:%i #neg:%i\n", tracker->id, classifier_intermediate_classify(tracker->classifier, image, tracker->tracker_area), tracker->frames_to_last_detecting, tracker->frames_of_wrong_classifier_to_del);
+        //printf("%i) %f #notdet:%i #neg:%i\n", tracker->id, classifier_intermediate_classify_frame(tracker->classifier, frame, tracker->tracker_area), tracker->frames_to_last_detecting, tracker->frames_of_wrong_classifier_to_del);
+
+        if (tracker->frames_to_last_detecting > FRAMES_TO_LAST_DETECTING_REM && tracker->frames_of_wrong_classifier_to_del > FRAMES_OF_WRONG_CLASSIFIER_REM) {
+            g_ptr_array_remove_index(trackers, i);
+            tracker_free(tracker);
+        } else
+            i++;
+    }
+}
 
-        if (tracker->frames_to_last_detecting > FRAMES_TO_LAST_DETECTING_REM && tracker->frames_of_wrong_classifier_to_del > FRAMES_OF_WRONG_CLASSIFIER_REM)
-            *trackers = g_slist_remove(*trackers, tracker);
+static void
+gst_tracker_model_unref(GstTrackerModel *model)
+{
+    if (g_atomic_int_dec_and_test(&model->ref_count)) {
+        classifier_intermediate_model_release(model->classifier_model);
+        g_free(model);
+    }
+}
+
+// the model file is read once; the trackers created from then on each
+// start from their own copy of it. The trackers still being initialised
+// hold a reference to the previous model, which goes away with them
+static void
+gst_tracker_load_model(GstTracker *filter)
+{
+    CClassifierModel *classifier_model;
+
+    if (filter->model) gst_tracker_model_unref(filter->model);
+    filter->model = NULL;
+
+    if (filter->model_location == NULL || filter->model_location[0] == '\0')
+        return;
+
+    classifier_model = classifier_intermediate_model_load(filter->model_location);
+    if (classifier_model == NULL) {
+        GST_WARNING("unable to load classifier model: \"%s\"", filter->model_location);
+        return;
+    }
+
+    filter->model                   = g_new(GstTrackerModel, 1);
+    filter->model->classifier_model = classifier_model;
+    filter->model->ref_count        = 1;
+}
+
+/* runs on the background thread: the whole initialisation of a tracker,
+ * the training of its classifier included, on its own copy of the frame */
+static void
+gst_tracker_init_tracker(gpointer data, gpointer user_data)
+{
+    GstTracker       *filter = GST_TRACKER(user_data);
+    tracker_init_t   *init   = (tracker_init_t*) data;
+    CClassifierFrame *frame;
+
+    frame = classifier_intermediate_frame_new();
+    classifier_intermediate_frame_update(frame, init->image);
+
+    init->tracker = tracker_new(&init->region, 4, 4,
+                                init->num_particles,
+                                init->image, frame,
+                                init->beta, init->gamma, init->eta,
+                                init->id, init->seed,
+                                init->model ? init->model->classifier_model : NULL,
+                                init->n_classifier_threads);
+
+    if (init->model) gst_tracker_model_unref(init->model);
+    classifier_intermediate_frame_release(frame);
+    cvReleaseImage(&init->image);
+
+    g_async_queue_push(filter->initialized_trackers, init);
+}
+
+/* moves the pending trackers due on the current frame to the running ones,
+ * in the order of their detections, waiting for their initialisation if
+ * needed; so the frame a tracker joins on does not depend on the timing of
+ * the background thread. Their detections are dropped at the same time */
+static void
+gst_tracker_add_initialized_trackers(GstTracker *filter)
+{
+    tracker_init_t *init, *done;
+    GList          *link, *next;
+
+    for (link = filter->pending_trackers->head; link; link = next) {
+        next = link->next;
+        init = (tracker_init_t*) link->data;
+        if (init->join_frame > filter->n_frames)
+            continue;
+
+        while (!init->initialized) {
+            done              = (tracker_init_t*) g_async_queue_pop(filter->initialized_trackers);
+            done->initialized = TRUE;
+        }
+        g_queue_delete_link(filter->pending_trackers, link);
+
+        g_ptr_array_add(filter->trackers, init->tracker);
+        filter->unassociated_objects_last_frame = g_slist_remove(filter->unassociated_objects_last_frame, init->obj);
+
+        g_free(init->obj);
+        g_free(init);
     }
 }
 
@@ -580,16 +792,16 @@ has_intersection(CvRect *obj, GSList *objects)
 }
 
 Tracker*
-closer_tracker_with_a_detected_obj_to(Tracker* tracker, GSList* trackers)
+closer_tracker_with_a_detected_obj_to(Tracker* tracker, GPtrArray* trackers)
 {
     gfloat   dist, min_dist;
     Tracker *tr, *closer_tracker;
-    GSList  *it_tracker;
+    guint    i;
 
     min_dist = G_MAXFLOAT;
-    for (it_tracker = trackers; it_tracker; it_tracker = it_tracker->next)
+    for (i = 0; i < trackers->len; i++)
     {
-        tr = (Tracker*)it_tracker->data;
+        tr = (Tracker*) g_ptr_array_index(trackers, i);
 
         if (tr->detected_object != NULL){
             dist = euclidian_distance(  cvPoint(tracker->filter->State[0], tracker->filter->State[1]),
@@ -687,32 +899,34 @@ static GstFlowReturn
 gst_tracker_chain(GstPad *pad, GstBuffer *buf)
 {
     GstTracker          *filter;
-    IplImage            *image;
     GSList              *unassociated_objects = NULL;
     unassociated_obj_t  *unassociated_obj = NULL;
 
     GSList              *it_obj = NULL;
-    GSList              *it_tracker = NULL;
     GSList              *intersection_last_frame = NULL;
+    guint                i;
 
-    Tracker             *new_tracker = NULL;
+    tracker_init_t      *new_tracker = NULL;
     Tracker             *tracker = NULL;
     Tracker             *closer_tracker = NULL;
 
     filter = GST_TRACKER(GST_OBJECT_PARENT(pad));
     filter->image->imageData = (char *) GST_BUFFER_DATA(buf);
+    filter->n_frames++;
 
-    image = cvCloneImage(filter->image);
+    // the gray frame and its integral images are built once, before anything
+    // is drawn on the image, and shared by all the trackers' classifiers
+    classifier_intermediate_frame_update(filter->frame, filter->image);
 
     // Remove old trackers
-    remove_old_trackers(image, &filter->trackers);
+    remove_old_trackers(filter->frame, filter->trackers);
 
-    if (filter->detect_timestamp == GST_BUFFER_TIMESTAMP(buf) && filter->confidence_density_timestamp == GST_BUFFER_TIMESTAMP(buf))
+    if (detections_timestamp(filter->detected_objects) == GST_BUFFER_TIMESTAMP(buf) && filter->confidence_density_timestamp == GST_BUFFER_TIMESTAMP(buf))
     {
 
-        GST_INFO("detected_objects: %d", g_slist_length(filter->detected_objects));
+        GST_INFO("detected_objects: %d", detections_count(filter->detected_objects));
         // data association
-        associate_detected_obj_to_tracker(image, filter->detected_objects, filter->trackers, &unassociated_objects);
+        associate_detected_obj_to_tracker(filter->image, filter->frame, filter->detected_objects, filter->trackers, &unassociated_objects);
 
         GST_INFO("unassociated_objects: %d", g_slist_length(unassociated_objects));
 
@@ -728,22 +942,44 @@ gst_tracker_chain(GstPad *pad, GstBuffer *buf)
 
                 //distribution_test(unassociated_obj->region, filter->image);
 
-                if (unassociated_obj->count >= TRACKER_NUM_SUBSEQUENT_DETECTIONS) {
-                    new_tracker = tracker_new( &unassociated_obj->region, 4, 4,
-                                                TRACKER_NUM_PARTICLES,
-                                                image,
-                                                filter->beta, filter->gamma, filter->eta,
-                                                g_slist_length(filter->trackers)+1 );
-
-                    filter->trackers = g_slist_prepend(filter->trackers, new_tracker);
-
-                    filter->unassociated_objects_last_frame = g_slist_remove(filter->unassociated_objects_last_frame, intersection_last_frame);
-                    g_free(unassociated_obj);
+                // while its tracker is initialised, the detection stays in
+                // the list so that it is not taken for a new object
+                if (unassociated_obj->count >= TRACKER_NUM_SUBSEQUENT_DETECTIONS && !unassociated_obj->pending) {
+                    new_tracker         = g_new0(tracker_init_t, 1);
+                    new_tracker->obj           = unassociated_obj;
+                    new_tracker->region        = unassociated_obj->region;
+                    new_tracker->image         = cvCloneImage(filter->image);
+                    new_tracker->beta          = filter->beta;
+                    new_tracker->gamma         = filter->gamma;
+                    new_tracker->eta           = filter->eta;
+                    new_tracker->num_particles = filter->num_particles;
+                    new_tracker->id            = filter->trackers->len + g_queue_get_length(filter->pending_trackers) + 1;
+                    new_tracker->seed          = g_rand_int(filter->rand);
+                    new_tracker->model         = filter->model;
+                    if (new_tracker->model) g_atomic_int_inc(&new_tracker->model->ref_count);
+
+                    // the trackers already run in parallel, so that their
+                    // classifiers are better trained serially, the initial
+                    // training included
+                    new_tracker->n_classifier_threads =
+                        (filter->workers && worker_pool_get_n_threads(filter->workers) > 1) ? 1 : 0;
+
+                    unassociated_obj->pending = TRUE;
+                    g_queue_push_tail(filter->pending_trackers, new_tracker);
+
+                    if (filter->async_init) {
+                        new_tracker->join_frame = filter->n_frames + ASYNC_INIT_FRAMES;
+                        g_thread_pool_push(filter->init_pool, new_tracker, NULL);
+                    } else {
+                        new_tracker->join_frame = filter->n_frames;
+                        gst_tracker_init_tracker(new_tracker, filter);
+                    }
                 }
             } else {
                 unassociated_obj = g_new(unassociated_obj_t, 1);
                 unassociated_obj->region = *((CvRect*)it_obj->data);
                 unassociated_obj->count = 0;
+                unassociated_obj->pending = FALSE;
                 filter->unassociated_objects_last_frame = g_slist_prepend( filter->unassociated_objects_last_frame, unassociated_obj );
             }
         }
@@ -758,24 +994,38 @@ gst_tracker_chain(GstPad *pad, GstBuffer *buf)
         g_slist_free(unassociated_objects);
     }
 
-    // tracking
-    GST_INFO("trackers: %d\n", g_slist_length(filter->trackers));
-    for (it_tracker = filter->trackers; it_tracker; it_tracker = it_tracker->next) {
-        tracker = (Tracker*)it_tracker->data;
-        tracker->frames_to_last_detecting++;
+    // the trackers due on this frame join the tracking
+    gst_tracker_add_initialized_trackers(filter);
 
-        GST_INFO("running tracker: %d", tracker->id);
+    // tracking; everything that reads the other trackers or draws on the
+    // image is done first, then the trackers run on the workers, each of
+    // them on its own state only
+    GST_INFO("trackers: %d\n", filter->trackers->len);
+    for (i = 0; i < filter->trackers->len; i++) {
+        tracker = (Tracker*) g_ptr_array_index(filter->trackers, i);
+        tracker->frames_to_last_detecting++;
 
         print_tracker(tracker, filter->image, tracker->id, filter->show_particles);
 
         closer_tracker = closer_tracker_with_a_detected_obj_to( tracker, filter->trackers );
-        tracker_run(tracker, closer_tracker, &filter->confidence_density, image );
+        tracker_update_reliability(tracker, closer_tracker);
     }
+    worker_pool_run(filter->workers, filter->trackers->pdata, filter->trackers->len);
 
     gst_buffer_set_data(buf, (guint8*) filter->image->imageData, (guint) filter->image->imageSize);
     return gst_pad_push(filter->srcpad, buf);
 }
 
+static void
+gst_tracker_run_tracker(gpointer task, gpointer user_data)
+{
+    GstTracker *filter  = GST_TRACKER(user_data);
+    Tracker    *tracker = (Tracker*) task;
+
+    GST_INFO("running tracker: %d", tracker->id);
+    tracker_run(tracker, &filter->confidence_density, filter->image, filter->frame);
+}
+
 // callbacks
 static gboolean
 gst_tracker_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
@@ -812,30 +1062,7 @@ gst_tracker_events_cb(GstPad *pad, GstEvent *event, gpointer user_data)
         }
     }
 
-    if (strcmp(gst_structure_get_name(structure), "hog-detect-roi") == 0) {
-        CvRect       *detect_rect;
-        GstClockTime timestamp;
-        GSList       *it_list;
-
-
-        detect_rect = g_new(CvRect,1);
-        gst_structure_get((GstStructure*) structure,
-                          "x",         G_TYPE_UINT,   &detect_rect->x,
-                          "y",         G_TYPE_UINT,   &detect_rect->y,
-                          "width",     G_TYPE_UINT,   &detect_rect->width,
-                          "height",    G_TYPE_UINT,   &detect_rect->height,
-                          "timestamp", G_TYPE_UINT64, &timestamp, NULL);
-
-        if (timestamp > filter->detect_timestamp) {
-            filter->detect_timestamp = timestamp;
-            for(it_list = filter->detected_objects; it_list; it_list = it_list->next)
-                g_free(it_list->data);
-
-            g_slist_free(filter->detected_objects);
-            filter->detected_objects = NULL;
-        }
-        filter->detected_objects = g_slist_prepend(filter->detected_objects, detect_rect);
-    }
+    detections_update_from_event(event, DETECTION_SOURCE_HOG_DETECT, &filter->detected_objects);
 
     return TRUE;
 }
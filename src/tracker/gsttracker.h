@@ -53,6 +53,8 @@
 
 #include "tracker.h"
 #include "../common/draw.h"
+#include "../common/detections.h"
+#include "../common/worker-pool.h"
 
 G_BEGIN_DECLS
 /* #defines don't like whitespacey bits */
@@ -69,6 +71,13 @@ G_BEGIN_DECLS
 typedef struct _GstTracker GstTracker;
 typedef struct _GstTrackerClass GstTrackerClass;
 
+// a classifier model, shared by the element and the trackers being
+// initialised from it; released with its last reference
+typedef struct {
+    CClassifierModel *classifier_model;
+    gint              ref_count;
+} GstTrackerModel;
+
 struct _GstTracker
 {
     GstElement       element;
@@ -80,15 +89,27 @@ struct _GstTracker
     gboolean         show_features_box;
 
     IplImage        *image;
+    CClassifierFrame *frame;
 
     gfloat           beta;
     gfloat           gamma;
     gfloat           eta;
-    GSList          *trackers;
+    guint            seed;
+    GRand           *rand;
+    gchar           *model_location;
+    GstTrackerModel *model;
+    gboolean         async_init;
+    guint            num_particles;
+    GThreadPool     *init_pool;
+    GAsyncQueue     *initialized_trackers;
+    GQueue          *pending_trackers;   // in the order of their detections
+    guint            n_frames;
+    GPtrArray       *trackers;
+    guint            n_workers;
+    WorkerPool      *workers;
     GSList          *unassociated_objects_last_frame;
-    GSList          *detected_objects;
+    GstBuffer       *detected_objects;
     CvMat            confidence_density;
-    GstClockTime     detect_timestamp;
     GstClockTime     confidence_density_timestamp;
 };
 
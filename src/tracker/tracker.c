@@ -55,18 +55,23 @@
 #include <math.h>
 
 // private function prototypes
-static void     tracker_resample   (Tracker *tracker, CvMat *confidence_density, IplImage *image, gfloat po);
+static void     tracker_resample   (Tracker *tracker, CvMat *confidence_density, IplImage *image, CClassifierFrame *frame, gfloat po);
+static void     sample_density     (CvMat *confidence_density, const CvPoint *pos, const gint *rect, gint n, gfloat *values);
+
+// particle_rect of the particles that lie outside of the image
+#define PARTICLE_OUTSIDE    -2
 
 Tracker*
 tracker_new(const CvRect *region, gint state_vec_dim, gint measurement_vec_dim,
-            gint num_particles, IplImage *image,
-            gfloat beta, gfloat gamma, gfloat eta, gint id)
+            gint num_particles, IplImage *image, CClassifierFrame *frame,
+            gfloat beta, gfloat gamma, gfloat eta, gint id, guint32 seed,
+            CClassifierModel *model, gint n_classifier_threads)
 {
     Tracker        *tracker;
     CvRNG           rng_state;
     CvMat          *lowerBound;
     CvMat          *upperBound;
-    gint            i;
+    gint            i, hash_size;
     CvMat          *particle_positions;
     CvPoint2D32f    standard_deviation;
     CvPoint2D32f    mean;
@@ -80,6 +85,21 @@ tracker_new(const CvRect *region, gint state_vec_dim, gint measurement_vec_dim,
     tracker->eta = eta;
 
     tracker->id = id;
+    tracker->num_particles = num_particles;
+
+    tracker->particle_pos     = g_new0(CvPoint, num_particles);
+    tracker->particle_rect    = g_new0(gint,    num_particles);
+    tracker->particle_rects   = g_new0(CvRect,  num_particles);
+    tracker->particle_ctr     = g_new0(gfloat,  num_particles);
+    tracker->particle_dist    = g_new0(gfloat,  num_particles);
+    tracker->particle_density = g_new0(gfloat,  num_particles);
+
+    for (hash_size = 1; hash_size < 2 * num_particles; hash_size <<= 1);
+    tracker->particle_cells          = g_new0(CvPoint, num_particles);
+    tracker->particle_cell_dist      = g_new0(gfloat,  num_particles);
+    tracker->particle_cell_hash      = g_new(gint,     hash_size);
+    tracker->particle_cell_hash_mask = hash_size - 1;
+    tracker->n_particle_cells        = 0;
 
     tracker->image_size = cvSize(image->width, image->height);
 
@@ -121,7 +141,12 @@ tracker_new(const CvRect *region, gint state_vec_dim, gint measurement_vec_dim,
 
     cvConDensInitSampleSet(tracker->filter, lowerBound, upperBound);
 
-    rng_state = cvRNG(0xffffffff);
+    // all the randomness of the tracker derives from its seed: the initial
+    // particles, the condensation noise (one stream per state dimension)
+    // and the classifier
+    rng_state = cvRNG(((guint64) seed << 8) | 0xff);
+    for (i = 0; i < state_vec_dim; i++)
+        tracker->filter->RandS[i].state = cvRNG(((guint64) seed << 8) | i);
 
     particle_positions = cvCreateMat(num_particles, 1, CV_32SC2);
 
@@ -162,8 +187,11 @@ tracker_new(const CvRect *region, gint state_vec_dim, gint measurement_vec_dim,
            tracker->max_confidence = tracker->filter->flConfidence[i];
     }
 
-    // init learn process
-    tracker->classifier = classifier_intermediate_init(image, *tracker->detected_object);
+    // init learn process; a pre-trained model only needs to be adapted
+    if (model != NULL)
+        tracker->classifier = classifier_intermediate_init_frame_model(frame, *tracker->detected_object, model, seed, n_classifier_threads);
+    else
+        tracker->classifier = classifier_intermediate_init_frame(frame, *tracker->detected_object, seed, n_classifier_threads);
 
     cvReleaseMat(&particle_positions);
     cvReleaseMat(&lowerBound);
@@ -177,27 +205,57 @@ tracker_free(Tracker *tracker)
 {
     cvReleaseConDensation(&tracker->filter);
     g_free(tracker->detected_object);
-    g_free(tracker->classifier);
+    classifier_intermediate_release(tracker->classifier);
+    g_free(tracker->particle_pos);
+    g_free(tracker->particle_rect);
+    g_free(tracker->particle_rects);
+    g_free(tracker->particle_ctr);
+    g_free(tracker->particle_dist);
+    g_free(tracker->particle_density);
+    g_free(tracker->particle_cells);
+    g_free(tracker->particle_cell_dist);
+    g_free(tracker->particle_cell_hash);
     g_free(tracker);
 }
 
 // FIXME: define mean and variance
 void
-tracker_run(Tracker *tracker, Tracker *closer_tracker_with_a_detected_obj, CvMat *confidence_density, IplImage *image)
+tracker_update_reliability(Tracker *tracker, Tracker *closer_tracker_with_a_detected_obj)
 {
     gfloat po, mean, variance;
-    gfloat new_area, old_area, ratio;
 
     // sanity checks
     g_assert(tracker != NULL);
 
-
     // reliability of the detector confidence density
-    if (tracker->detected_object != NULL){ // if a detection was associated to the tracker
+    if (tracker->detected_object != NULL) // if a detection was associated to the tracker
         po = 1.0f;
+    else if (closer_tracker_with_a_detected_obj != NULL){
+        mean = 1.0f;
+        variance = sqrt( pow(closer_tracker_with_a_detected_obj->detected_object->width,2) + // diagonal
+                        pow(closer_tracker_with_a_detected_obj->detected_object->height,2));
+        po = gaussian_function(euclidian_distance(
+                                    cvPoint(tracker->filter->State[0], tracker->filter->State[1]),
+                                    cvPoint(closer_tracker_with_a_detected_obj->filter->State[0],
+                                            closer_tracker_with_a_detected_obj->filter->State[1])),
+                               mean, variance);
+    }
+    else po = 0.0f;
+
+    tracker->detection_reliability = po;
+}
+
+void
+tracker_run(Tracker *tracker, CvMat *confidence_density, IplImage *image, CClassifierFrame *frame)
+{
+    gfloat new_area, old_area, ratio;
 
+    // sanity checks
+    g_assert(tracker != NULL);
+
+    if (tracker->detected_object != NULL){ // if a detection was associated to the tracker
         // FIXME: use the return of function
-        classifier_intermediate_train(tracker->classifier, image, *tracker->detected_object);
+        classifier_intermediate_train_frame(tracker->classifier, frame, *tracker->detected_object);
 
         new_area = (float)(tracker->detected_object->width * tracker->detected_object->height);
         old_area = (float)(tracker->tracker_area.width * tracker->tracker_area.height);
@@ -209,19 +267,8 @@ tracker_run(Tracker *tracker, Tracker *closer_tracker_with_a_detected_obj, CvMat
             tracker->tracker_area = *tracker->detected_object;
 
     }
-    else if (closer_tracker_with_a_detected_obj != NULL){
-        mean = 1.0f;
-        variance = sqrt( pow(closer_tracker_with_a_detected_obj->detected_object->width,2) + // diagonal
-                        pow(closer_tracker_with_a_detected_obj->detected_object->height,2));
-        po = gaussian_function(euclidian_distance(
-                                    cvPoint(tracker->filter->State[0], tracker->filter->State[1]),
-                                    cvPoint(closer_tracker_with_a_detected_obj->filter->State[0],
-                                            closer_tracker_with_a_detected_obj->filter->State[1])),
-                               mean, variance);
-    }
-    else po = 0.0f;
 
-    tracker_resample(tracker, confidence_density, image, po);
+    tracker_resample(tracker, confidence_density, image, frame, tracker->detection_reliability);
     cvConDensUpdateByTime(tracker->filter);
 
     tracker->previous_centroid = rect_centroid(&tracker->tracker_area);
@@ -229,86 +276,197 @@ tracker_run(Tracker *tracker, Tracker *closer_tracker_with_a_detected_obj, CvMat
     tracker->tracker_area.y = tracker->filter->State[1] - tracker->tracker_area.height/2;
 }
 
+void
+tracker_update_particle_cells(Tracker *tracker)
+{
+    gint    i, cell;
+    guint   slot, mask;
+    CvPoint pos, *cells;
+
+    mask  = tracker->particle_cell_hash_mask;
+    cells = tracker->particle_cells;
+    for (slot = 0; slot <= mask; ++slot)
+        tracker->particle_cell_hash[slot] = -1;
+
+    // keep the cells in the order of their first particle, with linear probing
+    tracker->n_particle_cells = 0;
+    for (i = 0; i < tracker->filter->SamplesNum; ++i) {
+        pos = cvPoint(tracker->filter->flSamples[i][0], tracker->filter->flSamples[i][1]);
+
+        slot = (((guint) pos.x * 73856093u) ^ ((guint) pos.y * 19349663u)) & mask;
+        while ((cell = tracker->particle_cell_hash[slot]) >= 0) {
+            if (cells[cell].x == pos.x && cells[cell].y == pos.y) break;
+            slot = (slot + 1) & mask;
+        }
+
+        if (cell < 0) {
+            tracker->particle_cell_hash[slot] = tracker->n_particle_cells;
+            cells[tracker->n_particle_cells++] = pos;
+        }
+    }
+}
+
+gfloat
+tracker_particle_concentration(Tracker *tracker, CvPoint point)
+{
+    gint    i, n;
+    gfloat  mean, standard_deviation, concentration, *dist;
+
+    n    = tracker->n_particle_cells;
+    dist = tracker->particle_cell_dist;
+    if (n <= 1) return -1;
+
+    // the distances are truncated, as the score has always been computed
+    mean = 0;
+    for (i = 0; i < n; ++i) {
+        dist[i] = abs(euclidian_distance(point, tracker->particle_cells[i]));
+        mean += dist[i];
+    }
+    mean /= n;
+
+    standard_deviation = 0;
+    for (i = 0; i < n; ++i)
+        standard_deviation += pow(dist[i] - mean, 2);
+    standard_deviation = sqrt(standard_deviation / n);
+
+    concentration = 0;
+    for (i = 0; i < n; ++i)
+        concentration += gaussian_function(dist[i], mean, standard_deviation);
+
+    return concentration / n;
+}
+
 // private methods
 
 static void
-tracker_resample(Tracker *tracker, CvMat *confidence_density, IplImage *image, gfloat po)
+tracker_resample(Tracker *tracker, CvMat *confidence_density, IplImage *image, CClassifierFrame *frame, gfloat po)
 {
-    CvPoint particle_pos;
-    gfloat  mean, variance;
-    gfloat  likelihood;
-    gboolean has_detected_obj;
-    gfloat  ctr;
-    gint    i;
-    double  confidence_density_term;
-    gfloat  dist;
-    gfloat min_confidence;
-    CvRect tr_rect;
-    CvPoint tr_rect_origin, tr_rect_original_centroid;
+    CvPoint  particle_pos, centroid;
+    CvRect   tr_rect;
+    CvPoint  tr_rect_origin, tr_rect_original_centroid;
+    gfloat   likelihood_mean, likelihood_norm, likelihood_scale;
+    gfloat   density_weight, dist, min_confidence;
+    gfloat  *confidence;
+    gint     i, n, n_rects, dx, dy;
 
     // sanity checks
     g_assert(tracker != NULL);
 
-    has_detected_obj = tracker->detected_object != NULL ? TRUE: FALSE;
+    n          = tracker->filter->SamplesNum;
+    confidence = tracker->filter->flConfidence;
 
     // Store informations to create the rect centralized in each particle
     tr_rect = tracker->tracker_area;
     tr_rect_origin = cvPoint(tr_rect.x, tr_rect.y);
     tr_rect_original_centroid = rect_centroid(&tracker->tracker_area);
 
-    min_confidence = G_MAXFLOAT;
-    tracker->max_confidence = 0;
-
-    for (i = 0; i < tracker->filter->SamplesNum; i++) {
+    // Gather the particle positions and the rects centered on them, so that
+    // the classifier evaluates all of them in a single batch
+    n_rects = 0;
+    for (i = 0; i < n; i++) {
         particle_pos = cvPoint(tracker->filter->flSamples[i][0], tracker->filter->flSamples[i][1]);
+        tracker->particle_pos[i] = particle_pos;
+
         // FIXME: check if some particles can have negative positition?
         if (particle_pos.x < tracker->image_size.width &&
             particle_pos.y < tracker->image_size.height &&
             particle_pos.x >= 0 && particle_pos.y >= 0)
         {
-            if (has_detected_obj){
-                dist = euclidian_distance(particle_pos, rect_centroid(tracker->detected_object));
-
-                mean = 10;
-                //TODO: is it the best variance to use?
-                variance =  sqrt(   pow(tracker->detected_object->width,2) + // diagonal
-                                pow(tracker->detected_object->height,2));
-
-                likelihood   = gaussian_function(dist, mean, variance);
-            }
-            else likelihood = 0;
-
             // Moves the object rect so that it centered on the particle
             tr_rect.x = tr_rect_origin.x + particle_pos.x - tr_rect_original_centroid.x;
             tr_rect.y = tr_rect_origin.y + particle_pos.y - tr_rect_original_centroid.y;
-            //FIXME: check if ctr = 0.0f is the best value to paritcles that have rect region outside of image
-            if (tr_rect.x + tr_rect.width < image->width && tr_rect.y + tr_rect.height < image->height)
-                ctr = classifier_intermediate_classify(tracker->classifier, image, tr_rect);
-            else
-                ctr = 0.0f;
-
-            if (confidence_density){
-                confidence_density_term = cvGetReal2D( confidence_density, particle_pos.y, particle_pos.x );
-            }
-            else confidence_density_term = 1.0;
-
-            tracker->filter->flConfidence[i] = tracker->beta * likelihood +
-                                               tracker->gamma * po * confidence_density_term +
-                                               tracker->eta  * ctr;
-            if (min_confidence > tracker->filter->flConfidence[i])
-               min_confidence = tracker->filter->flConfidence[i];
-            if (tracker->max_confidence < tracker->filter->flConfidence[i])
-               tracker->max_confidence = tracker->filter->flConfidence[i];
+            if (tr_rect.x + tr_rect.width < image->width && tr_rect.y + tr_rect.height < image->height) {
+                tracker->particle_rect[i]       = n_rects;
+                tracker->particle_rects[n_rects++] = tr_rect;
+            } else tracker->particle_rect[i] = -1;
+        } else tracker->particle_rect[i] = PARTICLE_OUTSIDE;
+    }
 
+    if (n_rects > 0)
+        classifier_intermediate_classify_frame_batch(tracker->classifier, frame, tracker->particle_rects, n_rects, tracker->particle_ctr);
+
+    // spread the confidences back to their particles; going backwards, as
+    // a rect never comes after its particle, none is overwritten before use
+    //FIXME: check if ctr = 0.0f is the best value to paritcles that have rect region outside of image
+    for (i = n - 1; i >= 0; i--)
+        tracker->particle_ctr[i] = (tracker->particle_rect[i] >= 0) ? tracker->particle_ctr[tracker->particle_rect[i]] : 0.0f;
+
+    sample_density(confidence_density, tracker->particle_pos, tracker->particle_rect, n, tracker->particle_density);
+
+    // the gaussian likelihood of the distance to the detection; its
+    // constants are the same for all the particles
+    likelihood_norm = likelihood_scale = likelihood_mean = 0.0f;
+    if (tracker->detected_object != NULL) {
+        gfloat variance;
+
+        likelihood_mean = 10;
+        //TODO: is it the best variance to use?
+        variance = (gfloat) (tracker->detected_object->width  * tracker->detected_object->width +   // diagonal
+                             tracker->detected_object->height * tracker->detected_object->height);
+
+        likelihood_norm  = tracker->beta / sqrtf(2 * M_PI * variance);
+        likelihood_scale = -1.0f / (2 * variance);
+
+        centroid = rect_centroid(tracker->detected_object);
+        for (i = 0; i < n; i++) {
+            dx = tracker->particle_pos[i].x - centroid.x;
+            dy = tracker->particle_pos[i].y - centroid.y;
+            tracker->particle_dist[i] = sqrtf((gfloat) (dx * dx + dy * dy));
+        }
+    } else {
+        for (i = 0; i < n; i++)
+            tracker->particle_dist[i] = 0.0f;
+    }
 
-        } else tracker->filter->flConfidence[i] = 0;
+    // weight of the particles, over plain arrays so that it vectorises
+    density_weight = tracker->gamma * po;
+    for (i = 0; i < n; i++) {
+        dist = tracker->particle_dist[i] - likelihood_mean;
+        confidence[i] = likelihood_norm * expf(likelihood_scale * dist * dist) +
+                        density_weight * tracker->particle_density[i] +
+                        tracker->eta * tracker->particle_ctr[i];
+    }
 
+    min_confidence = G_MAXFLOAT;
+    tracker->max_confidence = 0;
+    for (i = 0; i < n; i++) {
+        if (tracker->particle_rect[i] == PARTICLE_OUTSIDE) {
+            confidence[i] = 0;
+            continue;
+        }
+        if (min_confidence > confidence[i])
+           min_confidence = confidence[i];
+        if (tracker->max_confidence < confidence[i])
+           tracker->max_confidence = confidence[i];
     }
 
     // min confidence of the particles is shift to 0 if it is negativo
     if (min_confidence < 0)
-        for (i = 0; i < tracker->filter->SamplesNum; i++)
-            tracker->filter->flConfidence[i] = tracker->filter->flConfidence[i] - min_confidence;
+        for (i = 0; i < n; i++)
+            confidence[i] = confidence[i] - min_confidence;
+}
+
+/* confidence density under each particle inside of the image, read straight
+ * from the rows of the float matrix the hog detector sends */
+static void
+sample_density(CvMat *confidence_density, const CvPoint *pos, const gint *rect, gint n, gfloat *values)
+{
+    gint i;
+
+    if (confidence_density == NULL || confidence_density->data.ptr == NULL) {
+        for (i = 0; i < n; i++)
+            values[i] = 1.0f;
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (rect[i] == PARTICLE_OUTSIDE || pos[i].y >= confidence_density->rows || pos[i].x >= confidence_density->cols)
+            values[i] = 0.0f;
+        else if (CV_MAT_TYPE(confidence_density->type) == CV_32FC1)
+            values[i] = ((const float*) (confidence_density->data.ptr + (size_t) pos[i].y * confidence_density->step))[pos[i].x];
+        else
+            values[i] = (gfloat) cvGetReal2D(confidence_density, pos[i].y, pos[i].x);
+    }
 }
 
 
@@ -71,6 +71,21 @@ struct _Tracker
     CClassifier    *classifier;
     CvPoint         previous_centroid;
     gfloat          max_confidence;
+
+    // per particle scratch of the resampling, allocated once
+    CvPoint        *particle_pos;
+    gint           *particle_rect;     // index in particle_rects, -1 if none, -2 if outside of the image
+    CvRect         *particle_rects;
+    gfloat         *particle_ctr;
+    gfloat         *particle_dist;
+    gfloat         *particle_density;
+
+    // distinct particle positions, hashed once per frame for the association
+    CvPoint        *particle_cells;
+    gint            n_particle_cells;
+    gint           *particle_cell_hash; // index in particle_cells, -1 if empty
+    guint           particle_cell_hash_mask;
+    gfloat         *particle_cell_dist;
 };
 
 Tracker*        tracker_new         (const CvRect *region,
@@ -78,17 +93,36 @@ Tracker*        tracker_new         (const CvRect *region,
                                      gint          measurement_vec_dim,
                                      gint          num_particles,
                                      IplImage     *image,
+                                     CClassifierFrame *frame,
                                      gfloat        beta,
                                      gfloat        gama,
                                      gfloat        mi,
-                                     gint          id);
+                                     gint          id,
+                                     guint32       seed,
+                                     CClassifierModel *model,
+                                     gint          n_classifier_threads);
 
 void            tracker_free        (Tracker      *tracker);
 
+// reads the state of the other trackers, so it must be done for all the
+// trackers before any of them runs; tracker_run only changes its own tracker
+// and may run for several trackers at once
+void            tracker_update_reliability (Tracker *tracker,
+                                            Tracker *closer_tracker_with_a_detected_obj);
+
 void            tracker_run         (Tracker      *tracker,
-                                     Tracker      *closer_tracker_with_a_detected_obj,
                                      CvMat        *confidence_density,
-                                     IplImage     *image);
+                                     IplImage     *image,
+                                     CClassifierFrame *frame);
+
+// must be called after the particles move and before the concentration of
+// the particles is read for a detection
+void            tracker_update_particle_cells (Tracker *tracker);
+
+// concentration of the distinct particles around a point, -1 if the tracker
+// has less than two distinct particles
+gfloat          tracker_particle_concentration (Tracker *tracker,
+                                                CvPoint  point);
 
 CvPoint         rect_centroid       (CvRect       *rect);
 
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// checks assignment_solve() against an exhaustive search on small random
+// problems, then times it on gated problems of growing size
+
+#include <assignment.h>
+
+#include <stdio.h>
+
+#define MAX_SMALL_SIZE   7
+#define N_SMALL_CHECKS   20000
+#define GATE_WIDTH       3
+
+// best total score of the rows from 'row' on, the columns in 'used_cols'
+// being taken already
+static double
+best_score(const AssignmentPair *pairs, guint n_pairs, guint n_rows, guint row, guint used_cols)
+{
+    double best, score;
+    guint  i;
+
+    if (row == n_rows)
+        return 0.0;
+
+    // the row may be left alone...
+    best = best_score(pairs, n_pairs, n_rows, row + 1, used_cols);
+
+    // ...or paired with any free column it is a candidate for
+    for (i = 0; i < n_pairs; ++i) {
+        if ((pairs[i].row != row) || (used_cols & (1u << pairs[i].col)))
+            continue;
+        score = pairs[i].score + best_score(pairs, n_pairs, n_rows, row + 1, used_cols | (1u << pairs[i].col));
+        best  = MAX(best, score);
+    }
+
+    return best;
+}
+
+// total score of the solution, or -1 if it isn't a valid assignment
+static double
+solution_score(const AssignmentPair *pairs, guint n_pairs, guint n_rows, const gint *col_of_row)
+{
+    double   score;
+    guint    row, i, used_cols;
+    gboolean found;
+
+    score     = 0.0;
+    used_cols = 0;
+    for (row = 0; row < n_rows; ++row) {
+        if (col_of_row[row] < 0)
+            continue;
+        if (used_cols & (1u << col_of_row[row]))
+            return -1.0;
+        used_cols |= 1u << col_of_row[row];
+
+        found = FALSE;
+        for (i = 0; (i < n_pairs) && !found; ++i) {
+            if ((pairs[i].row == row) && ((gint) pairs[i].col == col_of_row[row])) {
+                score += pairs[i].score;
+                found  = TRUE;
+            }
+        }
+        if (!found)
+            return -1.0;
+    }
+
+    return score;
+}
+
+static int
+check_small(GRand *rand)
+{
+    AssignmentPair pairs[MAX_SMALL_SIZE * MAX_SMALL_SIZE];
+    gint           col_of_row[MAX_SMALL_SIZE];
+    guint          n_rows, n_cols, n_pairs, row, col;
+    double         expected, score;
+    int            i, failures;
+
+    failures = 0;
+    for (i = 0; i < N_SMALL_CHECKS; ++i) {
+        n_rows  = g_rand_int_range(rand, 1, MAX_SMALL_SIZE + 1);
+        n_cols  = g_rand_int_range(rand, 1, MAX_SMALL_SIZE + 1);
+        n_pairs = 0;
+        for (row = 0; row < n_rows; ++row) {
+            for (col = 0; col < n_cols; ++col) {
+                if (g_rand_int_range(rand, 0, 3) != 0)
+                    continue;
+                pairs[n_pairs].row   = row;
+                pairs[n_pairs].col   = col;
+                pairs[n_pairs].score = (gfloat) g_rand_double_range(rand, 0.4, 1.0);
+                n_pairs++;
+            }
+        }
+
+        assignment_solve(pairs, n_pairs, n_rows, n_cols, col_of_row);
+        score    = solution_score(pairs, n_pairs, n_rows, col_of_row);
+        expected = best_score(pairs, n_pairs, n_rows, 0, 0);
+        if ((score < 0.0) || (score < expected - 1e-5)) {
+            fprintf(stderr, "%ux%u, %u pairs: score %g instead of %g\n", n_rows, n_cols, n_pairs, score, expected);
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+// each detection is only a candidate for the trackers close to it, as
+// after the spatial gate of the tracker element
+static void
+time_gated(GRand *rand, guint size)
+{
+    AssignmentPair *pairs;
+    gint           *col_of_row;
+    GTimer         *timer;
+    guint           n_pairs, row, col, runs, i;
+
+    pairs      = g_new(AssignmentPair, size * (2 * GATE_WIDTH + 1));
+    col_of_row = g_new(gint, size);
+    n_pairs    = 0;
+    for (row = 0; row < size; ++row) {
+        for (col = (row > GATE_WIDTH) ? row - GATE_WIDTH : 0; (col < size) && (col <= row + GATE_WIDTH); ++col) {
+            pairs[n_pairs].row   = row;
+            pairs[n_pairs].col   = col;
+            pairs[n_pairs].score = (gfloat) g_rand_double_range(rand, 0.4, 1.0);
+            n_pairs++;
+        }
+    }
+
+    runs  = 10;
+    timer = g_timer_new();
+    for (i = 0; i < runs; ++i)
+        assignment_solve(pairs, n_pairs, size, size, col_of_row);
+    printf("%4u detections x %4u trackers, %5u candidates: %.3f ms\n",
+           size, size, n_pairs, g_timer_elapsed(timer, NULL) * 1000.0 / runs);
+
+    g_timer_destroy(timer);
+    g_free(col_of_row);
+    g_free(pairs);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GRand *rand;
+    int    failures;
+
+    rand     = g_rand_new_with_seed(1);
+    failures = check_small(rand);
+    time_gated(rand, 10);
+    time_gated(rand, 100);
+    time_gated(rand, 500);
+    g_rand_free(rand);
+
+    if (failures > 0)
+        fprintf(stderr, "%d failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// times Detector::classifySmooth() over the search grid of a boosting
+// tracker with a growing number of threads, and checks that every thread
+// count gives the confidences of the serial evaluation
+
+#include <Detector.h>
+#include <ImageRepresentation.h>
+#include <Patches.h>
+#include <StrongClassifierDirectSelection.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <worker-pool.h>
+
+#define IMAGE_WIDTH          640
+#define IMAGE_HEIGHT         480
+#define NUM_BASE_CLASSIFIER  50
+#define NUM_INIT_ITERATIONS  10
+#define NUM_FRAMES           20
+
+int
+main(int argc, char *argv[])
+{
+	GRand* rand = g_rand_new_with_seed(1);
+
+	// noise with a bright square to track
+	unsigned char* image = new unsigned char[IMAGE_WIDTH*IMAGE_HEIGHT];
+	for (int i = 0; i < IMAGE_WIDTH*IMAGE_HEIGHT; i++)
+		image[i] = (unsigned char)g_rand_int_range(rand, 0, 128);
+	Rect target(200, 280, 48, 48);
+	for (int row = target.upper; row < target.upper+target.height; row++)
+		memset(image+row*IMAGE_WIDTH+target.left, 224, target.width);
+
+	Size imageSize(IMAGE_HEIGHT, IMAGE_WIDTH);
+	ImageRepresentation representation(image, imageSize);
+
+	// trained as BoostingTracker does, on the target against its corners
+	Size patchSize;
+	patchSize = target;
+	StrongClassifierDirectSelection classifier(NUM_BASE_CLASSIFIER, NUM_BASE_CLASSIFIER*10, patchSize, true, 50, 1);
+	Rect searchROI(target.upper-target.height/2, target.left-target.width/2, 2*target.height, 2*target.width);
+	Rect validROI(0, 0, IMAGE_HEIGHT, IMAGE_WIDTH);
+	PatchesRegularScan patches(searchROI, validROI, patchSize, 0.99f);
+	for (int curInitStep = 0; curInitStep < NUM_INIT_ITERATIONS; curInitStep++)
+	{
+		classifier.update(&representation, patches.getSpecialRect("UpperLeft"), -1);
+		classifier.update(&representation, target, 1);
+		classifier.update(&representation, patches.getSpecialRect("LowerRight"), -1);
+		classifier.update(&representation, target, 1);
+	}
+
+	int numPatches = patches.getNum();
+	std::vector<float> serial;
+	// a few threads at least, to check the result even on small machines
+	int maxThreads = (int)worker_pool_default_n_threads();
+	if (maxThreads < 4)
+		maxThreads = 4;
+	int failures = 0;
+
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		Detector detector(&classifier);
+		detector.setNumThreads(numThreads);
+		detector.classifySmooth(&representation, &patches);
+
+		GTimer* timer = g_timer_new();
+		for (int curFrame = 0; curFrame < NUM_FRAMES; curFrame++)
+			detector.classifySmooth(&representation, &patches);
+		double elapsed = g_timer_elapsed(timer, NULL);
+		g_timer_destroy(timer);
+
+		printf("%2d threads, %d patches: %.2f frames per second\n",
+			detector.getNumThreads(), numPatches, NUM_FRAMES/elapsed);
+
+		if (serial.empty())
+			serial.assign(detector.getConfidences(), detector.getConfidences()+numPatches);
+		else if (memcmp(&serial[0], detector.getConfidences(), numPatches*sizeof(float)) != 0)
+		{
+			fprintf(stderr, "%d threads: the confidences differ from the serial ones\n", numThreads);
+			failures++;
+		}
+	}
+
+	delete[] image;
+	g_rand_free(rand);
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// times ImageRepresentation::setNewImage() on full frames with and without
+// the squared integral, and checks the sums of random rectangles, also
+// after moving the ROI around, against the sums of the pixels
+
+#include <ImageRepresentation.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#define NUM_FRAMES  50
+#define NUM_RECTS   200
+
+static int
+check_sums(ImageRepresentation* representation, unsigned char* image, int width, Rect roi, GRand* rand)
+{
+	int failures = 0;
+
+	for (int curRect = 0; curRect < NUM_RECTS; curRect++)
+	{
+		// getSum() clamps the rectangles reaching the last ROI row or column
+		Rect rect;
+		rect.height = g_rand_int_range(rand, 1, roi.height);
+		rect.width = g_rand_int_range(rand, 1, roi.width);
+		rect.upper = roi.upper + g_rand_int_range(rand, 0, roi.height-rect.height);
+		rect.left = roi.left + g_rand_int_range(rand, 0, roi.width-rect.width);
+
+		long sum = 0, sqSum = 0;
+		for (int row = rect.upper; row < rect.upper+rect.height; row++)
+			for (int col = rect.left; col < rect.left+rect.width; col++)
+			{
+				int value = image[row*width+col];
+				sum += value;
+				sqSum += value*value;
+			}
+
+		if (representation->getSum(rect) != sum ||
+			(representation->getUseVariance() && representation->getSqSum(rect) != sqSum))
+		{
+			fprintf(stderr, "wrong sum of %dx%d at (%d, %d) in the ROI %dx%d at (%d, %d)\n",
+				rect.width, rect.height, rect.left, rect.upper,
+				roi.width, roi.height, roi.left, roi.upper);
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const int sizes[][2] = { { 640, 480 }, { 1920, 1080 } };
+	GRand* rand = g_rand_new_with_seed(1);
+	int failures = 0;
+
+	for (unsigned int curSize = 0; curSize < G_N_ELEMENTS(sizes); curSize++)
+	{
+		int width = sizes[curSize][0];
+		int height = sizes[curSize][1];
+		unsigned char* image = new unsigned char[width*height];
+		for (int i = 0; i < width*height; i++)
+			image[i] = (unsigned char)g_rand_int_range(rand, 0, 256);
+
+		for (int useVariance = 0; useVariance <= 1; useVariance++)
+		{
+			Size imageSize(height, width);
+			ImageRepresentation representation(NULL, imageSize);
+			representation.setUseVariance(useVariance != 0);
+			representation.setNewImage(image);
+
+			GTimer* timer = g_timer_new();
+			for (int curFrame = 0; curFrame < NUM_FRAMES; curFrame++)
+				representation.setNewImage(image);
+			double elapsed = g_timer_elapsed(timer, NULL);
+			g_timer_destroy(timer);
+
+			printf("%4dx%-4d %s: %.3f ms per frame\n", width, height,
+				useVariance ? "with variance   " : "without variance",
+				1000.0*elapsed/NUM_FRAMES);
+
+			Rect roi(0, 0, height, width);
+			failures += check_sums(&representation, image, width, roi, rand);
+
+			// smaller and larger ROIs reuse or grow the buffers
+			for (int curROI = 0; curROI < 10; curROI++)
+			{
+				roi.height = g_rand_int_range(rand, 2, height+1);
+				roi.width = g_rand_int_range(rand, 2, width+1);
+				roi.upper = g_rand_int_range(rand, 0, height-roi.height+1);
+				roi.left = g_rand_int_range(rand, 0, width-roi.width+1);
+				representation.setNewImageAndROI(image, roi);
+				failures += check_sums(&representation, image, width, roi, rand);
+			}
+		}
+
+		delete[] image;
+	}
+
+	g_rand_free(rand);
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// times the optflowtracker feature search over a growing number of haar ROIs
+// on 720p and 1080p frames, against the former search over the whole frame
+// with a painted mask, and checks that the features stay in their ROIs
+
+#include <roi-features.h>
+#include <util.h>
+
+#include <stdio.h>
+
+#define N_FRAMES        5
+#define MAX_FEATURES    500
+#define ROI_SIZE        96
+#define SUBPIX_WIN_SIZE 10
+#define QUALITY_LEVEL   0.01
+#define MIN_DISTANCE    10
+
+// noise under random bright and dark blocks, so that there are corners
+// everywhere
+static IplImage*
+random_frame(GRand *rand, int width, int height)
+{
+    IplImage *gray;
+    int       i, x, y;
+
+    gray = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+    for (y = 0; y < height; ++y)
+        for (x = 0; x < width; ++x)
+            CV_IMAGE_ELEM(gray, guchar, y, x) = (guchar) g_rand_int_range(rand, 64, 128);
+
+    for (i = 0; i < (width * height) / 2000; ++i) {
+        x = g_rand_int_range(rand, 0, width);
+        y = g_rand_int_range(rand, 0, height);
+        cvRectangle(gray, cvPoint(x, y), cvPoint(x + g_rand_int_range(rand, 4, 32), y + g_rand_int_range(rand, 4, 32)),
+                    cvScalarAll(g_rand_boolean(rand) ? 255 : 0), CV_FILLED, 8, 0);
+    }
+
+    return gray;
+}
+
+static int
+check_frame(GRand *rand, int width, int height)
+{
+    static const guint n_rois[] = { 1, 4, 16, 32 };
+    IplImage       *gray, *mask;
+    CvRect          rois[32], frame;
+    CvPoint2D32f    features[MAX_FEATURES];
+    CvTermCriteria  criteria;
+    GTimer         *timer;
+    gdouble         roi_time, frame_time;
+    guint           i, j, k, n_features;
+    int             count, failures;
+
+    gray     = random_frame(rand, width, height);
+    mask     = cvCreateImage(cvGetSize(gray), IPL_DEPTH_8U, 1);
+    frame    = cvRect(0, 0, width, height);
+    criteria = cvTermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03);
+    timer    = g_timer_new();
+    failures = 0;
+
+    // some of the ROIs cross the frame borders, as the haar ones do
+    for (i = 0; i < G_N_ELEMENTS(rois); ++i) {
+        rois[i] = cvRect(g_rand_int_range(rand, -ROI_SIZE / 2, width - ROI_SIZE / 2),
+                         g_rand_int_range(rand, -ROI_SIZE / 2, height - ROI_SIZE / 2), ROI_SIZE, ROI_SIZE);
+        rois[i] = rect_intersection(&rois[i], &frame);
+    }
+
+    for (k = 0; k < G_N_ELEMENTS(n_rois); ++k) {
+        g_timer_start(timer);
+        for (j = 0; j < N_FRAMES; ++j) {
+            for (i = 0; i < n_rois[k]; ++i) {
+                n_features = MAX_FEATURES;
+                roi_features_find(gray, NULL, rois[i], features, &n_features,
+                                  QUALITY_LEVEL, MIN_DISTANCE, SUBPIX_WIN_SIZE, criteria);
+            }
+        }
+        roi_time = g_timer_elapsed(timer, NULL) / N_FRAMES;
+
+        g_timer_start(timer);
+        for (j = 0; j < N_FRAMES; ++j) {
+            for (i = 0; i < n_rois[k]; ++i) {
+                cvZero(mask);
+                cvRectangle(mask, cvPoint(rois[i].x, rois[i].y),
+                            cvPoint(rois[i].x + rois[i].width - 1, rois[i].y + rois[i].height - 1),
+                            cvScalarAll(255), CV_FILLED, 8, 0);
+                count = MAX_FEATURES;
+                cvGoodFeaturesToTrack(gray, NULL, NULL, features, &count, QUALITY_LEVEL, MIN_DISTANCE, mask,
+                                      3, 0, 0.04);
+                cvFindCornerSubPix(gray, features, count, cvSize(SUBPIX_WIN_SIZE, SUBPIX_WIN_SIZE),
+                                   cvSize(-1, -1), criteria);
+            }
+        }
+        frame_time = g_timer_elapsed(timer, NULL) / N_FRAMES;
+
+        printf("%4dx%-4d %2d ROIs: %7.2f ms per frame on the ROIs, %8.2f ms on the whole frame\n",
+               width, height, n_rois[k], roi_time * 1000.0, frame_time * 1000.0);
+    }
+
+    // the refinement may move a feature by up to its window size
+    for (i = 0; i < G_N_ELEMENTS(rois); ++i) {
+        n_features = MAX_FEATURES;
+        roi_features_find(gray, NULL, rois[i], features, &n_features,
+                          QUALITY_LEVEL, MIN_DISTANCE, SUBPIX_WIN_SIZE, criteria);
+        if (n_features == 0) {
+            fprintf(stderr, "%dx%d: no features in ROI %d\n", width, height, i);
+            ++failures;
+        }
+        for (j = 0; j < n_features; ++j) {
+            if ((features[j].x < rois[i].x - SUBPIX_WIN_SIZE) ||
+                (features[j].y < rois[i].y - SUBPIX_WIN_SIZE) ||
+                (features[j].x > rois[i].x + rois[i].width + SUBPIX_WIN_SIZE) ||
+                (features[j].y > rois[i].y + rois[i].height + SUBPIX_WIN_SIZE)) {
+                fprintf(stderr, "%dx%d: feature (%.1f, %.1f) outside ROI %d\n",
+                        width, height, features[j].x, features[j].y, i);
+                ++failures;
+            }
+        }
+    }
+
+    g_timer_destroy(timer);
+    cvReleaseImage(&mask);
+    cvReleaseImage(&gray);
+    return failures;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GRand *rand;
+    int    failures;
+
+    rand     = g_rand_new_with_seed(1);
+    failures = check_frame(rand, 1280, 720) + check_frame(rand, 1920, 1080);
+    g_rand_free(rand);
+
+    if (failures > 0)
+        fprintf(stderr, "%d failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// checks the exhaustive and the indexed SURF matching against a double
+// precision brute-force reference, and times both of them on growing
+// numbers of image points
+
+#include "surf-data.h"
+
+#include <stdio.h>
+
+#define N_OBJECT_POINTS  500
+
+static int
+check_matching(GRand *rand, int length, int n_image_points)
+{
+    SurfPoints *image, *object;
+    SurfIndex  *index;
+    GArray     *pairs;
+    GTimer     *timer;
+    gdouble     naive_time, exact_time, approx_time;
+    int         i, expected, found, failures;
+
+    image    = random_points(rand, length, n_image_points);
+    object   = perturbed_points(rand, image, N_OBJECT_POINTS);
+    index    = surfIndexNew(image, 0);
+    failures = 0;
+
+    // the exhaustive and the exact indexed search find the reference matches
+    for (i = 0; i < object->total; ++i) {
+        const float *vec = object->descriptors + i * length;
+
+        expected = reference_nearest_neighbor(vec, object->laplacian[i], image);
+
+        found = naiveNearestNeighbor(vec, object->laplacian[i], image);
+        if (found != expected) {
+            fprintf(stderr, "length %d: naive match of %d is %d instead of %d\n", length, i, found, expected);
+            ++failures;
+        }
+
+        found = surfIndexNearestNeighbor(index, vec, object->laplacian[i]);
+        if (found != expected) {
+            fprintf(stderr, "length %d: indexed match of %d is %d instead of %d\n", length, i, found, expected);
+            ++failures;
+        }
+    }
+    surfIndexFree(index);
+
+    // times of matching all the object points, the index being built for
+    // each run as the elements do once per frame
+    pairs = g_array_new(FALSE, FALSE, sizeof(IntPair));
+    timer = g_timer_new();
+
+    findPairs(object, image, pairs);
+    naive_time = g_timer_elapsed(timer, NULL);
+
+    g_timer_start(timer);
+    index = surfIndexNew(image, 0);
+    findPairsIndexed(object, index, pairs);
+    surfIndexFree(index);
+    exact_time = g_timer_elapsed(timer, NULL);
+
+    g_timer_start(timer);
+    index = surfIndexNew(image, 128);
+    findPairsIndexed(object, index, pairs);
+    surfIndexFree(index);
+    approx_time = g_timer_elapsed(timer, NULL);
+
+    printf("length %3d, %d x %4d points: exhaustive %.2f ms, indexed %.2f ms, 128 checks %.2f ms\n",
+           length, object->total, image->total, naive_time * 1000.0, exact_time * 1000.0, approx_time * 1000.0);
+
+    g_timer_destroy(timer);
+    g_array_free(pairs, TRUE);
+    surfPointsFree(object);
+    surfPointsFree(image);
+    return failures;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int n_image_points[] = { 500, 2000, 8000 };
+    GRand *rand;
+    guint  i;
+    int    failures;
+
+    rand     = g_rand_new_with_seed(1);
+    failures = 0;
+    for (i = 0; i < G_N_ELEMENTS(n_image_points); ++i)
+        failures += check_matching(rand, 64, n_image_points[i]) + check_matching(rand, 128, n_image_points[i]);
+    g_rand_free(rand);
+
+    if (failures > 0)
+        fprintf(stderr, "%d failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
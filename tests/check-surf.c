@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// checks each SURF distance kernel the host can run against a double
+// precision brute-force reference and against the others
+
+#include "surf-data.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define N_IMAGE_POINTS   2000
+#define N_OBJECT_POINTS  500
+#define N_KERNEL_CHECKS  2000
+
+// the kernels the host can run are checked against the reference, and all
+// of them must give the same distances and matches as the scalar one
+static int
+check_kernels(GRand *rand, int length)
+{
+    static const char *kernels[] = { "scalar", "sse2", "avx2" };
+    SurfPoints *points, *image, *object;
+    SurfIndex  *index;
+    double      reference, d, best, dists[11];
+    double     *scalar_dists;
+    int        *scalar_matches;
+    int         i, j, found, failures;
+    guint       k;
+
+    points         = random_points(rand, length, N_KERNEL_CHECKS + 11);
+    image          = random_points(rand, length, N_IMAGE_POINTS);
+    object         = perturbed_points(rand, image, N_OBJECT_POINTS);
+    scalar_dists   = g_new(double, N_KERNEL_CHECKS);
+    scalar_matches = g_new(int, 2 * N_OBJECT_POINTS);
+    failures       = 0;
+
+    for (k = 0; k < G_N_ELEMENTS(kernels); ++k) {
+        if (!surfSetDistanceKernel(kernels[k])) {
+            printf("length %3d: kernel %s not available\n", length, kernels[k]);
+            continue;
+        }
+
+        for (i = 0; i < N_KERNEL_CHECKS; ++i) {
+            const float *d1 = points->descriptors + i * length;
+            const float *d2 = points->descriptors + (i + 1) * length;
+
+            reference = reference_distance(d1, d2, length);
+
+            // the whole distance when it is below 'best', the same with all
+            // the kernels...
+            d = compareSURFDescriptors(d1, d2, 2.0 * reference, length);
+            if (fabs(d - reference) > 1e-5 * reference) {
+                fprintf(stderr, "length %d, %s: distance %g instead of %g\n", length, kernels[k], d, reference);
+                ++failures;
+            }
+            if (k == 0)
+                scalar_dists[i] = d;
+            else if (d != scalar_dists[i]) {
+                fprintf(stderr, "length %d, %s: distance %.9g instead of the scalar %.9g\n",
+                        length, kernels[k], d, scalar_dists[i]);
+                ++failures;
+            }
+
+            // ...and never below 'best' when the distance is above it
+            d = compareSURFDescriptors(d1, d2, 0.5 * reference, length);
+            if (d < 0.5 * reference) {
+                fprintf(stderr, "length %d, %s: early exit returned %g below %g\n",
+                        length, kernels[k], d, 0.5 * reference);
+                ++failures;
+            }
+
+            // the block version gives the distances below 'best' of the one
+            // by one comparison, and keeps the others above 'best'; 11
+            // candidates take the grouped and the remaining ones paths
+            best = reference;
+            compareSURFDescriptorsBlock(d1, d2, 11, length, best, dists);
+            for (j = 0; j < 11; ++j) {
+                d = compareSURFDescriptors(d1, d2 + j * length, best, length);
+                if ((d < best) ? (dists[j] != d) : (dists[j] <= best)) {
+                    fprintf(stderr, "length %d, %s: block distance %d is %g instead of %g\n",
+                            length, kernels[k], j, dists[j], d);
+                    ++failures;
+                }
+            }
+        }
+
+        // the same matches with every kernel, through both searches
+        index = surfIndexNew(image, 0);
+        for (i = 0; i < object->total; ++i) {
+            const float *vec = object->descriptors + i * length;
+
+            for (j = 0; j < 2; ++j) {
+                found = (j == 0) ? naiveNearestNeighbor(vec, object->laplacian[i], image)
+                                 : surfIndexNearestNeighbor(index, vec, object->laplacian[i]);
+                if (k == 0)
+                    scalar_matches[2 * i + j] = found;
+                else if (found != scalar_matches[2 * i + j]) {
+                    fprintf(stderr, "length %d, %s: %s match of %d is %d instead of the scalar %d\n",
+                            length, kernels[k], (j == 0) ? "naive" : "indexed", i, found, scalar_matches[2 * i + j]);
+                    ++failures;
+                }
+            }
+        }
+        surfIndexFree(index);
+    }
+    surfSetDistanceKernel(NULL);
+
+    g_free(scalar_matches);
+    g_free(scalar_dists);
+    surfPointsFree(object);
+    surfPointsFree(image);
+    surfPointsFree(points);
+    return failures;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GRand *rand;
+    int    failures;
+
+    rand     = g_rand_new_with_seed(1);
+    failures = check_kernels(rand, 64) + check_kernels(rand, 128);
+    g_rand_free(rand);
+
+    if (failures > 0)
+        fprintf(stderr, "%d failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "surf-data.h"
+
+SurfPoints*
+random_points(GRand *rand, int length, int total)
+{
+    SurfPoints *points;
+    int         i, j;
+
+    points              = surfPointsNew(length);
+    points->total       = points->capacity = total;
+    points->x           = g_new0(float, total);
+    points->y           = g_new0(float, total);
+    points->laplacian   = g_new(int, total);
+    points->descriptors = g_new(float, total * length);
+
+    for (i = 0; i < total; ++i) {
+        points->laplacian[i] = g_rand_boolean(rand) ? 1 : -1;
+        for (j = 0; j < length; ++j)
+            points->descriptors[i * length + j] = (float) g_rand_double_range(rand, -0.5, 0.5);
+    }
+
+    return points;
+}
+
+SurfPoints*
+perturbed_points(GRand *rand, const SurfPoints *image, int total)
+{
+    SurfPoints *points;
+    int         i, j, source, length;
+
+    length = image->length;
+    points = random_points(rand, length, total);
+    for (i = 0; i < total; ++i) {
+        source = g_rand_int_range(rand, 0, image->total);
+        points->laplacian[i] = image->laplacian[source];
+        for (j = 0; j < length; ++j)
+            points->descriptors[i * length + j] = image->descriptors[source * length + j] +
+                                                  (float) g_rand_double_range(rand, -0.02, 0.02);
+    }
+
+    return points;
+}
+
+double
+reference_distance(const float *d1, const float *d2, int length)
+{
+    double total;
+    int    i;
+
+    total = 0.0;
+    for (i = 0; i < length; ++i)
+        total += ((double) d1[i] - d2[i]) * ((double) d1[i] - d2[i]);
+
+    return total;
+}
+
+int
+reference_nearest_neighbor(const float *vec, int laplacian, const SurfPoints *model)
+{
+    double d, dist1, dist2;
+    int    i, neighbor;
+
+    neighbor = -1;
+    dist1 = dist2 = 1e6;
+    for (i = 0; i < model->total; ++i) {
+        if (laplacian != model->laplacian[i])
+            continue;
+        d = reference_distance(vec, model->descriptors + i * model->length, model->length);
+        if (d < dist1) {
+            dist2 = dist1;
+            dist1 = d;
+            neighbor = i;
+        } else if (d < dist2)
+            dist2 = d;
+    }
+
+    return (dist1 < 0.6 * dist2) ? neighbor : -1;
+}
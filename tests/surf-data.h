@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2010 Gustavo Machado C. Gama <gama@vettalabs.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// random SURF descriptors and double precision brute-force references, for
+// the checks of the SURF matching
+
+#ifndef __GST_OPENCV_TESTS_SURF_DATA_H__
+#define __GST_OPENCV_TESTS_SURF_DATA_H__
+
+#include <surf.h>
+
+G_BEGIN_DECLS
+
+// 'total' points with random descriptors and laplacian signs
+SurfPoints* random_points              (GRand            *rand,
+                                        int               length,
+                                        int               total);
+
+// each point is a slightly perturbed copy of a random point of 'image', so
+// that most of them have a clear nearest neighbour
+SurfPoints* perturbed_points           (GRand            *rand,
+                                        const SurfPoints *image,
+                                        int               total);
+
+double      reference_distance         (const float      *d1,
+                                        const float      *d2,
+                                        int               length);
+
+// same contract as naiveNearestNeighbor(), without early termination
+int         reference_nearest_neighbor (const float      *vec,
+                                        int               laplacian,
+                                        const SurfPoints *model);
+
+G_END_DECLS
+
+#endif // __GST_OPENCV_TESTS_SURF_DATA_H__